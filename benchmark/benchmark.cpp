@@ -127,6 +127,24 @@ static void CountLarge(benchmark::State& state) {
   }
 }
 
+/** This is a counting benchmark with a prepared statement.
+ *  Performs the counts of CountLarge, binding the age instead of parsing a statement.
+ */
+static void CountPrepared(benchmark::State& state) {
+  Bitmap::initBitmap();
+  FileStore fileStore { "testTable" };
+  BufferPoolManager bufferPoolManager { 200, &fileStore, 0};
+  BitmapIndexManager bitmapIndexManager { "TestTable.txt", bufferPoolManager };
+  auto statement { bitmapIndexManager.prepare("count age=?") };
+  std::vector<std::vector<std::string>> parameters;
+
+  for (int i = 0; i < 10000; ++i) parameters.push_back({ std::to_string(i % 150) });
+
+  for (auto _ : state) {
+    for (const auto &parameter : parameters) bitmapIndexManager.count(statement, parameter);
+  }
+}
+
 /** This is a update benchmark
  *  Perform 150 updates on the database
  *  Update all the oldAge to new Age
@@ -198,6 +216,7 @@ BENCHMARK(Select);
 BENCHMARK(SelectLarge);
 BENCHMARK(Count);
 BENCHMARK(CountLarge);
+BENCHMARK(CountPrepared);
 BENCHMARK(Update);
 BENCHMARK(UpdateLarge);
 BENCHMARK(Delete);
@@ -0,0 +1,33 @@
+#include "attribute_schema.h"
+
+ValueType AttributeSchema::parse(std::string_view text) const {
+  switch (this->m_kind) {
+  case AttributeKind::INTEGER: {
+    int64_t value;
+    auto [end, error] { std::from_chars(text.data(), text.data() + text.size(), value) };
+    if (std::errc {} not_eq error or text.data() + text.size() not_eq end) {
+      throw std::runtime_error("not an integer " + std::string { text });
+    }
+    return value;
+  }
+  case AttributeKind::ENUM: {
+    auto enumeratorIter { std::find(begin(this->m_enumerators), end(this->m_enumerators), text) };
+    if (end(this->m_enumerators) == enumeratorIter) throw std::runtime_error("unknown value " + std::string { text });
+    return static_cast<int64_t>(enumeratorIter - begin(this->m_enumerators));
+  }
+  default:
+    if (0 not_eq this->m_length and this->m_length < text.size()) {
+      throw std::runtime_error("value too long " + std::string { text });
+    }
+    return std::string { text };
+  }
+}
+
+std::string AttributeSchema::format(const ValueType &value) const {
+  if (0 == value.index()) {
+    int64_t number { std::get<0>(value) };
+    if (AttributeKind::ENUM == this->m_kind) return this->m_enumerators.at(number);
+    return std::to_string(number);
+  }
+  return std::get<1>(value);
+}
@@ -30,22 +30,215 @@ BitmapIterator::value_type BitmapIterator::operator*() { return this->m_currentP
 
 Bitmap::Bitmap(uint64_t &bitmapLength) : m_bitmapLength { bitmapLength } { resize(); }
 
+Bitmap::Bitmap(const Bitmap &other)
+    : m_wordCount { other.m_wordCount }, m_bitmapLength { other.m_bitmapLength },
+      m_bitCount { other.m_bitCount } {
+  // Views are copied as well, the page behind a view is rewritten once its owner changes the chunk
+  this->m_chunks.resize(other.m_chunks.size());
+  for (uint64_t chunk { 0 }; chunk < this->m_chunks.size(); ++chunk) {
+    const Chunk &otherChunk { other.m_chunks[chunk] };
+    Chunk &thisChunk { this->m_chunks[chunk] };
+    if (not other.isAbsentChunk(chunk)) {
+      thisChunk.m_words = std::make_unique<uint64_t[]>(CHUNK_WORDS);
+      memcpy(thisChunk.m_words.get(), other.getChunkWords(chunk), PAGE_SIZE);
+    }
+    thisChunk.m_pageID = otherChunk.m_pageID;
+    thisChunk.m_isDirty = otherChunk.m_isDirty;
+  }
+}
+
 void Bitmap::resize() {
-  this->m_bitmap.resize((int64_t(this->m_bitmapLength) - 1) / 64 + 1);
+  this->m_wordCount = (int64_t(this->m_bitmapLength) - 1) / 64 + 1;
+  // New chunks are absent and have no page, they only get one once a bit is set
+  this->m_chunks.resize((this->m_wordCount + CHUNK_WORDS - 1) / CHUNK_WORDS);
+}
+
+void Bitmap::clear() {
+  this->m_chunks.clear();
+  this->m_bitCount = 0;
+  resize();
+}
+
+void Bitmap::reset() {
+  for (auto &chunk : this->m_chunks) {
+    chunk.m_view = nullptr;
+    if (chunk.m_words) memset(chunk.m_words.get(), 0, PAGE_SIZE);
+    chunk.m_isDirty = true;
+  }
+  this->m_bitCount = 0;
+}
+
+Bitmap &Bitmap::assign(const Bitmap &other) {
+  this->m_wordCount = other.m_wordCount;
+  this->m_bitCount = other.m_bitCount;
+  this->m_chunks.resize(other.m_chunks.size());
+  for (uint64_t chunk { 0 }; chunk < this->m_chunks.size(); ++chunk) {
+    // Words already allocated are overwritten, a chunk absent in other is zeroed rather than freed
+    Chunk &thisChunk { this->m_chunks[chunk] };
+    thisChunk.m_view = nullptr;
+    thisChunk.m_isDirty = true;
+    if (other.isAbsentChunk(chunk)) {
+      if (thisChunk.m_words) memset(thisChunk.m_words.get(), 0, PAGE_SIZE);
+      continue;
+    }
+    if (not thisChunk.m_words) thisChunk.m_words = std::make_unique<uint64_t[]>(CHUNK_WORDS);
+    memcpy(thisChunk.m_words.get(), other.getChunkWords(chunk), PAGE_SIZE);
+  }
+  return *this;
+}
+
+Bitmap &Bitmap::assignUnion(const std::vector<const Bitmap *> &bitmaps) {
+  // Every chunk is written once, the first bitmap having it is copied and the rest are ORed in while it is hot
+  this->m_bitCount = 0;
+  for (const Bitmap *bitmap : bitmaps) this->m_bitCount += bitmap->m_bitCount;
+  for (uint64_t chunk { 0 }; chunk < this->m_chunks.size(); ++chunk) {
+    Chunk &thisChunk { this->m_chunks[chunk] };
+    thisChunk.m_view = nullptr;
+    thisChunk.m_isDirty = true;
+    uint64_t *words { nullptr };
+    for (const Bitmap *bitmap : bitmaps) {
+      if (bitmap->isAbsentChunk(chunk)) continue;
+      const uint64_t *bitmapWords { bitmap->getChunkWords(chunk) };
+      if (words) {
+        for (uint64_t index { 0 }; index < CHUNK_WORDS; ++index) words[index] |= bitmapWords[index];
+        continue;
+      }
+      words = getMutableChunkWords(chunk);
+      memcpy(words, bitmapWords, PAGE_SIZE);
+    }
+    if (not words and thisChunk.m_words) memset(thisChunk.m_words.get(), 0, PAGE_SIZE);
+  }
+  return *this;
+}
+
+Bitmap &Bitmap::assignDifference(const Bitmap &bitmap, const std::vector<const Bitmap *> &bitmaps) {
+  this->m_bitCount = bitmap.m_bitCount;
+  for (const Bitmap *subtrahend : bitmaps) this->m_bitCount -= subtrahend->m_bitCount;
+  for (uint64_t chunk { 0 }; chunk < this->m_chunks.size(); ++chunk) {
+    Chunk &thisChunk { this->m_chunks[chunk] };
+    thisChunk.m_view = nullptr;
+    thisChunk.m_isDirty = true;
+    if (bitmap.isAbsentChunk(chunk)) {
+      if (thisChunk.m_words) memset(thisChunk.m_words.get(), 0, PAGE_SIZE);
+      continue;
+    }
+    uint64_t *words { getMutableChunkWords(chunk) };
+    memcpy(words, bitmap.getChunkWords(chunk), PAGE_SIZE);
+    for (const Bitmap *subtrahend : bitmaps) {
+      if (subtrahend->isAbsentChunk(chunk)) continue;
+      const uint64_t *subtrahendWords { subtrahend->getChunkWords(chunk) };
+      for (uint64_t index { 0 }; index < CHUNK_WORDS; ++index) words[index] &= ~subtrahendWords[index];
+    }
+  }
+  return *this;
+}
+
+size_t Bitmap::getMemoryUsage() const {
+  size_t memoryUsage { this->m_chunks.capacity() * sizeof(Chunk) };
+  for (const auto &chunk : this->m_chunks) {
+    if (chunk.m_words) memoryUsage += PAGE_SIZE;
+  }
+  return memoryUsage;
+}
+
+uint64_t Bitmap::getChunkCount() const { return this->m_chunks.size(); }
+
+bool Bitmap::isChunkDirty(uint64_t chunk) const { return this->m_chunks[chunk].m_isDirty; }
+
+uint64_t Bitmap::countChunkBits(uint64_t chunk) const {
+  if (isAbsentChunk(chunk)) return 0;
+  const uint64_t *words { getChunkWords(chunk) };
+  uint64_t bitCount { 0 };
+  for (uint64_t index { 0 }; index < CHUNK_WORDS; ++index) bitCount += __builtin_popcountll(words[index]);
+  return bitCount;
+}
+
+std::vector<uint64_t> Bitmap::getChunkBits(uint64_t chunk) const {
+  std::vector<uint64_t> bits;
+  if (isAbsentChunk(chunk)) return bits;
+  const uint64_t *words { getChunkWords(chunk) };
+  for (uint64_t index { 0 }; index < CHUNK_WORDS; ++index) {
+    // Take the lowest set bit of the word until none is left
+    for (uint64_t word { words[index] }; 0 not_eq word; word &= word - 1) {
+      bits.emplace_back(index * 64 + __builtin_ctzll(word));
+    }
+  }
+  return bits;
+}
+
+PageIDType Bitmap::getChunkPageID(uint64_t chunk) const { return this->m_chunks[chunk].m_pageID; }
+
+void Bitmap::setChunkPageID(uint64_t chunk, PageIDType pageID) { this->m_chunks[chunk].m_pageID = pageID; }
+
+void Bitmap::storeChunk(uint64_t chunk, ByteType *raw) {
+  memcpy(raw, getChunkWords(chunk), PAGE_SIZE);
+  this->m_chunks[chunk].m_isDirty = false;
+}
+
+void Bitmap::detachChunk(uint64_t chunk) {
+  this->m_chunks[chunk].m_pageID = INVALID_PAGE_ID;
+  this->m_chunks[chunk].m_isDirty = false;
+}
+
+void Bitmap::loadChunkBits(uint64_t chunk, const std::vector<uint64_t> &bits) {
+  for (const auto &bit : bits) setBit(chunk * CHUNK_BITS + bit);
+  detachChunk(chunk);
+}
+
+void Bitmap::loadChunk(uint64_t chunk, const ByteType *raw) {
+  uint64_t *words { getMutableChunkWords(chunk) };
+  for (uint64_t index { 0 }; index < CHUNK_WORDS; ++index) this->m_bitCount -= __builtin_popcountll(words[index]);
+  memcpy(words, raw, PAGE_SIZE);
+  for (uint64_t index { 0 }; index < CHUNK_WORDS; ++index) this->m_bitCount += __builtin_popcountll(words[index]);
+  this->m_chunks[chunk].m_isDirty = false;
+}
+
+void Bitmap::viewChunk(uint64_t chunk, const ByteType *raw) {
+  Chunk &viewedChunk { this->m_chunks[chunk] };
+  viewedChunk.m_words.reset();
+  viewedChunk.m_view = reinterpret_cast<const uint64_t *>(raw);
+  viewedChunk.m_isDirty = false;
+}
+
+void Bitmap::setBitCount(uint64_t bitCount) { this->m_bitCount = bitCount; }
+
+const uint64_t *Bitmap::getChunkWords(uint64_t chunk) const {
+  const Chunk &readChunk { this->m_chunks[chunk] };
+  if (readChunk.m_words) return readChunk.m_words.get();
+  if (readChunk.m_view) return readChunk.m_view;
+  return Bitmap::ms_zeroChunk;
+}
+
+uint64_t *Bitmap::getMutableChunkWords(uint64_t chunk) {
+  Chunk &writtenChunk { this->m_chunks[chunk] };
+  if (not writtenChunk.m_words) {
+    // Copy on the first write, an absent chunk starts from zeros
+    writtenChunk.m_words = std::make_unique<uint64_t[]>(CHUNK_WORDS);
+    if (writtenChunk.m_view) memcpy(writtenChunk.m_words.get(), writtenChunk.m_view, PAGE_SIZE);
+    writtenChunk.m_view = nullptr;
+  }
+  return writtenChunk.m_words.get();
+}
+
+bool Bitmap::isAbsentChunk(uint64_t chunk) const {
+  return not this->m_chunks[chunk].m_words and not this->m_chunks[chunk].m_view;
 }
 
 void Bitmap::setBit(uint64_t pos) {
   if (pos < this->m_bitmapLength) {
     if (not (*this)[pos]) ++this->m_bitCount;
-    this->m_bitmap[pos / 64] |= Bitmap::ms_bitmapMask[pos % 64];
+    getMutableChunkWords(pos / CHUNK_BITS)[pos % CHUNK_BITS / 64] |= Bitmap::ms_bitmapMask[pos % 64];
+    this->m_chunks[pos / CHUNK_BITS].m_isDirty = true;
   }
   else throw outOfRange_helper(pos);
 }
 
 void Bitmap::clearBit(uint64_t pos) {
   if (pos < this->m_bitmapLength) {
-    if ((*this)[pos]) --this->m_bitCount;
-    this->m_bitmap[pos / 64] &= Bitmap::ms_bitmapNotMask[pos % 64];
+    if (not (*this)[pos]) return;
+    --this->m_bitCount;
+    getMutableChunkWords(pos / CHUNK_BITS)[pos % CHUNK_BITS / 64] &= Bitmap::ms_bitmapNotMask[pos % 64];
+    this->m_chunks[pos / CHUNK_BITS].m_isDirty = true;
   }
   else throw outOfRange_helper(pos);
 }
@@ -54,14 +247,20 @@ uint64_t Bitmap::countBits() const { return this->m_bitCount; }
 
 uint64_t Bitmap::popCount() const {
   uint64_t bitCounter { 0 };
-  for (const auto &bits : this->m_bitmap) bitCounter += __builtin_popcountll(bits);
+  for (uint64_t chunk { 0 }; chunk < this->m_chunks.size(); ++chunk) {
+    if (isAbsentChunk(chunk)) continue;
+    const uint64_t *words { getChunkWords(chunk) };
+    uint64_t wordCount { std::min(CHUNK_WORDS, this->m_wordCount - chunk * CHUNK_WORDS) };
+    for (uint64_t index { 0 }; index < wordCount; ++index) bitCounter += __builtin_popcountll(words[index]);
+  }
   return bitCounter;
 }
 
 std::string Bitmap::serialize() const {
   // Construct bitmap string
   std::string bitmapString;
-  for (const auto &bitmapPart : this->m_bitmap) {
+  for (uint64_t index { 0 }; index < this->m_wordCount; ++index) {
+    uint64_t bitmapPart { getChunkWords(index / CHUNK_WORDS)[index % CHUNK_WORDS] };
     std::string bin { std::bitset<64> { bitmapPart }.to_string() };
     std::reverse(std::begin(bin), std::end(bin));
     bitmapString += bin;
@@ -132,31 +331,63 @@ uint64_t Bitmap::getLength() const { return this->m_bitmapLength; }
 
 bool Bitmap::operator[](uint64_t pos) const {
   if (pos < this->m_bitmapLength) {
-    return this->m_bitmap[pos / 64] & Bitmap::ms_bitmapMask[pos % 64];
+    return getChunkWords(pos / CHUNK_BITS)[pos % CHUNK_BITS / 64] & Bitmap::ms_bitmapMask[pos % 64];
   }
   else throw outOfRange_helper(pos);
 }
 
 Bitmap &Bitmap::operator&=(const Bitmap &rhs) {
-  for (uint64_t index { 0 }; index < rhs.m_bitmap.size(); ++index) {
-    this->m_bitmap[index] &= rhs.m_bitmap[index];
+  for (uint64_t chunk { 0 }; chunk < rhs.m_chunks.size(); ++chunk) {
+    // 0 & x is 0, an absent chunk stays absent
+    if (isAbsentChunk(chunk)) continue;
+    uint64_t *words { getMutableChunkWords(chunk) };
+    const uint64_t *rhsWords { rhs.getChunkWords(chunk) };
+    for (uint64_t index { 0 }; index < CHUNK_WORDS; ++index) words[index] &= rhsWords[index];
+    this->m_chunks[chunk].m_isDirty = true;
   }
   return *this;
 }
 
 Bitmap &Bitmap::operator|=(const Bitmap &rhs) {
-  for (uint64_t index { 0 }; index < rhs.m_bitmap.size(); ++index) {
-    this->m_bitmap[index] |= rhs.m_bitmap[index];
+  for (uint64_t chunk { 0 }; chunk < rhs.m_chunks.size(); ++chunk) {
+    // x | 0 is x
+    if (rhs.isAbsentChunk(chunk)) continue;
+    uint64_t *words { getMutableChunkWords(chunk) };
+    const uint64_t *rhsWords { rhs.getChunkWords(chunk) };
+    for (uint64_t index { 0 }; index < CHUNK_WORDS; ++index) words[index] |= rhsWords[index];
+    this->m_chunks[chunk].m_isDirty = true;
+  }
+  return *this;
+}
+
+Bitmap &Bitmap::andNot(const Bitmap &rhs) {
+  for (uint64_t chunk { 0 }; chunk < rhs.m_chunks.size(); ++chunk) {
+    // 0 & ~x is 0 and x & ~0 is x, either way the chunk stays as it is
+    if (isAbsentChunk(chunk) or rhs.isAbsentChunk(chunk)) continue;
+    uint64_t *words { getMutableChunkWords(chunk) };
+    const uint64_t *rhsWords { rhs.getChunkWords(chunk) };
+    for (uint64_t index { 0 }; index < CHUNK_WORDS; ++index) words[index] &= ~rhsWords[index];
+    this->m_chunks[chunk].m_isDirty = true;
   }
   return *this;
 }
 
 Bitmap Bitmap::operator~() {
   Bitmap result { *this };
-  for (auto &bits : result.m_bitmap) bits = ~bits;
+  result.flip();
   return result;
 }
 
+Bitmap &Bitmap::flip() {
+  for (uint64_t chunk { 0 }; chunk < this->m_chunks.size(); ++chunk) {
+    uint64_t *words { getMutableChunkWords(chunk) };
+    uint64_t wordCount { std::min(CHUNK_WORDS, this->m_wordCount - chunk * CHUNK_WORDS) };
+    for (uint64_t index { 0 }; index < wordCount; ++index) words[index] = ~words[index];
+    this->m_chunks[chunk].m_isDirty = true;
+  }
+  return *this;
+}
+
 BitmapIterator Bitmap::begin() const { return { *this, 0 }; }
 
 BitmapIterator Bitmap::end() const { return { *this, this->m_bitmapLength }; }
@@ -177,16 +408,12 @@ std::out_of_range Bitmap::outOfRange_helper(uint64_t pos) const {
 
 Bitmap operator&(const Bitmap &lhs, const Bitmap &rhs) {
   Bitmap result { lhs };
-  for (uint64_t index { 0 }; index < result.m_bitmap.size(); ++index) {
-    result.m_bitmap[index] &= rhs.m_bitmap[index];
-  }
+  result &= rhs;
   return result;
 }
 
 Bitmap operator|(const Bitmap &lhs, const Bitmap &rhs) {
   Bitmap result { lhs };
-  for (uint64_t index { 0 }; index < result.m_bitmap.size(); ++index) {
-    result.m_bitmap[index] |= rhs.m_bitmap[index];
-  }
+  result |= rhs;
   return result;
 }
@@ -1,79 +1,361 @@
 #include "bitmap_index.h"
 
-BitmapIndex::BitmapIndex(uint64_t &bitmapLength)
-    : m_bitmapLength { bitmapLength }, m_notNullBitmap { bitmapLength } { }
+namespace {
+
+/** @return true if value matches pattern, where % matches any characters */
+bool matchPattern(std::string_view value, std::string_view pattern) {
+  // Backtrack to the last % only, as a later % can match whatever an earlier one could
+  size_t valuePos { 0 }, patternPos { 0 }, wildcardPos { std::string_view::npos }, resumePos { 0 };
+  while (valuePos < value.size()) {
+    if (patternPos < pattern.size() and '%' == pattern[patternPos]) {
+      wildcardPos = patternPos++;
+      resumePos = valuePos;
+    } else if (patternPos < pattern.size() and pattern[patternPos] == value[valuePos]) {
+      ++patternPos;
+      ++valuePos;
+    } else if (std::string_view::npos not_eq wildcardPos) {
+      patternPos = wildcardPos + 1;
+      valuePos = ++resumePos;
+    } else {
+      return false;
+    }
+  }
+  while (patternPos < pattern.size() and '%' == pattern[patternPos]) ++patternPos;
+  return patternPos == pattern.size();
+}
+
+}
+
+BitmapIndex::BitmapIndex(uint64_t &bitmapLength, const AttributeSchema &schema)
+    : m_bitmapLength { bitmapLength }, m_schema { schema }, m_notNullBitmap { bitmapLength } { }
+
+const AttributeSchema &BitmapIndex::getSchema() const { return this->m_schema; }
 
 void BitmapIndex::resize() {
-  for (auto &[value, bitmap] : this->m_bitmaps) bitmap.resize();
+  // A stub is loaded with the current length anyway
+  if (not this->m_isLoaded) return;
+  for (auto &bitmap : this->m_bitmaps) bitmap->resize();
   this->m_notNullBitmap.resize();
 }
 
 void BitmapIndex::setBitmapBit(const ValueType &value, uint64_t pos) {
-  // If the bitmap does not exist, create one
-  if (not exist(value)) this->m_bitmaps.emplace(value, this->m_bitmapLength);
+  ensureLoaded_helper();
+  this->m_isDirty = true;
 
-  // Set the bit
-  this->m_bitmaps.at(value).setBit(pos);
+  // Set the bit, in a new bitmap if the value is new
+  emplace_helper(value).setBit(pos);
+  if (this->m_hasRecordValues) {
+    if (this->m_recordValues.size() <= pos) this->m_recordValues.resize(pos + 1, nullptr);
+    this->m_recordValues[pos] = &*this->m_codes.find(value);
+  }
 
   // Set the bit in the not null bitmap
   this->m_notNullBitmap.setBit(pos);
 }
 
 void BitmapIndex::clearAllBitmapBits(uint64_t pos) {
-  std::vector<ValueType> needToRemove;
+  ensureLoaded_helper();
+  // A record without a value in this attribute changes nothing
+  if (not this->m_notNullBitmap[pos]) return;
+  this->m_isDirty = true;
+  ensureRecordValues_helper();
 
-  for (auto &[value, bitmap] : this->m_bitmaps) {
-    // Set the bit to 0
-    bitmap.clearBit(pos);
-    // If the bitmap is empty, record it for removal later
-    if (0 == bitmap.countBits()) needToRemove.emplace_back(value);
+  // Set the bit to 0 in the bitmap of the value of the record only, and in the not null bitmap
+  ValueCodeType code { this->m_recordValues[pos]->second };
+  this->m_recordValues[pos] = nullptr;
+  Bitmap &bitmap { *this->m_bitmaps[code] };
+  bitmap.clearBit(pos);
+  this->m_notNullBitmap.clearBit(pos);
+  if (0 not_eq bitmap.countBits()) return;
+
+  // The pages of an empty bitmap are given back on the next save
+  for (uint64_t chunk { 0 }; chunk < bitmap.getChunkCount(); ++chunk) {
+    this->m_releasedPageIDs.emplace_back(bitmap.getChunkPageID(chunk));
   }
 
-  // remove the empty bitmap
-  for (const auto &value : needToRemove) this->m_bitmaps.erase(value);
+  // The value is copied, as erasing its entry destroys it
+  ValueType value { this->m_values[code]->first };
+  if (this->m_hasReversedBitmaps) {
+    const std::string &text { std::get<std::string>(value) };
+    this->m_reversedBitmaps.erase(std::string { rbegin(text), rend(text) });
+  }
+  this->m_values.erase(begin(this->m_values) + code);
+  this->m_bitmaps.erase(begin(this->m_bitmaps) + code);
+  this->m_codes.erase(value);
 
-  // Clear the bit in the not null bitmap
-  this->m_notNullBitmap.clearBit(pos);
+  // Elements of m_codes keep their address, so the codes after the removed one are moved down without hashing
+  for (ValueCodeType nextCode { code }; nextCode < this->m_values.size(); ++nextCode) {
+    this->m_values[nextCode]->second = nextCode;
+  }
 }
 
-Bitmap BitmapIndex::getBitmap(Token comparator, const std::string &value) {
+Bitmap BitmapIndex::getBitmap(Token comparator, const ValueType &value) {
   Bitmap resultBitmap { this->m_bitmapLength };
+  getBitmap(comparator, value, resultBitmap);
+  return resultBitmap;
+}
+
+void BitmapIndex::getBitmap(Token comparator, const ValueType &value, Bitmap &resultBitmap) {
+  ensureLoaded_helper();
+  const Bitmap *bitmap { find_helper(value) };
+  // OR the bitmaps of a range of codes
+  auto unionOf { [this, &resultBitmap](ValueCodeType first, ValueCodeType last) {
+    resultBitmap.reset();
+    for (; first < last; ++first) resultBitmap |= *this->m_bitmaps[first];
+  } };
+  ValueCodeType valueCount { static_cast<ValueCodeType>(this->m_bitmaps.size()) };
 
   switch (comparator) {
-  case Token::IS_NULL: return ~this->m_notNullBitmap;
-  case Token::IS_NOT_NULL: return this->m_notNullBitmap;
+  case Token::IS_NULL: resultBitmap.assign(this->m_notNullBitmap).flip(); break;
+  case Token::IS_NOT_NULL: resultBitmap.assign(this->m_notNullBitmap); break;
   case Token::EQUAL:
     // If the value exist, returns directly
-    if (exist(value)) return this->m_bitmaps.at(value);
+    if (nullptr not_eq bitmap) resultBitmap.assign(*bitmap);
     // If the value does not exist, returns empty bitmap
+    else resultBitmap.reset();
     break;
   case Token::NOT_EQUAL:
-    // If the value exist, returns the not of it AND not null bitmap
-    if (exist(value)) return ~this->m_bitmaps.at(value) & this->m_notNullBitmap;
-    // If the value does not exist, returns the OR of all the bitmaps
-    for (const auto &[value, bitmap] : this->m_bitmaps) resultBitmap |= bitmap;
+    // If the value exist, returns the not null bitmap without it
+    if (nullptr not_eq bitmap) resultBitmap.assign(this->m_notNullBitmap).andNot(*bitmap);
+    // If the value does not exist, returns the not null bitmap
+    else resultBitmap.assign(this->m_notNullBitmap);
     break;
-  case Token::GREATER_THAN:
-    for (auto iter { this->m_bitmaps.upper_bound(value) };
-         iter != end(this->m_bitmaps); ++iter) resultBitmap |= iter->second;
-    break;
-  case Token::GREATER_THAN_OR_EQUAL_TO:
-    for (auto iter { this->m_bitmaps.lower_bound(value) };
-         iter != end(this->m_bitmaps); ++iter) resultBitmap |= iter->second;
-    break;
-  case Token::LESS_THAN:
-    for (auto iter { begin(this->m_bitmaps) };
-         iter != this->m_bitmaps.lower_bound(value); ++iter) resultBitmap |= iter->second;
-    break;
-  case Token::LESS_THAN_OR_EQUAL_TO:
-    for (auto iter { begin(this->m_bitmaps) };
-         iter != this->m_bitmaps.upper_bound(value); ++iter) resultBitmap |= iter->second;
-    break;
-  default: break;
+  case Token::GREATER_THAN: unionOf(upperBound_helper(value), valueCount); break;
+  case Token::GREATER_THAN_OR_EQUAL_TO: unionOf(lowerBound_helper(value), valueCount); break;
+  case Token::LESS_THAN: unionOf(0, lowerBound_helper(value)); break;
+  case Token::LESS_THAN_OR_EQUAL_TO: unionOf(0, upperBound_helper(value)); break;
+  default: resultBitmap.reset(); break;
   }
-  return resultBitmap;
 }
 
-const std::map<ValueType, Bitmap> &BitmapIndex::getAllBitmaps() const { return this->m_bitmaps; }
+const Bitmap &BitmapIndex::getNotNullBitmap() {
+  ensureLoaded_helper();
+  return this->m_notNullBitmap;
+}
+
+void BitmapIndex::collectBitmap(const ValueType &value, std::vector<const Bitmap *> &bitmaps) {
+  ensureLoaded_helper();
+  const Bitmap *bitmap { find_helper(value) };
+  if (nullptr not_eq bitmap) bitmaps.emplace_back(bitmap);
+}
+
+void BitmapIndex::collectRangeBitmaps(const ValueType &low, const ValueType &high,
+                                      std::vector<const Bitmap *> &bitmaps) {
+  ensureLoaded_helper();
+  if (high < low) return;
+  ValueCodeType last { upperBound_helper(high) };
+  for (ValueCodeType code { lowerBound_helper(low) }; code < last; ++code) {
+    bitmaps.emplace_back(this->m_bitmaps[code].get());
+  }
+}
+
+void BitmapIndex::collectMatchingBitmaps(const std::string &pattern, std::vector<const Bitmap *> &bitmaps) {
+  ensureLoaded_helper();
+  if (AttributeKind::STRING not_eq this->m_schema.m_kind) throw std::runtime_error("like needs a string attribute");
+  size_t wildcardPos { pattern.find('%') };
+  if (std::string::npos == wildcardPos) return collectBitmap(pattern, bitmaps);
+
+  // The values starting with a prefix are consecutive in the ordered values
+  if (pattern.size() - 1 == wildcardPos) {
+    std::string_view prefix { pattern.data(), wildcardPos };
+    for (ValueCodeType code { lowerBound_helper(pattern.substr(0, wildcardPos)) };
+         code < this->m_values.size() and std::get<std::string>(this->m_values[code]->first).starts_with(prefix);
+         ++code) {
+      bitmaps.emplace_back(this->m_bitmaps[code].get());
+    }
+    return;
+  }
+
+  // The values ending with a suffix are consecutive once reversed
+  if (0 == wildcardPos and std::string::npos == pattern.find('%', 1)) {
+    ensureReversed_helper();
+    std::string reversedSuffix { rbegin(pattern), rend(pattern) - 1 };
+    for (auto iter { this->m_reversedBitmaps.lower_bound(reversedSuffix) };
+         iter != end(this->m_reversedBitmaps) and iter->first.starts_with(reversedSuffix); ++iter) {
+      bitmaps.emplace_back(iter->second);
+    }
+    return;
+  }
+
+  // Any other pattern is matched against every value, never against the records
+  for (ValueCodeType code { 0 }; code < this->m_values.size(); ++code) {
+    if (matchPattern(std::get<std::string>(this->m_values[code]->first), pattern)) {
+      bitmaps.emplace_back(this->m_bitmaps[code].get());
+    }
+  }
+}
+
+size_t BitmapIndex::getValueCount() {
+  ensureLoaded_helper();
+  return this->m_values.size();
+}
+
+std::optional<ValueCodeType> BitmapIndex::getCode(const ValueType &value) {
+  ensureLoaded_helper();
+  auto codeIter { this->m_codes.find(value) };
+  if (end(this->m_codes) == codeIter) return std::nullopt;
+  return codeIter->second;
+}
+
+const ValueType &BitmapIndex::getValue(ValueCodeType code) {
+  ensureLoaded_helper();
+  return this->m_values.at(code)->first;
+}
+
+size_t BitmapIndex::getMemoryUsage() const {
+  std::lock_guard lck { this->m_loadLatch };
+  size_t memoryUsage { this->m_section.capacity() };
+  if (not this->m_isLoaded) return memoryUsage;
 
-bool BitmapIndex::exist(const ValueType &value) { return this->m_bitmaps.count(value); }
+  memoryUsage += this->m_notNullBitmap.getMemoryUsage();
+  for (const auto &bitmap : this->m_bitmaps) memoryUsage += bitmap->getMemoryUsage();
+  return memoryUsage + this->m_recordValues.capacity() * sizeof(this->m_recordValues[0]);
+}
+
+bool BitmapIndex::save(IndexStore &indexStore) {
+  // A stub, or an index that has not changed since it was saved, keeps its section
+  if (not this->m_isLoaded or (not this->m_isDirty and nullptr not_eq this->m_indexStore)) return false;
+
+  indexStore.releasePages(this->m_releasedPageIDs);
+  this->m_releasedPageIDs.clear();
+
+  // Output the value count, the not null bitmap, then every value and its bitmap
+  std::ostringstream section;
+  section << this->m_bitmaps.size() << " ";
+  indexStore.writeBitmap(section, this->m_notNullBitmap);
+  for (ValueCodeType code { 0 }; code < this->m_bitmaps.size(); ++code) {
+    section << this->m_schema.format(this->m_values[code]->first) << " ";
+    indexStore.writeBitmap(section, *this->m_bitmaps[code]);
+  }
+
+  // The index can be unloaded until it changes again
+  this->m_section = section.str();
+  this->m_indexStore = &indexStore;
+  this->m_isDirty = false;
+  return true;
+}
+
+const std::string &BitmapIndex::getSection() const { return this->m_section; }
+
+void BitmapIndex::load(std::istream &in, IndexStore &indexStore) {
+  uint64_t valueCount;
+  in >> valueCount;
+  indexStore.readBitmap(in, this->m_notNullBitmap);
+  for (uint64_t i { 0 }; i < valueCount; ++i) {
+    std::string value;
+    in >> value;
+    // The values are saved in order, so each one takes the next code
+    indexStore.readBitmap(in, emplace_helper(this->m_schema.parse(value)));
+  }
+}
+
+void BitmapIndex::attach(std::string section, IndexStore &indexStore) {
+  this->m_section = std::move(section);
+  this->m_indexStore = &indexStore;
+  this->m_codes.clear();
+  this->m_values.clear();
+  this->m_bitmaps.clear();
+  this->m_reversedBitmaps.clear();
+  this->m_hasReversedBitmaps = false;
+  this->m_recordValues = { };
+  this->m_hasRecordValues = false;
+  this->m_notNullBitmap.clear();
+  this->m_isLoaded = false;
+}
+
+bool BitmapIndex::unload() {
+  std::lock_guard lck { this->m_loadLatch };
+  if (not this->m_isLoaded or this->m_isDirty or nullptr == this->m_indexStore) return false;
+
+  this->m_codes.clear();
+  this->m_values.clear();
+  this->m_bitmaps.clear();
+  this->m_reversedBitmaps.clear();
+  this->m_hasReversedBitmaps = false;
+  this->m_recordValues = { };
+  this->m_hasRecordValues = false;
+  this->m_notNullBitmap.clear();
+  this->m_isLoaded = false;
+  return true;
+}
+
+bool BitmapIndex::isLoaded() const { return this->m_isLoaded; }
+
+uint64_t BitmapIndex::getLastAccess() const { return this->m_lastAccess; }
+
+void BitmapIndex::ensureLoaded_helper() {
+  this->m_lastAccess = ms_accessClock++;
+  if (this->m_isLoaded) return;
+
+  std::lock_guard lck { this->m_loadLatch };
+  if (this->m_isLoaded) return;
+  // The length may have grown while the index was a stub
+  this->m_notNullBitmap.resize();
+  std::istringstream section { this->m_section };
+  load(section, *this->m_indexStore);
+  this->m_isLoaded = true;
+}
+
+void BitmapIndex::ensureReversed_helper() {
+  if (this->m_hasReversedBitmaps) return;
+
+  std::lock_guard lck { this->m_loadLatch };
+  if (this->m_hasReversedBitmaps) return;
+  for (ValueCodeType code { 0 }; code < this->m_values.size(); ++code) {
+    const std::string &value { std::get<std::string>(this->m_values[code]->first) };
+    this->m_reversedBitmaps.emplace(std::string { rbegin(value), rend(value) }, this->m_bitmaps[code].get());
+  }
+  this->m_hasReversedBitmaps = true;
+}
+
+void BitmapIndex::ensureRecordValues_helper() {
+  if (this->m_hasRecordValues) return;
+  this->m_recordValues.assign(this->m_bitmapLength, nullptr);
+  // Walk the set bits chunk by chunk, so that absent chunks and zero words cost nothing
+  for (ValueCodeType code { 0 }; code < this->m_bitmaps.size(); ++code) {
+    const Bitmap &bitmap { *this->m_bitmaps[code] };
+    for (uint64_t chunk { 0 }; chunk < bitmap.getChunkCount(); ++chunk) {
+      for (uint64_t bit : bitmap.getChunkBits(chunk)) {
+        this->m_recordValues[chunk * PAGE_SIZE * 8 + bit] = this->m_values[code];
+      }
+    }
+  }
+  this->m_hasRecordValues = true;
+}
+
+bool BitmapIndex::exist(const ValueType &value) { return this->m_codes.contains(value); }
+
+const Bitmap *BitmapIndex::find_helper(const ValueType &value) const {
+  auto codeIter { this->m_codes.find(value) };
+  return end(this->m_codes) == codeIter ? nullptr : this->m_bitmaps[codeIter->second].get();
+}
+
+ValueCodeType BitmapIndex::lowerBound_helper(const ValueType &value) const {
+  auto isLess { [&value](const auto *entry) { return entry->first < value; } };
+  return std::partition_point(begin(this->m_values), end(this->m_values), isLess) - begin(this->m_values);
+}
+
+ValueCodeType BitmapIndex::upperBound_helper(const ValueType &value) const {
+  auto isNotGreater { [&value](const auto *entry) { return entry->first <= value; } };
+  return std::partition_point(begin(this->m_values), end(this->m_values), isNotGreater) - begin(this->m_values);
+}
+
+Bitmap &BitmapIndex::emplace_helper(const ValueType &value) {
+  auto [codeIter, isNew] { this->m_codes.try_emplace(value, 0) };
+  if (not isNew) return *this->m_bitmaps[codeIter->second];
+
+  // Elements of m_codes keep their address, so the codes after the new one are moved up without hashing
+  ValueCodeType code { lowerBound_helper(value) };
+  this->m_values.emplace(begin(this->m_values) + code, &*codeIter);
+  this->m_bitmaps.emplace(begin(this->m_bitmaps) + code, std::make_unique<Bitmap>(this->m_bitmapLength));
+  for (ValueCodeType nextCode { code }; nextCode < this->m_values.size(); ++nextCode) {
+    this->m_values[nextCode]->second = nextCode;
+  }
+
+  Bitmap &bitmap { *this->m_bitmaps[code] };
+  if (this->m_hasReversedBitmaps) {
+    const std::string &text { std::get<std::string>(value) };
+    this->m_reversedBitmaps.emplace(std::string { rbegin(text), rend(text) }, &bitmap);
+  }
+  return bitmap;
+}
@@ -1,34 +1,303 @@
 #include "bitmap_index_manager.h"
+#include "sqlparser.h"
 
-RecordIterator::RecordIterator(const Bitmap &bitmap, BufferPoolManager &bufferPoolManager)
-    : m_bufferPoolManager { bufferPoolManager } {
+RecordIterator::RecordIterator(const Bitmap &bitmap, BufferPoolManager &bufferPoolManager, const TableSchema &schema)
+    : m_bufferPoolManager { bufferPoolManager }, m_schema { schema } {
   // Save all the recordID
-  for (const auto &recordID : bitmap) this->m_recordIDs.emplace(recordID);
+  for (const auto &recordID : bitmap) this->m_recordIDs.emplace_back(recordID);
+
+  // A result spanning a large part of the pool is read through a ring, so that it keeps the hot pages
+  if (not this->m_recordIDs.empty()) {
+    PageIDType pageSpan = (this->m_recordIDs.back() - this->m_recordIDs.front()) / schema.getRowsPerPage() + 1;
+    if (pageSpan > bufferPoolManager.getPoolSize() / SCAN_POOL_DIVISOR) this->m_ring.emplace();
+  }
 }
 
-bool RecordIterator::hasNext() { return not this->m_recordIDs.empty(); }
+bool RecordIterator::hasNext() { return this->m_currentPos < this->m_recordIDs.size(); }
+
+Row RecordIterator::next() {
+  // Tell the buffer pool which pages are coming before reaching them
+  if (this->m_currentPos == this->m_hintedPos) hintPages();
 
-Record RecordIterator::next() {
-  RecordIDType recordID { this->m_recordIDs.top() };
-  this->m_recordIDs.pop();
+  RecordIDType recordID { this->m_recordIDs[this->m_currentPos++] };
 
-  PageIDType pageID = recordID / MAX_PAGE_RECORD_SIZE;
-  char *data { this->m_bufferPoolManager.fetchPage(FileType::TABLE, pageID)->getData() };
-  Record record { reinterpret_cast<Record *>(data)[recordID % MAX_PAGE_RECORD_SIZE] };
+  RecordIDType rowsPerPage { this->m_schema.getRowsPerPage() };
+  PageIDType pageID = recordID / rowsPerPage;
+  PageHandle page { this->m_bufferPoolManager.fetchPageHandle(FileType::TABLE, pageID, getRing()) };
+  return Row { this->m_schema, page.getData() + recordID % rowsPerPage * this->m_schema.getRowSize() };
+}
 
-  this->m_bufferPoolManager.unpinPage(FileType::TABLE, pageID, false);
+void RecordIterator::hintPages() {
+  // Collect the next distinct page ids from the result bitmap
+  std::vector<PageIDType> pageIDs;
+  while (this->m_hintedPos < this->m_recordIDs.size()) {
+    PageIDType pageID = this->m_recordIDs[this->m_hintedPos] / this->m_schema.getRowsPerPage();
+    if (pageIDs.empty() or pageIDs.back() not_eq pageID) {
+      if (HINT_PAGES == pageIDs.size()) break;
+      pageIDs.emplace_back(pageID);
+    }
+    ++this->m_hintedPos;
+  }
 
-  return record;
+  // A single page does not need any hint, the fetch reads it anyway
+  if (1 < pageIDs.size()) this->m_bufferPoolManager.prefetchPages(FileType::TABLE, pageIDs, getRing());
 }
 
+BufferRing *RecordIterator::getRing() { return this->m_ring ? &*this->m_ring : nullptr; }
+
 BitmapIndexManager::BitmapIndexManager(const std::string &tableName,
-                                       BufferPoolManager &bufferPoolManager)
-    : m_tableName { tableName }, m_nextRecordID { 0 },
-      m_existenceBitmap { m_nextRecordID }, m_bufferPoolManager { bufferPoolManager } {
+                                       BufferPoolManager &bufferPoolManager,
+                                       std::chrono::microseconds groupCommitWindow,
+                                       uint64_t checkpointLogSize,
+                                       const TableSchema &schema)
+    : m_tableName { tableName }, m_schema { schema }, m_nextRecordID { 0 },
+      m_existenceBitmap { m_nextRecordID }, m_columnIndices(schema.getColumnCount()),
+      m_bufferPoolManager { bufferPoolManager }, m_indexStore { bufferPoolManager },
+      m_log { tableName + ".wal", groupCommitWindow }, m_checkpointLogSize { checkpointLogSize } {
   // Check if the file exists
+  LSNType checkpointLSN { INVALID_LSN };
   std::ifstream fin { tableName };
-  if (not fin.is_open()) { return; }
+  if (fin.is_open()) {
+    // A catalog starts with its header, anything else is the old text dump of the whole index
+    std::string header;
+    fin >> header;
+    if (CATALOG_HEADER == header) {
+      fin >> checkpointLSN;
+      load_helper(fin);
+    } else if (header.starts_with(CATALOG_HEADER_PREFIX)) {
+      throw std::runtime_error("unsupported index catalog version: " + header);
+    } else {
+      fin.clear();
+      fin.seekg(0);
+      loadLegacy_helper(fin);
+    }
+  }
+
+  // The files may still end with a preallocated extent, the catalog tells which pages are in use
+  FileStore *fileStore { this->m_bufferPoolManager.getFileStore() };
+  RecordIDType rowsPerPage { this->m_schema.getRowsPerPage() };
+  fileStore->setPageCount(FileType::TABLE, (this->m_nextRecordID + rowsPerPage - 1) / rowsPerPage);
+  fileStore->setPageCount(FileType::INDEX, this->m_indexStore.getPageCount());
+
+  // Table pages changed by a logged change are written only after the log
+  this->m_bufferPoolManager.setLogFlusher([this](LSNType lsn) { this->m_log.flush(lsn); });
+
+  // Redo the changes made after the checkpoint
+  this->m_log.replay(checkpointLSN, [this](const LogRecord &record) { redo_helper(record); });
+}
+
+BitmapIndexManager::~BitmapIndexManager() {
+  stopBackgroundCheckpointer();
+  checkpoint();
+  this->m_bufferPoolManager.setLogFlusher({});
+}
+
+void BitmapIndexManager::checkpoint() {
+  std::unique_lock lck { this->m_latch };
+  checkpoint_helper();
+}
+
+void BitmapIndexManager::checkpoint_helper() {
+  // 1.   Store the changed chunks into free pages and encode the sections of the changed attributes,
+  //      every attribute independently of the others.
+  // 2.   Append the changed sections to the segment, or write all of them into a new segment once most of the
+  //      segment is dead.
+  // 3.   Make the pages, the segment and the new manifest durable, then replace the manifest at once and make the
+  //      replacement durable, a crash leaves either the old or the new one with everything it refers to.
+  // 4.   Free the pages and the segment only the old manifest referred to, and empty the log.
+  // Everything logged so far is contained in the checkpoint
+  LSNType checkpointLSN { this->m_log.getLastLSN() };
+  this->m_log.flush(checkpointLSN);
+
+  std::ostringstream manifest;
+  manifest << CATALOG_HEADER << " " << checkpointLSN << " ";
+  this->m_schema.write(manifest);
+  manifest << this->m_nextRecordID << " " << this->m_bitmapIndices.size() << " ";
+  this->m_indexStore.writeBitmap(manifest, this->m_existenceBitmap);
+
+  std::vector<std::pair<const std::string, BitmapIndex> *> attributes;
+  for (auto &attribute : this->m_bitmapIndices) attributes.emplace_back(&attribute);
+  std::vector<char> isChanged(attributes.size());
+  forEachParallel_helper(attributes.size(), [&](size_t i) {
+    isChanged[i] = attributes[i]->second.save(this->m_indexStore);
+  });
+  this->m_indexStore.writeAllocation(manifest);
+  this->m_bufferPoolManager.flushAllPages();
+  FileStore *fileStore { this->m_bufferPoolManager.getFileStore() };
+  fileStore->sync(FileType::TABLE);
+  fileStore->sync(FileType::INDEX);
+
+  // Sections of attributes that have not changed stay where they are
+  uint64_t liveSize { 0 }, changedSize { 0 };
+  for (size_t i { 0 }; i < attributes.size(); ++i) {
+    uint64_t sectionSize { attributes[i]->second.getSection().size() };
+    liveSize += sectionSize;
+    if (isChanged[i] or not this->m_sectionLocations.count(attributes[i]->first)) changedSize += sectionSize;
+  }
+  bool isCompacting { this->m_segmentSize >= MIN_COMPACTION_SIZE and
+                      this->m_segmentSize + changedSize > 2 * liveSize };
+
+  uint64_t segmentGeneration { this->m_segmentGeneration + isCompacting };
+  uint64_t segmentSize { isCompacting ? 0 : this->m_segmentSize };
+  auto sectionLocations { isCompacting ? SectionLocationType {} : this->m_sectionLocations };
+  std::string segmentName { getSegmentName_helper(segmentGeneration) };
+  {
+    // Drop what a failed checkpoint may have appended
+    std::error_code error;
+    if (not isCompacting) std::filesystem::resize_file(segmentName, segmentSize, error);
+
+    std::ofstream segment { segmentName, std::ios::binary | (isCompacting ? std::ios::trunc : std::ios::app) };
+    for (size_t i { 0 }; i < attributes.size(); ++i) {
+      const auto &[attributeName, bitmapIndex] { *attributes[i] };
+      if (not isCompacting and not isChanged[i] and sectionLocations.count(attributeName)) continue;
+      segment << bitmapIndex.getSection();
+      sectionLocations[attributeName] = { segmentSize, bitmapIndex.getSection().size() };
+      segmentSize += bitmapIndex.getSection().size();
+    }
+    if (not segment.flush()) throw std::runtime_error("fail to write index segment");
+  }
+  FileStore::syncFile(segmentName);
+
+  // The location table finds the section of every attribute in the segment
+  manifest << segmentGeneration << " " << segmentSize << " ";
+  for (const auto &[attributeName, location] : sectionLocations) {
+    manifest << attributeName << " " << location.first << " " << location.second << " ";
+  }
+
+  // Replace the manifest at once, a crash leaves either the old or the new one
+  std::string temporaryName { this->m_tableName + ".tmp" };
+  {
+    std::ofstream fout { temporaryName };
+    fout << manifest.str();
+    if (not fout.flush()) throw std::runtime_error("fail to write index catalog");
+  }
+  FileStore::syncFile(temporaryName);
+  FileStore::replaceFile(temporaryName, this->m_tableName);
+  FileStore::syncDirectory(this->m_tableName);
+
+  // Nothing the old manifest refers to is reused or removed before the new one is durable
+  this->m_indexStore.commitReleasedPages();
+  if (isCompacting) {
+    std::error_code error;
+    std::filesystem::remove(getSegmentName_helper(this->m_segmentGeneration), error);
+  }
+  this->m_segmentGeneration = segmentGeneration;
+  this->m_segmentSize = segmentSize;
+  this->m_sectionLocations = std::move(sectionLocations);
+
+  // The log is only needed if the new catalog is lost, its records are skipped by the checkpoint lsn anyway
+  this->m_log.truncate();
+}
+
+void BitmapIndexManager::startBackgroundCheckpointer(std::chrono::milliseconds interval) {
+  stopBackgroundCheckpointer();
+  this->m_stopCheckpointer = false;
+  this->m_checkpointerThread = std::thread { &BitmapIndexManager::backgroundCheckpointerMain, this, interval };
+}
+
+void BitmapIndexManager::stopBackgroundCheckpointer() {
+  if (not this->m_checkpointerThread.joinable()) return;
+  {
+    std::lock_guard lck { this->m_checkpointerLatch };
+    this->m_stopCheckpointer = true;
+  }
+  this->m_checkpointerCondition.notify_all();
+  this->m_checkpointerThread.join();
+}
+
+void BitmapIndexManager::backgroundCheckpointerMain(std::chrono::milliseconds interval) {
+  std::unique_lock lck { this->m_checkpointerLatch };
+  while (not this->m_checkpointerCondition.wait_for(lck, interval, [this] { return this->m_stopCheckpointer; })) {
+    // Nothing has been logged since the last checkpoint
+    if (0 == this->m_log.getSize()) continue;
+
+    lck.unlock();
+    try {
+      checkpoint();
+    } catch (const std::exception &) {
+      // The log keeps the changes, the next round tries again
+    }
+    lck.lock();
+  }
+}
+
+std::string BitmapIndexManager::getSegmentName_helper(uint64_t segmentGeneration) const {
+  return this->m_tableName + ".seg" + std::to_string(segmentGeneration);
+}
+
+void BitmapIndexManager::load_helper(std::istream &fin) {
+  // The rows on disk are laid out by the schema the table was created with
+  if (TableSchema::read(fin) not_eq this->m_schema) throw std::runtime_error("table schema does not match the catalog");
 
+  // Get the next record id, the attribute count and the existence bitmap
+  uint64_t attributeCount;
+  fin >> this->m_nextRecordID >> attributeCount;
+  this->m_existenceBitmap.resize();
+  this->m_indexStore.readBitmap(fin, this->m_existenceBitmap);
+  this->m_indexStore.readAllocation(fin);
+
+  // Read the location table of the segment
+  fin >> this->m_segmentGeneration >> this->m_segmentSize;
+  for (uint64_t i { 0 }; i < attributeCount; ++i) {
+    std::string attributeName;
+    uint64_t offset, size;
+    fin >> attributeName >> offset >> size;
+    this->m_sectionLocations[attributeName] = { offset, size };
+  }
+
+  // A checkpoint that did not complete may have appended to the segment
+  std::string segmentName { getSegmentName_helper(this->m_segmentGeneration) };
+  std::error_code error;
+  std::filesystem::resize_file(segmentName, this->m_segmentSize, error);
+  std::ifstream segment { segmentName, std::ios::binary };
+  if (0 < attributeCount and not segment.is_open()) throw std::runtime_error("fail to open index segment");
+
+  // Every attribute starts as a stub, its bitmaps are loaded from its section on first use
+  for (const auto &[attributeName, location] : this->m_sectionLocations) {
+    std::string section(location.second, ' ');
+    segment.seekg(location.first);
+    segment.read(section.data(), location.second);
+    if (static_cast<uint64_t>(segment.gcount()) < location.second) {
+      throw std::runtime_error("index segment is truncated");
+    }
+    getIndex_helper(this->m_schema.getColumnID(attributeName)).attach(std::move(section), this->m_indexStore);
+  }
+}
+
+void BitmapIndexManager::forEachParallel_helper(size_t count, const std::function<void(size_t)> &task) {
+  size_t threadCount { std::min<size_t>(count, std::max(1U, std::thread::hardware_concurrency())) };
+
+  // Workers take the next task until none is left, the first error is rethrown once all have stopped
+  std::atomic<size_t> nextTask { 0 };
+  std::exception_ptr error;
+  std::mutex errorLatch;
+  auto worker { [&] {
+    for (size_t i { nextTask++ }; i < count; i = nextTask++) {
+      try {
+        task(i);
+      } catch (...) {
+        std::lock_guard lck { errorLatch };
+        if (not error) error = std::current_exception();
+      }
+    }
+  } };
+
+  std::vector<std::thread> threads;
+  for (size_t i { 1 }; i < threadCount; ++i) {
+    try {
+      threads.emplace_back(worker);
+    } catch (const std::system_error &) {
+      // No more threads available, the ones running take the rest
+      break;
+    }
+  }
+  worker();
+  for (auto &thread : threads) thread.join();
+
+  if (error) std::rethrow_exception(error);
+}
+
+void BitmapIndexManager::loadLegacy_helper(std::istream &fin) {
   // Get the next record id , the attribute count and the existence bitmap
   uint64_t nextRecordID, attributeCount;
   std::string existenceBitmap;
@@ -53,193 +322,461 @@ BitmapIndexManager::BitmapIndexManager(const std::string &tableName,
     fin >> attributeName >> valueCount;
 
     // Create the attribute bitmap index
-    this->m_bitmapIndices.emplace(attributeName, this->m_nextRecordID);
+    BitmapIndex &bitmapIndex { getIndex_helper(this->m_schema.getColumnID(attributeName)) };
 
     for (uint64_t j {0}; j < valueCount; ++j) {
       // Get the value and the serialized bitmap
-      ValueType value;
+      std::string value;
       std::string bitmap;
       fin >> value >> bitmap;
+      ValueType typedValue { bitmapIndex.getSchema().parse(value) };
 
       // Deserialize bitmap
       Bitmap::deserialize(bitmap);
 
       // Create bitmap
       for (uint64_t pos { 0 }; pos < bitmap.length(); ++pos) {
-        if ('1' == bitmap[pos]) this->m_bitmapIndices.at(attributeName).setBitmapBit(value, pos);
+        if ('1' == bitmap[pos]) bitmapIndex.setBitmapBit(typedValue, pos);
       }
     }
   }
 }
 
-BitmapIndexManager::~BitmapIndexManager() {
-  // Output the next record id, the attribute count and the existence bitmap
-  std::ofstream fout { this->m_tableName };
-  fout << this->m_nextRecordID << " " << this->m_bitmapIndices.size() << " "
-      << this->m_existenceBitmap.serialize() << " ";
-
-  for (const auto &[attributeName, bitmapIndex] : this->m_bitmapIndices) {
-    // Output the attribute name and the value count
-    fout << attributeName << " " << bitmapIndex.getAllBitmaps().size() << " ";
-    for (const auto &[value, bitmap] : bitmapIndex.getAllBitmaps()) {
-      // Output the value and the serialized bitmap
-      fout << value << " " << bitmap.serialize() << " ";
-    }
-  }
-}
-
 uint64_t BitmapIndexManager::count(const ConditionType &conditions) {
+  std::shared_lock lck { this->m_latch };
   // Extract out the bitmap and count the bitmap
   return conditionToBitmap(conditions).popCount();
 }
 
 uint64_t BitmapIndexManager::remove(const ConditionType &conditions) {
-  // Find the record that need to be removed
-  Bitmap removeBitmap { conditionToBitmap(conditions) };
-  for (const auto &pos : removeBitmap) {
-    // Find one record! Remove all related bits
-    for (auto &[attributeName, bitmapIndex] : this->m_bitmapIndices) {
-      bitmapIndex.clearAllBitmapBits(pos);
-    }
-
-    // Clear the existence bitmap
-    this->m_existenceBitmap.clearBit(pos);
+  std::vector<RecordIDType> recordIDs;
+  LSNType lsn { INVALID_LSN };
+  {
+    std::unique_lock lck { this->m_latch };
+    // Find the record that need to be removed
+    for (const auto &pos : conditionToBitmap(conditions)) recordIDs.emplace_back(pos);
+    if (recordIDs.empty()) return 0;
+
+    lsn = this->m_log.append(LogOperation::REMOVE, recordIDs, {});
+    removeAll_helper(recordIDs);
   }
+  commit_helper(lsn);
 
   // Return the total record infected
-  return removeBitmap.popCount();
+  return recordIDs.size();
 }
 
 void BitmapIndexManager::insert(const AttributeType &attributes) {
-  // Find a 0 in existence bitmap，If we fine one, then insert the data
-  for (const auto &pos : ~this->m_existenceBitmap) { insert_helper(attributes, pos); return; }
+  LSNType lsn { INVALID_LSN };
+  {
+    std::unique_lock lck { this->m_latch };
+    // Find a 0 in existence bitmap，If we do not find any one of it, create a new one
+    uint64_t pos { this->m_nextRecordID };
+    for (const auto &freePos : ~this->m_existenceBitmap) { pos = freePos; break; }
+
+    // A change that does not fit the schema is rejected before it is logged
+    std::vector<ColumnIDType> columnIDs { getColumnIDs_helper(attributes) };
+    lsn = this->m_log.append(LogOperation::INSERT, { pos }, attributes);
+    insertAt_helper(attributes, columnIDs, pos, lsn);
+  }
+  commit_helper(lsn);
+}
 
-  // Check if we need to append a new page
-  if (0 == this->m_nextRecordID % MAX_PAGE_RECORD_SIZE) {
-    this->m_bufferPoolManager.appendNewPage(FileType::TABLE,
-                                            this->m_nextRecordID / MAX_PAGE_RECORD_SIZE);
+uint64_t BitmapIndexManager::update(const ConditionType &conditions,
+                                    const AttributeType &attributes) {
+  std::vector<RecordIDType> recordIDs;
+  LSNType lsn { INVALID_LSN };
+  {
+    std::unique_lock lck { this->m_latch };
+    for (const auto &pos : conditionToBitmap(conditions)) recordIDs.emplace_back(pos);
+    if (recordIDs.empty()) return 0;
+
+    getColumnIDs_helper(attributes);
+    lsn = this->m_log.append(LogOperation::UPDATE, recordIDs, attributes);
+    updateAll_helper(recordIDs, attributes, lsn);
   }
+  commit_helper(lsn);
 
-  // If we do not find any one of it, create a new one
-  ++this->m_nextRecordID;
-  this->m_existenceBitmap.resize();
-  for (auto &[attributeName, bitmapIndex] : this->m_bitmapIndices) bitmapIndex.resize();
+  // Return the total record infected
+  return recordIDs.size();
+}
 
-  // Insert the data
-  insert_helper(attributes, this->m_nextRecordID - 1);
+RecordIterator BitmapIndexManager::select(const ConditionType &conditions) {
+  std::shared_lock lck { this->m_latch };
+  return RecordIterator { conditionToBitmap(conditions), this->m_bufferPoolManager, this->m_schema };
 }
 
-uint64_t BitmapIndexManager::update(const ConditionType &conditions,
-                                    const AttributeType &attributes) {
-  Bitmap needToUpdate { conditionToBitmap(conditions) };
+PreparedStatement BitmapIndexManager::prepare(std::string_view sql) {
+  SQL statement { sql, this->m_schema };
+  if (Token::SELECT not_eq statement.m_operationType and Token::COUNT not_eq statement.m_operationType) {
+    throw std::runtime_error("only select and count statements can be prepared");
+  }
 
-  for (const auto &pos : needToUpdate) {
-    for (const auto &[attributeName, value] : attributes) {
-      this->m_bitmapIndices.at(attributeName).clearAllBitmapBits(pos);
-      this->m_bitmapIndices.at(attributeName).setBitmapBit(value, pos);
-    }
+  std::shared_lock lck { this->m_latch };
+  return compile_helper(statement.m_operationType, statement.m_conditions);
+}
+
+uint64_t BitmapIndexManager::count(const PreparedStatement &statement, const std::vector<std::string> &parameters) {
+  std::shared_lock lck { this->m_latch };
+  return execute_helper(statement, parameters).popCount();
+}
+
+RecordIterator BitmapIndexManager::select(const PreparedStatement &statement,
+                                          const std::vector<std::string> &parameters) {
+  std::shared_lock lck { this->m_latch };
+  return RecordIterator { execute_helper(statement, parameters), this->m_bufferPoolManager, this->m_schema };
+}
+
+Bitmap BitmapIndexManager::execute(const PreparedStatement &statement, const std::vector<std::string> &parameters) {
+  std::shared_lock lck { this->m_latch };
+  Bitmap resultBitmap { this->m_nextRecordID };
+  resultBitmap.assign(execute_helper(statement, parameters));
+  return resultBitmap;
+}
 
-    // Update the record to the disk
-    update_helper(attributes, pos);
+size_t BitmapIndexManager::unloadColdIndices(size_t memoryLimit) {
+  std::unique_lock lck { this->m_latch };
+
+  // Unload the least recently used attributes first
+  std::vector<BitmapIndex *> bitmapIndices;
+  for (auto &[attributeName, bitmapIndex] : this->m_bitmapIndices) {
+    if (bitmapIndex.isLoaded()) bitmapIndices.emplace_back(&bitmapIndex);
+  }
+  std::sort(begin(bitmapIndices), end(bitmapIndices), [](const BitmapIndex *lhs, const BitmapIndex *rhs) {
+    return lhs->getLastAccess() < rhs->getLastAccess();
+  });
+
+  size_t memoryUsage { getMemoryUsage_helper() };
+  for (auto bitmapIndex : bitmapIndices) {
+    if (memoryUsage <= memoryLimit) break;
+    size_t indexMemoryUsage { bitmapIndex->getMemoryUsage() };
+    // An attribute changed since the last checkpoint stays
+    if (bitmapIndex->unload()) memoryUsage -= indexMemoryUsage - bitmapIndex->getMemoryUsage();
   }
+  return memoryUsage;
+}
 
-  // Return the total record infected
-  return needToUpdate.popCount();
+size_t BitmapIndexManager::getMemoryUsage() const {
+  std::shared_lock lck { this->m_latch };
+  return getMemoryUsage_helper();
 }
 
-RecordIterator BitmapIndexManager::select(const ConditionType &conditions) {
-  return RecordIterator { conditionToBitmap(conditions), this->m_bufferPoolManager };
+const TableSchema &BitmapIndexManager::getSchema() const { return this->m_schema; }
+
+size_t BitmapIndexManager::getMemoryUsage_helper() const {
+  size_t memoryUsage { this->m_existenceBitmap.getMemoryUsage() };
+  for (const auto &[attributeName, bitmapIndex] : this->m_bitmapIndices) {
+    memoryUsage += bitmapIndex.getMemoryUsage();
+  }
+  return memoryUsage;
 }
 
 bool BitmapIndexManager::exist(const std::string &attributeName) {
   return this->m_bitmapIndices.count(attributeName);
 }
 
-void BitmapIndexManager::insert_helper(const AttributeType &attributes, uint64_t pos) {
-  // Set the existence bitmap
-  this->m_existenceBitmap.setBit(pos);
+void BitmapIndexManager::insertAt_helper(const AttributeType &attributes, const std::vector<ColumnIDType> &columnIDs,
+                                         uint64_t pos, LSNType lsn) {
+  RecordIDType rowsPerPage { this->m_schema.getRowsPerPage() };
+  while (this->m_nextRecordID <= pos) {
+    // Check if we need to append a new page
+    if (0 == this->m_nextRecordID % rowsPerPage) {
+      PageIDType pageID = this->m_nextRecordID / rowsPerPage;
+      this->m_bufferPoolManager.appendNewPage(FileType::TABLE, pageID);
+      // The new page is pinned, release it so that it can be evicted once written
+      this->m_bufferPoolManager.unpinPage(FileType::TABLE, pageID, true);
+    }
 
-  PageIDType pageID = pos / MAX_PAGE_RECORD_SIZE;
-  char *data { this->m_bufferPoolManager.fetchPage(FileType::TABLE, pageID)->getData() };
-  Record &record { reinterpret_cast<Record *>(data)[pos % MAX_PAGE_RECORD_SIZE] };
-  record = {};
+    ++this->m_nextRecordID;
+    this->m_existenceBitmap.resize();
+    for (auto &[attributeName, bitmapIndex] : this->m_bitmapIndices) bitmapIndex.resize();
+  }
 
-  // Set related bits by the way
-  for (const auto &[attributeName, value] : attributes) {
-    if (not exist(attributeName)) {
-      this->m_bitmapIndices.emplace(attributeName, this->m_nextRecordID);
-    }
+  // Insert the data
+  insert_helper(attributes, columnIDs, pos, lsn);
+}
 
-    this->m_bitmapIndices.at(attributeName).setBitmapBit(value, pos);
-    // Hardcoded not good
-    if ("name" == attributeName) strcpy_s(record.m_name, value.c_str());
-    else if ("age" == attributeName) record.m_age = std::stoi(value);
-    else if ("gender" == attributeName) {
-      if ("male" == value) record.m_gender = Gender::MALE;
-      else record.m_gender = Gender::FEMALE;
-    } else {
-      if ("ComputerScience" == value) record.m_department = Department::COMPUTER_SCIENCE;
-      else if ("Chemistry" == value) record.m_department = Department::CHEMISTRY;
-      else if ("Physics" == value) record.m_department = Department::PHYSICS;
-      else record.m_department = Department::FOREIGN_LANG;
+void BitmapIndexManager::updateAll_helper(const std::vector<RecordIDType> &recordIDs,
+                                          const AttributeType &attributes, LSNType lsn) {
+  // The columns are resolved once for all the records
+  std::vector<ColumnIDType> columnIDs { getColumnIDs_helper(attributes) };
+  for (const auto &pos : recordIDs) update_helper(attributes, columnIDs, pos, lsn);
+}
+
+void BitmapIndexManager::removeAll_helper(const std::vector<RecordIDType> &recordIDs) {
+  for (const auto &pos : recordIDs) {
+    // Find one record! Remove all related bits
+    for (auto &[attributeName, bitmapIndex] : this->m_bitmapIndices) {
+      bitmapIndex.clearAllBitmapBits(pos);
     }
+
+    // Clear the existence bitmap
+    this->m_existenceBitmap.clearBit(pos);
   }
+}
 
-  this->m_bufferPoolManager.unpinPage(FileType::TABLE, pageID, true);
+void BitmapIndexManager::redo_helper(const LogRecord &record) {
+  try {
+    switch (record.m_operation) {
+    case LogOperation::INSERT:
+      insertAt_helper(record.m_attributes, getColumnIDs_helper(record.m_attributes), record.m_recordIDs.front(),
+                      record.m_lsn);
+      break;
+    case LogOperation::UPDATE: updateAll_helper(record.m_recordIDs, record.m_attributes, record.m_lsn); break;
+    case LogOperation::REMOVE: removeAll_helper(record.m_recordIDs); break;
+    }
+  } catch (const std::exception &) {
+    // The change failed at the same point when it was made, what it did until then is redone
+  }
 }
 
-void BitmapIndexManager::update_helper(const AttributeType &attributes, uint64_t pos) {
-  PageIDType pageID = pos / MAX_PAGE_RECORD_SIZE;
-  char *data { this->m_bufferPoolManager.fetchPage(FileType::TABLE, pageID)->getData() };
-  Record &record { reinterpret_cast<Record *>(data)[pos % MAX_PAGE_RECORD_SIZE] };
+void BitmapIndexManager::commit_helper(LSNType lsn) {
+  this->m_log.commit(lsn);
+
+  if (this->m_log.getSize() >= this->m_checkpointLogSize) {
+    std::unique_lock lck { this->m_latch };
+    // Another change may have taken the checkpoint meanwhile
+    if (this->m_log.getSize() >= this->m_checkpointLogSize) checkpoint_helper();
+  }
+}
 
-  // Set related bits by the way
+std::vector<ColumnIDType> BitmapIndexManager::getColumnIDs_helper(const AttributeType &attributes) const {
+  std::vector<ColumnIDType> columnIDs;
+  columnIDs.reserve(attributes.size());
   for (const auto &[attributeName, value] : attributes) {
-    if (not exist(attributeName)) {
-      this->m_bitmapIndices.emplace(attributeName, this->m_nextRecordID);
+    ColumnIDType columnID { this->m_schema.getColumnID(attributeName) };
+    // An integer or an enumerator is held as a number, everything else as text
+    bool isText { AttributeKind::STRING == this->m_schema.getColumn(columnID).m_attribute.m_kind };
+    if (isText not_eq std::holds_alternative<std::string>(value)) {
+      throw std::runtime_error("wrong value type for column " + attributeName);
     }
+    columnIDs.emplace_back(columnID);
+  }
+  return columnIDs;
+}
 
-    this->m_bitmapIndices.at(attributeName).setBitmapBit(value, pos);
-    // Hardcoded not good
-    if ("name" == attributeName) strcpy_s(record.m_name, value.c_str());
-    else if ("age" == attributeName) record.m_age = std::stoi(value);
-    else if ("gender" == attributeName) {
-      if ("male" == value) record.m_gender = Gender::MALE;
-      else record.m_gender = Gender::FEMALE;
-    } else {
-      if ("ComputerScience" == value) record.m_department = Department::COMPUTER_SCIENCE;
-      else if ("Chemistry") record.m_department = Department::CHEMISTRY;
-      else if ("Physics") record.m_department = Department::PHYSICS;
-      else record.m_department = Department::FOREIGN_LANG;
-    }
+BitmapIndex &BitmapIndexManager::getIndex_helper(ColumnIDType columnID) {
+  BitmapIndex *&bitmapIndex { this->m_columnIndices[columnID] };
+  if (nullptr == bitmapIndex) {
+    const ColumnSchema &column { this->m_schema.getColumn(columnID) };
+    bitmapIndex = &this->m_bitmapIndices.try_emplace(column.m_name, this->m_nextRecordID, column.m_attribute)
+                       .first->second;
   }
+  return *bitmapIndex;
+}
+
+void BitmapIndexManager::insert_helper(const AttributeType &attributes, const std::vector<ColumnIDType> &columnIDs,
+                                       uint64_t pos, LSNType lsn) {
+  // Set the existence bitmap
+  this->m_existenceBitmap.setBit(pos);
+
+  RecordIDType rowsPerPage { this->m_schema.getRowsPerPage() };
+  PageHandle page { this->m_bufferPoolManager.fetchPageHandle(FileType::TABLE, pos / rowsPerPage) };
+  page.markDirty(lsn);
+  ByteType *row { page.getData() + pos % rowsPerPage * this->m_schema.getRowSize() };
+  this->m_schema.clearRow(row);
 
-  this->m_bufferPoolManager.unpinPage(FileType::TABLE, pageID, true);
+  // Set related bits by the way, a column left out stays null
+  for (size_t i { 0 }; i < attributes.size(); ++i) {
+    getIndex_helper(columnIDs[i]).setBitmapBit(attributes[i].second, pos);
+    this->m_schema.writeValue(row, columnIDs[i], attributes[i].second);
+  }
 }
 
-Bitmap BitmapIndexManager::conditionToBitmap(const ConditionType &conditions) {
-  // If the condition is empty, then returns the existence bitmap
-  if (conditions.empty()) return this->m_existenceBitmap;
+void BitmapIndexManager::update_helper(const AttributeType &attributes, const std::vector<ColumnIDType> &columnIDs,
+                                       uint64_t pos, LSNType lsn) {
+  RecordIDType rowsPerPage { this->m_schema.getRowsPerPage() };
+  PageHandle page { this->m_bufferPoolManager.fetchPageHandle(FileType::TABLE, pos / rowsPerPage) };
+  page.markDirty(lsn);
+  ByteType *row { page.getData() + pos % rowsPerPage * this->m_schema.getRowSize() };
+
+  // Move the record to the bitmaps of its new values
+  for (size_t i { 0 }; i < attributes.size(); ++i) {
+    BitmapIndex &bitmapIndex { getIndex_helper(columnIDs[i]) };
+    bitmapIndex.clearAllBitmapBits(pos);
+    bitmapIndex.setBitmapBit(attributes[i].second, pos);
+    this->m_schema.writeValue(row, columnIDs[i], attributes[i].second);
+  }
+}
+
+const Bitmap &BitmapIndexManager::conditionToBitmap(const ConditionType &conditions) {
+  return execute_helper(compile_helper(Token::SELECT, conditions), {});
+}
 
-  std::stack<Bitmap> stack;
+PreparedStatement BitmapIndexManager::compile_helper(Token operationType, const ConditionType &conditions) {
+  using Instruction = PreparedStatement::Instruction;
+  using OpCode = PreparedStatement::OpCode;
+  PreparedStatement statement;
+  statement.m_operationType = operationType;
+  statement.m_instructions.reserve(conditions.size());
+  auto isLeaf { [](const Instruction &instruction) {
+    return OpCode::AND not_eq instruction.m_opCode and OpCode::OR not_eq instruction.m_opCode;
+  } };
+  auto isEquality { [](const Instruction &instruction) {
+    return (OpCode::UNION == instruction.m_opCode and not instruction.m_isNegated) or
+           (OpCode::LOAD == instruction.m_opCode and Token::EQUAL == instruction.m_comparator);
+  } };
+  auto isBound { [](const Instruction &instruction, Token comparator) {
+    return OpCode::LOAD == instruction.m_opCode and comparator == instruction.m_comparator;
+  } };
+  // A condition is negated within the records having a value, as a comparison with no value is not true either way
+  auto negate { [](Instruction &instruction) {
+    switch (instruction.m_opCode) {
+    case OpCode::AND: instruction.m_opCode = OpCode::OR; break;
+    case OpCode::OR: instruction.m_opCode = OpCode::AND; break;
+    case OpCode::UNION:
+    case OpCode::RANGE:
+    case OpCode::MATCH: instruction.m_isNegated = not instruction.m_isNegated; break;
+    case OpCode::LOAD:
+      switch (instruction.m_comparator) {
+      case Token::EQUAL: instruction.m_comparator = Token::NOT_EQUAL; break;
+      case Token::NOT_EQUAL: instruction.m_comparator = Token::EQUAL; break;
+      case Token::IS_NULL: instruction.m_comparator = Token::IS_NOT_NULL; break;
+      case Token::IS_NOT_NULL: instruction.m_comparator = Token::IS_NULL; break;
+      case Token::GREATER_THAN: instruction.m_comparator = Token::LESS_THAN_OR_EQUAL_TO; break;
+      case Token::GREATER_THAN_OR_EQUAL_TO: instruction.m_comparator = Token::LESS_THAN; break;
+      case Token::LESS_THAN: instruction.m_comparator = Token::GREATER_THAN_OR_EQUAL_TO; break;
+      case Token::LESS_THAN_OR_EQUAL_TO: instruction.m_comparator = Token::GREATER_THAN; break;
+      default: throw std::runtime_error("malformed condition");
+      }
+      break;
+    }
+  } };
 
+  // The postfix conditions run on a stack, the register of an entry is its depth in the stack
+  size_t depth { 0 };
+  // First instruction computing every entry of the stack
+  std::vector<size_t> entryStarts;
   for (const auto &condition : conditions) {
+    Instruction instruction;
     if (condition.index()) {
-      // Case for a = 1
-      // Retrieve attribute name comparator value
-      auto &[attributeName, comparator, value] { std::get<1>(condition) };
-      // Get bitmap index by attribute name, get bitmap by value and then store it into the stack
-      stack.emplace(this->m_bitmapIndices.at(attributeName).getBitmap(comparator, value));
+      const auto &[attributeName, comparator, value] { std::get<1>(condition) };
+      auto bitmapIndexIter { this->m_bitmapIndices.find(attributeName) };
+      if (end(this->m_bitmapIndices) == bitmapIndexIter) {
+        throw std::runtime_error("unknown attribute " + attributeName);
+      }
+      if (PreparedStatement::MAX_REGISTER_COUNT == depth) throw std::runtime_error("condition too complex");
+      instruction.m_target = depth++;
+      // A pattern is matched against the values of the index, so it is never a scan of the records
+      if (Token::LIKE == comparator) instruction.m_opCode = OpCode::MATCH;
+      instruction.m_comparator = comparator;
+      instruction.m_bitmapIndex = &bitmapIndexIter->second;
+      instruction.m_operands.emplace_back();
+      if (PARAMETER_MARKER == value) instruction.m_operands.back().m_parameter = statement.m_parameterCount++;
+      // A value is typed once here, a pattern is matched as text and null has no value
+      else if (OpCode::MATCH == instruction.m_opCode) instruction.m_operands.back().m_value = value;
+      else if (Token::IS_NULL not_eq comparator and Token::IS_NOT_NULL not_eq comparator) {
+        instruction.m_operands.back().m_value = bitmapIndexIter->second.getSchema().parse(value);
+      }
+      statement.m_registerCount = std::max(statement.m_registerCount, depth);
+      entryStarts.emplace_back(statement.m_instructions.size());
+      statement.m_instructions.emplace_back(std::move(instruction));
+      continue;
+    }
+
+    Token token { std::get<0>(condition) };
+    if (Token::NOT == token) {
+      // De Morgan's laws push NOT down to the conditions of the entry, so no complement of a whole bitmap is built
+      if (1 > depth) throw std::runtime_error("malformed condition");
+      for (size_t index { entryStarts.back() }; index < statement.m_instructions.size(); ++index) {
+        negate(statement.m_instructions[index]);
+      }
+      continue;
+    }
+
+    if (2 > depth) throw std::runtime_error("malformed condition");
+    --depth;
+    entryStarts.pop_back();
+
+    // If both operands are single instructions on one attribute, an OR of equalities becomes one union of
+    // their values and attr >= a AND attr <= b becomes one range, as written by IN and BETWEEN
+    size_t instructionCount { statement.m_instructions.size() };
+    if (2 <= instructionCount) {
+      Instruction &lhs { statement.m_instructions[instructionCount - 2] };
+      Instruction &rhs { statement.m_instructions[instructionCount - 1] };
+      if (isLeaf(lhs) and isLeaf(rhs) and lhs.m_bitmapIndex == rhs.m_bitmapIndex) {
+        bool isUnion { Token::OR == token and isEquality(lhs) and isEquality(rhs) };
+        bool isRange { Token::AND == token and isBound(lhs, Token::GREATER_THAN_OR_EQUAL_TO) and
+                       isBound(rhs, Token::LESS_THAN_OR_EQUAL_TO) };
+        if (isUnion or isRange) {
+          lhs.m_opCode = isUnion ? OpCode::UNION : OpCode::RANGE;
+          lhs.m_operands.insert(end(lhs.m_operands), begin(rhs.m_operands), end(rhs.m_operands));
+          statement.m_instructions.pop_back();
+          continue;
+        }
+      }
+    }
+
+    instruction.m_opCode = Token::AND == token ? OpCode::AND : OpCode::OR;
+    instruction.m_source = depth;
+    instruction.m_target = depth - 1;
+    statement.m_instructions.emplace_back(std::move(instruction));
+  }
+  if (1 < depth) throw std::runtime_error("malformed condition");
+
+  return statement;
+}
+
+const Bitmap &BitmapIndexManager::execute_helper(const PreparedStatement &statement,
+                                                 const std::vector<std::string> &parameters) {
+  using Instruction = PreparedStatement::Instruction;
+  using OpCode = PreparedStatement::OpCode;
+  using Operand = PreparedStatement::Operand;
+  if (parameters.size() not_eq statement.m_parameterCount) {
+    throw std::runtime_error("expect " + std::to_string(statement.m_parameterCount) + " parameters");
+  }
+
+  // If the condition is empty, then returns the existence bitmap
+  if (statement.m_instructions.empty()) return this->m_existenceBitmap;
+
+  // Every thread computes in its own registers, they are reused by its next execution
+  thread_local BitmapRegisters registers;
+  registers.prepare(statement.m_registerCount, this->m_nextRecordID);
+  std::vector<const Bitmap *> &unionBitmaps { registers.getUnionBitmaps() };
+  // The value of an operand, bound into the scratch space of its position if it is a parameter
+  auto bind { [&](const Instruction &instruction, const Operand &operand, size_t position) -> const ValueType & {
+    if (not operand.m_parameter) return operand.m_value;
+    ValueType &boundValue { registers.getBoundValue(position) };
+    const std::string &parameter { parameters[*operand.m_parameter] };
+    if (OpCode::MATCH == instruction.m_opCode) boundValue = parameter;
+    else boundValue = instruction.m_bitmapIndex->getSchema().parse(parameter);
+    return boundValue;
+  } };
+
+  for (const auto &instruction : statement.m_instructions) {
+    Bitmap &target { registers[instruction.m_target] };
+    const auto &operands { instruction.m_operands };
+    switch (instruction.m_opCode) {
+    case OpCode::LOAD:
+      instruction.m_bitmapIndex->getBitmap(instruction.m_comparator, bind(instruction, operands[0], 0), target);
       break;
-    } else {
-      // Case for AND/OR
-      // Perform logical operation on the top two bitmaps on the stack
-      Bitmap &&bitmap { std::move(stack.top()) };
-      stack.pop();
-      if (Token::AND == std::get<0>(condition)) stack.top() &= bitmap;
-      else stack.top() |= bitmap;
+    case OpCode::UNION:
+    case OpCode::RANGE:
+    case OpCode::MATCH:
+      unionBitmaps.clear();
+      if (OpCode::UNION == instruction.m_opCode) {
+        for (const auto &operand : operands) {
+          instruction.m_bitmapIndex->collectBitmap(bind(instruction, operand, 0), unionBitmaps);
+        }
+      } else if (OpCode::MATCH == instruction.m_opCode) {
+        instruction.m_bitmapIndex->collectMatchingBitmaps(std::get<std::string>(bind(instruction, operands[0], 0)),
+                                                          unionBitmaps);
+      } else {
+        instruction.m_bitmapIndex->collectRangeBitmaps(bind(instruction, operands[0], 0),
+                                                       bind(instruction, operands[1], 1),
+                                                       unionBitmaps);
+      }
+      // A negated one is the not null bitmap without the values, computed in the same pass
+      if (instruction.m_isNegated) {
+        target.assignDifference(instruction.m_bitmapIndex->getNotNullBitmap(), unionBitmaps);
+      } else {
+        target.assignUnion(unionBitmaps);
+      }
+      break;
+    case OpCode::AND: target &= registers[instruction.m_source]; break;
+    case OpCode::OR: target |= registers[instruction.m_source]; break;
     }
   }
 
-  return stack.top() & this->m_existenceBitmap;
+  return registers[0] &= this->m_existenceBitmap;
 }
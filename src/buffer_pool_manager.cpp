@@ -1,19 +1,32 @@
 #include "buffer_pool_manager.h"
 
-BufferPoolManager::BufferPoolManager(size_t poolSize, FileStore *fileStore, bool enableCondVar)
-    : m_poolSize(poolSize), m_fileStore(fileStore), m_enableCondVar(enableCondVar) {
-  // We allocate a consecutive memory space for the buffer pool.
-  m_pages = new Page[m_poolSize];
+BufferPoolManager::BufferPoolManager(size_t poolSize, FileStore *fileStore, bool enableCondVar,
+                                     HugePageMode hugePageMode, size_t maxPoolSize)
+    : m_poolSize(0), m_maxPoolSize(std::max(poolSize, maxPoolSize)), m_frameArena(hugePageMode),
+      m_fileStore(fileStore), m_enableCondVar(enableCondVar) {
+  // We allocate a consecutive memory space for the book-keeping information of the largest pool,
+  // the page data are kept apart and only allocated for the frames in use.
+  m_pages = new Page[m_maxPoolSize];
   m_replacer = new LRUReplacer;
   
   // Initially, every page is in the free list.
-  for (size_t i = 0; i < m_poolSize; ++i) {
-    m_freeList.emplace_back(static_cast<FrameIDType>(i));
-  }
+  grow_helper(poolSize);
 }
 
 BufferPoolManager::~BufferPoolManager() {
+  stopBackgroundWriter();
   flushAllPages();
+  
+  // reads still in flight land in the frames, so they have to complete before the frames go away
+  for (size_t i = 0; i < m_poolSize; ++i) {
+    if (m_pages[i].m_ioRequestID != INVALID_IO_REQUEST_ID) {
+      try {
+        m_fileStore->waitForRequest(m_pages[i].m_ioRequestID);
+      } catch (const std::exception &) {
+        // nobody is going to use the page
+      }
+    }
+  }
   delete[] m_pages;
   delete m_replacer;
 }
@@ -44,20 +57,25 @@ Page *BufferPoolManager::getVictimPage() {
     frameID = m_freeList.front();
     m_freeList.pop_front();
     p = m_pages + frameID;
+    p->m_pinCount = Page::EVICTING_PIN_COUNT;
+    // a buffer ring may still remember the frame
+    p->m_version.fetch_add(1, std::memory_order_release);
     
     return p;
   }
   
-  if (m_replacer->victim(&frameID)) { // if no free frames, try to evict a page
+  while (m_replacer->victim(&frameID)) { // if no free frames, try to evict a page
     p = m_pages + frameID;
-    m_pageTable.erase({p->m_fileType, p->m_pageID});
     
-    // write to disk if the page is dirty
-    if (p->isDirty()) {
-      m_fileStore->writeRawPage(p->m_fileType, p->m_pageID, p->m_data);
-      p->m_isDirty = false;
+    // a page pinned through the optimistic path may still be in the replacer, skip it,
+    // it goes back to the replacer when it gets unpinned
+    int pinCount = 0;
+    if (!p->m_pinCount.compare_exchange_strong(pinCount, Page::EVICTING_PIN_COUNT)) {
+      continue;
     }
+    evictPage_helper(p);
     
+    // the frame keeps refusing optimistic pins until the caller sets its pin count
     return p;
   }
   
@@ -65,6 +83,408 @@ Page *BufferPoolManager::getVictimPage() {
   return nullptr;
 }
 
+void BufferPoolManager::evictPage_helper(Page *p) {
+  // the caller has claimed the frame and taken it out of the replacer
+  unmapPage_helper(p);
+  m_statistics.add(EVICTION);
+  
+  // a prefetched page may still be in flight, its content is discarded anyway
+  if (p->m_ioRequestID != INVALID_IO_REQUEST_ID) {
+    try {
+      m_fileStore->waitForRequest(p->m_ioRequestID);
+    } catch (const std::exception &) {
+      // nobody has used the page, so the failed read does not matter
+    }
+    p->m_ioRequestID = INVALID_IO_REQUEST_ID;
+  }
+  
+  // write to disk if the page is dirty, after the log of its changes. The caller needs the frame right away,
+  // so the write goes on behind from a copy if the file store serves requests asynchronously
+  if (p->isDirty()) {
+    try {
+      flushLog_helper(p->m_lsn);
+      if (m_fileStore->isAsyncIOEnabled()) {
+        writeBehind_helper(p);
+      } else {
+        m_fileStore->writeRawPage(p->m_fileType, p->m_pageID, p->m_data);
+      }
+    } catch (const std::exception &) {
+      // keep the page, it is still dirty
+      p->m_pinCount = 0;
+      mapPage_helper(p, p->m_fileType, p->m_pageID);
+      m_replacer->unpin(p - m_pages);
+      throw;
+    }
+    p->m_isDirty = false;
+    m_statistics.add(DIRTY_WRITEBACK);
+  }
+  p->m_isScanPage = false;
+}
+
+void BufferPoolManager::writeBehind_helper(Page *p) {
+  reapPendingWrites_helper();
+  
+  ByteType *data;
+  if (!m_freeWriteBuffers.empty()) {
+    data = m_freeWriteBuffers.back();
+    m_freeWriteBuffers.pop_back();
+  } else {
+    data = m_writeArena.allocateBlock(1);
+  }
+  memcpy(data, p->m_data, PAGE_SIZE);
+  
+  // a resident page has no write in flight, so two writes of the same page never overtake each other
+  IORequestIDType requestID;
+  try {
+    requestID = m_fileStore->submitWriteRawPage(p->m_fileType, p->m_pageID, data);
+  } catch (const std::exception &) {
+    m_freeWriteBuffers.emplace_back(data);
+    throw;
+  }
+  m_pendingWrites[{p->m_fileType, p->m_pageID}] = { requestID, data };
+}
+
+void BufferPoolManager::finishPendingWrite_helper(FileType fileType, PageIDType pageID) {
+  auto writeIter = m_pendingWrites.find({fileType, pageID});
+  if (writeIter == m_pendingWrites.end()) {
+    return;
+  }
+  
+  PendingWrite &write = writeIter->second;
+  bool isWritten = false;
+  if (write.m_requestID != INVALID_IO_REQUEST_ID) {
+    IORequestIDType requestID = write.m_requestID;
+    write.m_requestID = INVALID_IO_REQUEST_ID;
+    try {
+      m_fileStore->waitForRequest(requestID);
+      isWritten = true;
+    } catch (const std::exception &) {
+      // the copy is still here, so the write is retried synchronously
+    }
+  }
+  
+  // a persistent io error propagates from here, the copy stays for the next attempt
+  if (!isWritten) {
+    m_fileStore->writeRawPage(fileType, pageID, write.m_data);
+  }
+  m_freeWriteBuffers.emplace_back(write.m_data);
+  m_pendingWrites.erase(writeIter);
+}
+
+void BufferPoolManager::reapPendingWrites_helper() {
+  auto writeIter = m_pendingWrites.begin();
+  while (writeIter != m_pendingWrites.end()) {
+    auto nextIter = std::next(writeIter);
+    if (writeIter->second.m_requestID != INVALID_IO_REQUEST_ID &&
+        m_fileStore->isRequestComplete(writeIter->second.m_requestID)) {
+      finishPendingWrite_helper(writeIter->first.first, writeIter->first.second);
+    }
+    writeIter = nextIter;
+  }
+  
+  // the copies are bounded, so one of the writes has to land before another one starts
+  if (m_pendingWrites.size() >= MAX_PENDING_WRITES) {
+    finishPendingWrite_helper(m_pendingWrites.begin()->first.first, m_pendingWrites.begin()->first.second);
+  }
+}
+
+Page *BufferPoolManager::getRingVictimPage_helper(BufferRing *ring) {
+  if (ring == nullptr) {
+    return getVictimPage();
+  }
+  
+  BufferRing::Slot &slot = ring->m_slots[ring->m_nextSlot];
+  ring->m_nextSlot = (ring->m_nextSlot + 1) % ring->m_slots.size();
+  
+  // recycle the frame of the slot unless it has been evicted, pinned or fetched normally since the ring took it
+  if (slot.m_frameID < m_poolSize) {
+    Page *p = m_pages + slot.m_frameID;
+    int pinCount = 0;
+    if (p->m_version == slot.m_version && p->m_isScanPage &&
+        p->m_pinCount.compare_exchange_strong(pinCount, Page::EVICTING_PIN_COUNT)) {
+      m_replacer->pin(slot.m_frameID);
+      evictPage_helper(p);
+      slot.m_version = p->m_version;
+      return p;
+    }
+  }
+  
+  // the ring is still filling up, or the frame is gone
+  Page *p = getVictimPage();
+  if (p != nullptr) {
+    slot.m_frameID = static_cast<FrameIDType>(p - m_pages);
+    slot.m_version = p->m_version;
+  }
+  return p;
+}
+
+void BufferPoolManager::unpinNewPage_helper(Page *p, BufferRing *ring) {
+  // pages read for a scan are victimized before the pages of normal fetches
+  if (ring != nullptr) {
+    m_replacer->unpinCold(p - m_pages);
+  } else {
+    m_replacer->unpin(p - m_pages);
+  }
+}
+
+Page *BufferPoolManager::waitForVictimPage_helper(std::unique_lock<std::mutex> &lck) {
+  Page *p = getVictimPage();
+  if (p != nullptr || !m_enableCondVar) {
+    return p;
+  }
+  
+  // every frame is pinned, wait until one gets unpinned
+  m_statistics.add(PIN_WAIT);
+  this->m_poolCondition.wait(lck, [&] { return (p = getVictimPage()) != nullptr; });
+  return p;
+}
+
+BufferPoolStatistics BufferPoolManager::getStatistics() const {
+  BufferPoolStatistics statistics;
+  statistics.m_hits = m_statistics.get(HIT);
+  statistics.m_misses = m_statistics.get(MISS);
+  statistics.m_evictions = m_statistics.get(EVICTION);
+  statistics.m_dirtyWritebacks = m_statistics.get(DIRTY_WRITEBACK);
+  statistics.m_backgroundWrites = m_statistics.get(BACKGROUND_WRITE);
+  statistics.m_pinWaits = m_statistics.get(PIN_WAIT);
+  return statistics;
+}
+
+Page *BufferPoolManager::tryFetchResidentPage_helper(FileType fileType, PageIDType pageID) {
+  Page *p;
+  uint64_t version;
+  {
+    std::shared_lock<std::shared_mutex> lck(m_pageTableLatch);
+    auto entryIter = m_pageTable.find({fileType, pageID});
+    if (entryIter == m_pageTable.end()) {
+      return nullptr;
+    }
+    p = m_pages + entryIter->second;
+    version = p->m_version.load(std::memory_order_acquire);
+  }
+  
+  if (!tryPin_helper(p)) {
+    return nullptr;
+  }
+  
+  // the frame may have been given to another page between the lookup and the pin,
+  // and a page still being read has to be waited for under the pool latch
+  if (p->m_version.load(std::memory_order_acquire) != version ||
+      p->m_ioRequestID.load(std::memory_order_acquire) != INVALID_IO_REQUEST_ID) {
+    unpinFrame(p, false);
+    return nullptr;
+  }
+  
+  return p;
+}
+
+bool BufferPoolManager::tryPin_helper(Page *p) {
+  int pinCount = p->m_pinCount.load();
+  do {
+    // the frame is being evicted
+    if (pinCount < 0) {
+      return false;
+    }
+  } while (!p->m_pinCount.compare_exchange_weak(pinCount, pinCount + 1));
+  
+  if (pinCount == 0) {
+    m_replacer->pin(p - m_pages);
+  }
+  return true;
+}
+
+bool BufferPoolManager::unpinFrame(Page *p, bool isDirty) {
+  if (isDirty) {
+    p->m_isDirty = true;
+  }
+  
+  int pinCount = p->m_pinCount.load();
+  do {
+    if (pinCount <= 0) {
+      return false;
+    }
+  } while (!p->m_pinCount.compare_exchange_weak(pinCount, pinCount - 1));
+  
+  if (pinCount == 1) {
+    if (p->m_isScanPage) {
+      m_replacer->unpinCold(p - m_pages);
+    } else {
+      m_replacer->unpin(p - m_pages);
+    }
+    if (m_enableCondVar) {
+      // a waiter checks the replacer under the pool latch, taking the latch here makes sure
+      // that it is either waiting already or is going to find the frame
+      { std::lock_guard<std::mutex> lck(m_poolLatch); }
+      this->m_poolCondition.notify_one();
+    }
+  }
+  return true;
+}
+
+void BufferPoolManager::mapPage_helper(Page *p, FileType fileType, PageIDType pageID) {
+  std::unique_lock<std::shared_mutex> lck(m_pageTableLatch);
+  p->m_fileType = fileType;
+  p->m_pageID = pageID;
+  m_pageTable[{fileType, pageID}] = (p - m_pages);  // add an entry to page table(p - m_pages is to get the frame id)
+}
+
+void BufferPoolManager::unmapPage_helper(Page *p) {
+  std::unique_lock<std::shared_mutex> lck(m_pageTableLatch);
+  m_pageTable.erase({p->m_fileType, p->m_pageID});
+  p->m_version.fetch_add(1, std::memory_order_release);
+}
+
+PageHandle &PageHandle::operator=(PageHandle &&other) noexcept {
+  if (this != &other) {
+    release();
+    m_bufferPoolManager = other.m_bufferPoolManager;
+    m_page = other.m_page;
+    m_isDirty = other.m_isDirty;
+    other.m_page = nullptr;
+    other.m_isDirty = false;
+  }
+  return *this;
+}
+
+void PageHandle::markDirty(LSNType lsn) {
+  m_isDirty = true;
+  // the page is pinned, but other handles of it may mark it concurrently
+  LSNType pageLSN = m_page->m_lsn;
+  while (pageLSN < lsn && !m_page->m_lsn.compare_exchange_weak(pageLSN, lsn)) {
+  }
+}
+
+void PageHandle::release() {
+  if (m_page != nullptr) {
+    m_bufferPoolManager->unpinFrame(m_page, m_isDirty);
+    m_page = nullptr;
+    m_isDirty = false;
+  }
+}
+
+size_t BufferPoolManager::getMemoryUsage() {
+  std::lock_guard<std::mutex> lck(m_poolLatch);
+  return m_frameArena.getAllocatedSize();
+}
+
+size_t BufferPoolManager::resize(size_t poolSize) {
+  std::lock_guard<std::mutex> lck(m_poolLatch);
+  poolSize = std::clamp<size_t>(poolSize, 1, m_maxPoolSize);
+  if (poolSize > m_poolSize) {
+    grow_helper(poolSize);
+  } else if (poolSize < m_poolSize) {
+    shrink_helper(poolSize);
+  }
+  return m_poolSize;
+}
+
+void BufferPoolManager::grow_helper(size_t poolSize) {
+  // frames left over by a shrink may still have their data, the rest get new blocks,
+  // bounded in size so that a later shrink can give most of them back
+  size_t firstFrameID = m_poolSize;
+  while (firstFrameID < poolSize && m_pages[firstFrameID].m_data != nullptr) {
+    ++firstFrameID;
+  }
+  while (firstFrameID < poolSize) {
+    size_t frameCount = std::min(poolSize - firstFrameID, FRAME_BLOCK_PAGES);
+    ByteType *frames = m_frameArena.allocateBlock(frameCount);
+    m_frameBlocks.emplace_back(static_cast<FrameIDType>(firstFrameID), frames);
+    for (size_t i = 0; i < frameCount; ++i) {
+      m_pages[firstFrameID + i].m_data = frames + i * PAGE_SIZE;
+    }
+    firstFrameID += frameCount;
+  }
+  
+  for (size_t i = m_poolSize; i < poolSize; ++i) {
+    m_pages[i].m_pinCount = 0;
+    m_freeList.emplace_back(static_cast<FrameIDType>(i));
+  }
+  m_poolSize = poolSize;
+  
+  if (m_enableCondVar) {
+    this->m_poolCondition.notify_all();
+  }
+}
+
+void BufferPoolManager::shrink_helper(size_t poolSize) {
+  // 1.   Claim the frames from the end of the pool, stop at the first pinned one.
+  // 2.   Write the dirty ones back together, and give every claimed frame back if that fails.
+  // 3.   Remove the claimed frames from the page table and release the blocks no frame uses anymore.
+  std::vector<Page *> claimedPages;
+  std::vector<Page *> dirtyPages;
+  size_t newPoolSize = m_poolSize;
+  while (newPoolSize > poolSize) {
+    FrameIDType frameID = static_cast<FrameIDType>(newPoolSize - 1);
+    Page *p = m_pages + frameID;
+    
+    auto freeIter = std::find(m_freeList.begin(), m_freeList.end(), frameID);
+    if (freeIter != m_freeList.end()) {
+      m_freeList.erase(freeIter);
+      p->m_pinCount = Page::EVICTING_PIN_COUNT;
+    } else {
+      int pinCount = 0;
+      if (!p->m_pinCount.compare_exchange_strong(pinCount, Page::EVICTING_PIN_COUNT)) {
+        break;
+      }
+      m_replacer->pin(frameID);
+      
+      // the frame is going away, so an unused prefetch has to land before that
+      if (p->m_ioRequestID != INVALID_IO_REQUEST_ID) {
+        try {
+          m_fileStore->waitForRequest(p->m_ioRequestID);
+        } catch (const std::exception &) {
+          // nobody has used the page, so the failed read does not matter
+        }
+        p->m_ioRequestID = INVALID_IO_REQUEST_ID;
+      }
+      
+      claimedPages.emplace_back(p);
+      if (p->isDirty()) {
+        dirtyPages.emplace_back(p);
+      }
+    }
+    --newPoolSize;
+  }
+  
+  std::sort(dirtyPages.begin(), dirtyPages.end(), [](const Page *a, const Page *b) {
+    return std::make_pair(a->m_fileType, a->m_pageID) < std::make_pair(b->m_fileType, b->m_pageID);
+  });
+  try {
+    writePages_helper(dirtyPages);
+  } catch (const std::exception &) {
+    for (Page *p : claimedPages) {
+      p->m_pinCount = 0;
+      m_replacer->unpin(p - m_pages);
+    }
+    for (size_t i = newPoolSize; i < m_poolSize; ++i) {
+      if (m_pages[i].m_pinCount == Page::EVICTING_PIN_COUNT) {
+        m_freeList.emplace_back(static_cast<FrameIDType>(i));
+      }
+    }
+    throw;
+  }
+  
+  for (Page *p : claimedPages) {
+    unmapPage_helper(p);
+    p->m_isDirty = false;
+    p->m_isScanPage = false;
+    p->m_fileType = FileType::INVALID;
+    p->m_pageID = INVALID_PAGE_ID;
+  }
+  m_statistics.add(EVICTION, claimedPages.size());
+  m_statistics.add(DIRTY_WRITEBACK, dirtyPages.size());
+  m_poolSize = newPoolSize;
+  
+  // the claimed frames refuse optimistic pins for good, their blocks can go once wholly unused
+  while (!m_frameBlocks.empty() && m_frameBlocks.back().first >= newPoolSize) {
+    for (size_t i = m_frameBlocks.back().first; i < m_maxPoolSize && m_pages[i].m_data != nullptr; ++i) {
+      m_pages[i].m_data = nullptr;
+    }
+    m_frameArena.freeBlock(m_frameBlocks.back().second);
+    m_frameBlocks.pop_back();
+  }
+}
+
 bool BufferPoolManager::flushPage_helper(FileType fileType, PageIDType pageID) {
   assert(fileType != FileType::INVALID || pageID != INVALID_PAGE_ID);
   
@@ -73,16 +493,129 @@ bool BufferPoolManager::flushPage_helper(FileType fileType, PageIDType pageID) {
     return false;
   }
   
+  waitForPendingIO_helper(p);
+  
   // flush a page back to disk no matter how its dirty bit set,
   // cuz the test will write back the page directly by flush
   // without unpinning the page first
+  flushLog_helper(p->m_lsn);
   m_fileStore->writeRawPage(fileType, pageID, p->m_data);
   p->m_isDirty = false;
   
   return true;
 }
 
-Page *BufferPoolManager::fetchPage(FileType fileType, PageIDType pageID) {
+void BufferPoolManager::waitForPendingIO_helper(Page *p) {
+  if (p->m_ioRequestID == INVALID_IO_REQUEST_ID) {
+    return;
+  }
+  
+  // the request id is cleared only once the data is in place, the optimistic path relies on it
+  try {
+    m_fileStore->waitForRequest(p->m_ioRequestID);
+  } catch (const std::exception &) {
+    // retry synchronously, a persistent io error propagates from here
+    try {
+      m_fileStore->readRawPage(p->m_fileType, p->m_pageID, p->m_data);
+    } catch (const std::exception &) {
+      // the page is dropped before its request id is cleared, so the optimistic path never finds it without data
+      unmapPage_helper(p);
+      p->m_fileType = FileType::INVALID;
+      p->m_pageID = INVALID_PAGE_ID;
+      p->m_ioRequestID.store(INVALID_IO_REQUEST_ID, std::memory_order_release);
+      throw;
+    }
+  }
+  p->m_ioRequestID.store(INVALID_IO_REQUEST_ID, std::memory_order_release);
+}
+
+size_t BufferPoolManager::loadPages_helper(FileType fileType, PageIDType firstPageID,
+                                           size_t pageCount, Page **pages, BufferRing *ring, bool isAsync) {
+  // take frames for the pages up to the first resident one
+  size_t loadedCount = 0;
+  while (loadedCount < pageCount && fetchExistentPage(fileType, firstPageID + loadedCount) == nullptr) {
+    Page *p = getRingVictimPage_helper(ring);
+    if (p == nullptr) {
+      break;
+    }
+    pages[loadedCount++] = p;
+  }
+  
+  if (loadedCount == 0) {
+    return 0;
+  }
+  
+  std::vector<ByteType *> raws(loadedCount);
+  for (size_t i = 0; i < loadedCount; ++i) {
+    raws[i] = pages[i]->m_data;
+  }
+  
+  try {
+    // an evicted page is read back only once its write behind has landed
+    for (size_t i = 0; i < loadedCount; ++i) {
+      finishPendingWrite_helper(fileType, firstPageID + i);
+    }
+    if (!isAsync || !m_fileStore->isAsyncIOEnabled()) {
+      m_fileStore->readRawPages(fileType, firstPageID, raws.data(), loadedCount);
+    }
+  } catch (const std::exception &) {
+    // give the frames back before propagating the error
+    for (size_t i = 0; i < loadedCount; ++i) {
+      pages[i]->m_fileType = FileType::INVALID;
+      pages[i]->m_pageID = INVALID_PAGE_ID;
+      m_freeList.emplace_back(pages[i] - m_pages);
+    }
+    throw;
+  }
+  
+  // the pages are published only once their data is in place, or with their reads pending, which the optimistic
+  // path sees and leaves to the pool latch. They are left unpinned and outside the replacer, the caller decides
+  // what to do with them
+  for (size_t i = 0; i < loadedCount; ++i) {
+    if (isAsync && m_fileStore->isAsyncIOEnabled()) {
+      pages[i]->m_ioRequestID = m_fileStore->submitReadRawPage(fileType, firstPageID + i, raws[i]);
+    }
+    pages[i]->m_pinCount = 0;
+    pages[i]->m_isScanPage = (ring != nullptr);
+    mapPage_helper(pages[i], fileType, firstPageID + i);
+  }
+  
+  return loadedCount;
+}
+
+size_t BufferPoolManager::getReadaheadWindow_helper(FileType fileType, PageIDType pageID, BufferRing *ring) {
+  auto lastMissIter = m_lastMissPageIDs.find(fileType);
+  size_t &sequentialMissCount = m_sequentialMissCounts[fileType];
+  
+  if (lastMissIter != m_lastMissPageIDs.end() && lastMissIter->second + 1 == pageID) {
+    ++sequentialMissCount;
+  } else {
+    sequentialMissCount = 0;
+  }
+  m_lastMissPageIDs[fileType] = pageID;
+  
+  if (sequentialMissCount < READAHEAD_TRIGGER) {
+    return 1;
+  }
+  
+  // never read ahead more than a quarter of the pool or past the end of file
+  // a scan reads ahead within half of its ring, so that it does not recycle the pages it has just read
+  size_t window = std::min(READAHEAD_PAGES, std::max<size_t>(1, m_poolSize.load() / 4));
+  if (ring != nullptr) {
+    window = std::min(window, std::max<size_t>(1, ring->getRingSize() / 2));
+  }
+  PageIDType filePageCount = m_fileStore->getPageCount(fileType);
+  if (filePageCount <= pageID) {
+    return 1;
+  }
+  window = std::min<size_t>(window, filePageCount - pageID);
+  
+  // the next sequential miss comes right after the pages read ahead
+  m_lastMissPageIDs[fileType] = pageID + window - 1;
+  return window;
+}
+
+Page *BufferPoolManager::fetchPage(FileType fileType, PageIDType pageID, BufferRing *ring) {
   // 1.     Search the page table for the requested page (P).
   // 1.1    If P exists, pin it and return it immediately.
   // 1.2    If P does not exist, find a replacement page (R) from either the free list or the replacer.
@@ -90,62 +623,233 @@ Page *BufferPoolManager::fetchPage(FileType fileType, PageIDType pageID) {
   // 2.     If R is dirty, write it back to the disk.
   // 3.     Delete R from the page table and insert P.
   // 4.     Update P's metadata, read in the page content from disk, and then return a pointer to P.
+  // A resident page is pinned through the optimistic path without taking the pool latch.
+  Page *p = tryFetchResidentPage_helper(fileType, pageID);
+  if (p != nullptr) {
+    m_statistics.add(HIT);
+    // a page fetched normally is no longer only part of a scan
+    if (ring == nullptr && p->m_isScanPage) {
+      p->m_isScanPage = false;
+    }
+    return p;
+  }
+  
   std::unique_lock<std::mutex> lck(m_poolLatch);
-  Page *p = fetchExistentPage(fileType, pageID);
+  p = fetchExistentPage(fileType, pageID);
+  
+  // a frame being evicted refuses the pin, the page is looked up again once the eviction is done,
+  // by then it is either resident again or missing
+  while (p != nullptr && !tryPin_helper(p)) {
+    lck.unlock();
+    std::this_thread::yield();
+    lck.lock();
+    p = fetchExistentPage(fileType, pageID);
+  }
   
   if (p != nullptr) {
-    if (p->m_pinCount == 0) {
-      m_replacer->pin(p - m_pages);
+    m_statistics.add(HIT);
+    if (ring == nullptr && p->m_isScanPage) {
+      p->m_isScanPage = false;
+    }
+    try {
+      waitForPendingIO_helper(p);
+    } catch (const std::exception &) {
+      unpinFrame(p, false);
+      throw;
     }
-    ++p->m_pinCount;
     return p;
   }
+  m_statistics.add(MISS);
 
-  if (m_enableCondVar) {
-    this->m_poolCondition.wait(lck, [&] { return (p = getVictimPage()) != nullptr; });
-  } else {
-    p = getVictimPage();
+  // if the file is being read sequentially, read the following pages together with this one
+  size_t readaheadWindow = getReadaheadWindow_helper(fileType, pageID, ring);
+  if (readaheadWindow > 1) {
+    Page *pages[READAHEAD_PAGES];
+    size_t loadedCount = loadPages_helper(fileType, pageID, readaheadWindow, pages, ring, true);
+    if (loadedCount > 0) {
+      // only the requested page is pinned, the pages read ahead wait in the replacer. A page just loaded
+      // cannot be claimed, claims are only taken under the pool latch, so the pin always succeeds
+      tryPin_helper(pages[0]);
+      for (size_t i = 1; i < loadedCount; ++i) {
+        unpinNewPage_helper(pages[i], ring);
+      }
+      
+      // the requested page is needed now, the reads of the others keep going behind it
+      try {
+        waitForPendingIO_helper(pages[0]);
+      } catch (const std::exception &) {
+        unpinFrame(pages[0], false);
+        throw;
+      }
+      return pages[0];
+    }
+  }
+
+  p = getRingVictimPage_helper(ring);
+  if (p == nullptr) {
+    p = waitForVictimPage_helper(lck);
   }
 
   if (p != nullptr) {
-    ++p->m_pinCount;
-    m_pageTable[{fileType, pageID}] = (p - m_pages);  // add an entry to page table(p - m_pages is to get the frame id)
-    p->m_fileType = fileType;
-    p->m_pageID = pageID;
-    m_fileStore->readRawPage(p->m_fileType, p->m_pageID, p->m_data);
+    try {
+      finishPendingWrite_helper(fileType, pageID);
+      m_fileStore->readRawPage(fileType, pageID, p->m_data);
+    } catch (const std::exception &) {
+      m_freeList.emplace_back(p - m_pages);
+      throw;
+    }
+    p->m_pinCount = 1;
+    p->m_isScanPage = (ring != nullptr);
+    mapPage_helper(p, fileType, pageID);
     return p;
   }
 
   return nullptr;
 }
 
-bool BufferPoolManager::unpinPage(FileType fileType, PageIDType pageID, bool isDirty) {
+std::vector<Page *> BufferPoolManager::fetchPages(FileType fileType, PageIDType firstPageID, size_t pageCount) {
+  std::unique_lock<std::mutex> lck(m_poolLatch);
+  std::vector<Page *> pages;
+  std::vector<Page *> loadedPages(pageCount);
+  pages.reserve(pageCount);
+  
+  while (pages.size() < pageCount) {
+    PageIDType pageID = firstPageID + pages.size();
+    Page *p = fetchExistentPage(fileType, pageID);
+    // a frame being evicted refuses the pin, as in fetchPage
+    while (p != nullptr && !tryPin_helper(p)) {
+      lck.unlock();
+      std::this_thread::yield();
+      lck.lock();
+      p = fetchExistentPage(fileType, pageID);
+    }
+    if (p != nullptr) {
+      m_statistics.add(HIT);
+      try {
+        waitForPendingIO_helper(p);
+      } catch (const std::exception &) {
+        unpinFrame(p, false);
+        throw;
+      }
+      pages.emplace_back(p);
+      continue;
+    }
+    
+    // read the missing pages up to the next resident one together
+    size_t loadedCount = loadPages_helper(fileType, pageID, pageCount - pages.size(), loadedPages.data());
+    if (loadedCount == 0) {
+      break;
+    }
+    m_statistics.add(MISS, loadedCount);
+    // the pages have just been loaded under the pool latch, so nobody can have claimed them
+    for (size_t i = 0; i < loadedCount; ++i) {
+      tryPin_helper(loadedPages[i]);
+      pages.emplace_back(loadedPages[i]);
+    }
+  }
+  
+  return pages;
+}
+
+void BufferPoolManager::prefetchPages(FileType fileType, const std::vector<PageIDType> &pageIDs, BufferRing *ring) {
   std::lock_guard<std::mutex> lck(m_poolLatch);
-  Page *p = fetchExistentPage(fileType, pageID);
+  PageIDType filePageCount = m_fileStore->getPageCount(fileType);
+  // never let the hinted pages take over the whole pool, or recycle the ring before they are used
+  size_t budget = std::max<size_t>(1, m_poolSize.load() / 4);
+  if (ring != nullptr) {
+    budget = std::min(budget, std::max<size_t>(1, ring->getRingSize() / 2));
+  }
+  std::vector<Page *> loadedPages;
   
-  // if page does not exist in buffer pool
-  if (p == nullptr) {
-    return true;
+  size_t i = 0;
+  while (i < pageIDs.size() && budget > 0) {
+    PageIDType pageID = pageIDs[i];
+    if (pageID >= filePageCount || fetchExistentPage(fileType, pageID) != nullptr) {
+      ++i;
+      continue;
+    }
+    
+    // find the run of consecutive page ids starting from here
+    size_t runLength = 1;
+    while (i + runLength < pageIDs.size() && runLength < budget &&
+           pageIDs[i + runLength] == pageID + runLength && pageID + runLength < filePageCount) {
+      ++runLength;
+    }
+    
+    loadedPages.resize(runLength);
+    size_t loadedCount = loadPages_helper(fileType, pageID, runLength, loadedPages.data(), ring, true);
+    if (loadedCount == 0) {
+      // no frame is available
+      return;
+    }
+    for (size_t j = 0; j < loadedCount; ++j) {
+      unpinNewPage_helper(loadedPages[j], ring);
+    }
+    budget -= loadedCount;
+    i += loadedCount;
   }
   
-  if (!p->m_isDirty && isDirty) {
-    p->m_isDirty = isDirty;
+  if (m_enableCondVar) {
+    this->m_poolCondition.notify_all();
+  }
+}
+
+bool BufferPoolManager::prefetchPage(FileType fileType, PageIDType pageID) {
+  std::lock_guard<std::mutex> lck(m_poolLatch);
+  if (fetchExistentPage(fileType, pageID) != nullptr) {
+    return true;
   }
   
-  if (p->m_pinCount <= 0) {
+  // never wait for a frame, a prefetch is only a hint
+  Page *p = getVictimPage();
+  if (p == nullptr) {
     return false;
   }
   
-  if (--p->m_pinCount == 0) {
-    m_replacer->unpin(p - m_pages);
-    if (m_enableCondVar) {
-      this->m_poolCondition.notify_one();
-    }
+  try {
+    finishPendingWrite_helper(fileType, pageID);
+  } catch (const std::exception &) {
+    m_freeList.emplace_back(p - m_pages);
+    throw;
   }
   
+  // the optimistic path sees the pending request and leaves the page to the pool latch
+  p->m_ioRequestID = m_fileStore->submitReadRawPage(fileType, pageID, p->m_data);
+  p->m_pinCount = 0;
+  mapPage_helper(p, fileType, pageID);
+  
+  // the page is not pinned, so it can be evicted like any other unpinned page
+  m_replacer->unpin(p - m_pages);
+  if (m_enableCondVar) {
+    this->m_poolCondition.notify_one();
+  }
   return true;
 }
 
+PageHandle BufferPoolManager::fetchPageHandle(FileType fileType, PageIDType pageID, BufferRing *ring) {
+  Page *p = fetchPage(fileType, pageID, ring);
+  if (p == nullptr) {
+    return {};
+  }
+  return { this, p };
+}
+
+bool BufferPoolManager::unpinPage(FileType fileType, PageIDType pageID, bool isDirty) {
+  Page *p;
+  {
+    // the caller holds a pin, so the page cannot be evicted once found
+    std::shared_lock<std::shared_mutex> lck(m_pageTableLatch);
+    p = fetchExistentPage(fileType, pageID);
+  }
+  
+  // if page does not exist in buffer pool
+  if (p == nullptr) {
+    return true;
+  }
+  
+  return unpinFrame(p, isDirty);
+}
+
 bool BufferPoolManager::flushPage(FileType fileType, PageIDType pageID) {
   assert(fileType != FileType::INVALID || pageID != INVALID_PAGE_ID);
   std::lock_guard<std::mutex> lck(m_poolLatch);
@@ -154,10 +858,160 @@ bool BufferPoolManager::flushPage(FileType fileType, PageIDType pageID) {
 
 void BufferPoolManager::flushAllPages() {
   std::lock_guard<std::mutex> lck(m_poolLatch);
+  
+  // evicted pages written behind are on disk too once this returns
+  while (!m_pendingWrites.empty()) {
+    finishPendingWrite_helper(m_pendingWrites.begin()->first.first, m_pendingWrites.begin()->first.second);
+  }
+  
+  // the page table is ordered by file type and page id, so the dirty pages come out sorted
+  std::vector<Page *> dirtyPages;
   for (auto entry : m_pageTable) {
-    FileType fileType = entry.first.first;
-    PageIDType pageID = entry.first.second;
-    flushPage_helper(fileType, pageID);
+    Page *p = m_pages + entry.second;
+    if (p->isDirty()) {
+      waitForPendingIO_helper(p);
+      dirtyPages.emplace_back(p);
+    }
+  }
+  
+  // pinned pages can still be changed, so copies of them are written as by the background writer. Dirty bits are
+  // cleared before the copies are taken, a page changed meanwhile gets dirty again when unpinned
+  std::vector<ByteType> copies(dirtyPages.size() * PAGE_SIZE);
+  for (size_t i = 0; i < dirtyPages.size(); ++i) {
+    dirtyPages[i]->m_isDirty = false;
+    memcpy(copies.data() + i * PAGE_SIZE, dirtyPages[i]->m_data, PAGE_SIZE);
+  }
+  try {
+    writePages_helper(dirtyPages, copies.data());
+  } catch (const std::exception &) {
+    for (Page *p : dirtyPages) {
+      p->m_isDirty = true;
+    }
+    throw;
+  }
+}
+
+void BufferPoolManager::writePages_helper(const std::vector<Page *> &pages, const ByteType *copies) {
+  // the log is made durable once for all the pages
+  LSNType lsn = INVALID_LSN;
+  for (Page *p : pages) {
+    lsn = std::max(lsn, p->getLSN());
+  }
+  flushLog_helper(lsn);
+  
+  // pages must be sorted, every run of adjacent page ids becomes a single write
+  std::vector<const ByteType *> raws;
+  size_t runStart = 0;
+  while (runStart < pages.size()) {
+    FileType fileType = pages[runStart]->m_fileType;
+    PageIDType firstPageID = pages[runStart]->m_pageID;
+    
+    raws.clear();
+    size_t runEnd = runStart;
+    while (runEnd < pages.size() && pages[runEnd]->m_fileType == fileType &&
+           pages[runEnd]->m_pageID == firstPageID + (runEnd - runStart)) {
+      raws.emplace_back(copies != nullptr ? copies + runEnd * PAGE_SIZE : pages[runEnd]->m_data);
+      ++runEnd;
+    }
+    
+    m_fileStore->writeRawPages(fileType, firstPageID, raws.data(), raws.size());
+    runStart = runEnd;
+  }
+}
+
+void BufferPoolManager::flushLog_helper(LSNType lsn) {
+  if (lsn != INVALID_LSN && m_logFlusher) {
+    m_logFlusher(lsn);
+  }
+}
+
+void BufferPoolManager::startBackgroundWriter(std::chrono::milliseconds interval, size_t maxPagesPerRound) {
+  stopBackgroundWriter();
+  m_stopWriter = false;
+  m_writerThread = std::thread { &BufferPoolManager::backgroundWriterMain, this, interval, maxPagesPerRound };
+}
+
+void BufferPoolManager::stopBackgroundWriter() {
+  if (!m_writerThread.joinable()) {
+    return;
+  }
+  
+  {
+    std::lock_guard<std::mutex> lck(m_poolLatch);
+    m_stopWriter = true;
+  }
+  m_writerCondition.notify_all();
+  m_writerThread.join();
+}
+
+void BufferPoolManager::backgroundWriterMain(std::chrono::milliseconds interval, size_t maxPagesPerRound) {
+  // copies of the pages being written, so that the pages can be changed during the write
+  std::vector<ByteType> copies;
+  std::unique_lock<std::mutex> lck(m_poolLatch);
+  while (!m_writerCondition.wait_for(lck, interval, [&] { return m_stopWriter; })) {
+    // 1.   Claim dirty unpinned pages, so that nobody can pin them, copy them and clear their dirty bits.
+    //      A page modified after the copy gets dirty again when unpinned.
+    // 2.   Turn the claims into pins that keep the pages from being evicted while being written. The pins do not
+    //      go through the replacer, the pages are cold and have to stay where they are in it.
+    // 3.   Write the copies without holding the latch, adjacent pages together.
+    // 4.   Release the pins, and mark the pages that failed to be written as dirty again.
+    std::vector<Page *> pages;
+    for (auto entry : m_pageTable) {
+      Page *p = m_pages + entry.second;
+      int pinCount = 0;
+      if (p->isDirty() && p->m_ioRequestID == INVALID_IO_REQUEST_ID &&
+          p->m_pinCount.compare_exchange_strong(pinCount, Page::EVICTING_PIN_COUNT)) {
+        pages.emplace_back(p);
+        if (pages.size() == maxPagesPerRound) {
+          break;
+        }
+      }
+    }
+    
+    if (pages.empty()) {
+      continue;
+    }
+    
+    copies.resize(pages.size() * PAGE_SIZE);
+    for (size_t i = 0; i < pages.size(); ++i) {
+      memcpy(copies.data() + i * PAGE_SIZE, pages[i]->m_data, PAGE_SIZE);
+      pages[i]->m_isDirty = false;
+      pages[i]->m_pinCount = 1;
+    }
+    
+    bool isWritten = true;
+    lck.unlock();
+    try {
+      writePages_helper(pages, copies.data());
+    } catch (const std::exception &) {
+      // the pages stay dirty, eviction or the next round writes them
+      isWritten = false;
+    }
+    
+    if (isWritten) {
+      m_statistics.add(BACKGROUND_WRITE, pages.size());
+    }
+    for (Page *p : pages) {
+      if (!isWritten) {
+        p->m_isDirty = true;
+      }
+      unpinWithoutPromotion_helper(p);
+    }
+    lck.lock();
+  }
+}
+
+void BufferPoolManager::unpinWithoutPromotion_helper(Page *p) {
+  if (p->m_pinCount.fetch_sub(1) != 1) {
+    return;
+  }
+  
+  // the frame is still where it was in the replacer, unless a victim search has taken it out meanwhile,
+  // then it was the least recently used one and goes back to that end
+  m_replacer->unpinCold(p - m_pages);
+  if (m_enableCondVar) {
+    { std::lock_guard<std::mutex> lck(m_poolLatch); }
+    this->m_poolCondition.notify_one();
   }
 }
 
@@ -169,21 +1023,22 @@ Page *BufferPoolManager::appendNewPage(FileType fileType, PageIDType pageID) {
   std::unique_lock<std::mutex> lck(m_poolLatch);
   Page *p {  };
 
-  if (m_enableCondVar) {
-    this->m_poolCondition.wait(lck, [&] { return (p = getVictimPage()) != nullptr; });
-  } else {
-    p = getVictimPage();
-  }
+  p = waitForVictimPage_helper(lck);
 
   if (p != nullptr) {
-    ++p->m_pinCount;
-    m_pageTable[{fileType, pageID}] = (p - m_pages);  // add an entry to page table(p - m_pages is to get the frame id)
-    p->m_fileType = fileType;
-    p->m_pageID = pageID;
     p->resetMemory();
     
-    // make sure new page is written back to disk
-    flushPage_helper(fileType, pageID);
+    // the file has room for the page, it stays in memory until it is evicted or flushed
+    try {
+      finishPendingWrite_helper(fileType, pageID);
+      m_fileStore->reservePage(fileType, pageID);
+    } catch (const std::exception &) {
+      m_freeList.emplace_back(p - m_pages);
+      throw;
+    }
+    p->m_isDirty = true;
+    p->m_pinCount = 1;
+    mapPage_helper(p, fileType, pageID);
     return p;
   }
 
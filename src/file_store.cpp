@@ -1,82 +1,835 @@
 #include "file_store.h"
 
-#include "fileapi.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-FileStore::FileStore(const std::string &tableName) {
-  std::string tableFileName {tableName + ".db"};
+#if defined(_WIN32)
+struct FileStore::IOEngine {
+  ~IOEngine() {
+    if (m_completionPort != nullptr) {
+      CloseHandle(m_completionPort);
+    }
+  }
+
+  /** The completion port both files are associated with. */
+  HANDLE m_completionPort { nullptr };
+};
+
+namespace {
+/** A request handed to the kernel, the completion port gives its overlapped structure back. */
+struct OverlappedRequest {
+  OVERLAPPED m_overlapped;
+  IORequestIDType m_requestID;
+};
+
+/**
+ * Transfers data at an offset of a file and waits for it, the file may be opened for overlapped io.
+ * @return false if the transfer failed, GetLastError tells why
+ */
+bool transferAt(HANDLE fileHandle, bool isWrite, FileSizeType offset, void *data, DWORD size,
+                DWORD *transferredSize) {
+  HANDLE event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+  if (event == nullptr) {
+    return false;
+  }
+  
+  // the offset travels with the request, so the file has no position to share. The low bit of the event keeps
+  // the completion out of the completion port of the file
+  OVERLAPPED overlapped {};
+  overlapped.Offset = static_cast<DWORD>(offset);
+  overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+  overlapped.hEvent = reinterpret_cast<HANDLE>(reinterpret_cast<uintptr_t>(event) | 1);
+  BOOL isDone = isWrite ? WriteFile(fileHandle, data, size, nullptr, &overlapped)
+                        : ReadFile(fileHandle, data, size, nullptr, &overlapped);
+  if (isDone || GetLastError() == ERROR_IO_PENDING) {
+    isDone = GetOverlappedResult(fileHandle, &overlapped, transferredSize, TRUE);
+  }
   
-  m_tableFileIO.open(tableFileName, std::ios::binary | std::ios::in | std::ios::out);
-  if (!m_tableFileIO.is_open()) {
-    createFile(tableFileName);
-    m_tableFileIO.open(tableFileName, std::ios::binary | std::ios::in | std::ios::out);
-    if (!m_tableFileIO.is_open()) {
-      throw std::runtime_error("fail to open index file");
+  DWORD error = GetLastError();
+  CloseHandle(event);
+  SetLastError(error);
+  return isDone;
+}
+}
+#elif defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+struct FileStore::IOEngine {
+  ~IOEngine() {
+    if (m_entries != MAP_FAILED) {
+      munmap(m_entries, m_entriesSize);
+    }
+    if (m_completionRing != MAP_FAILED && m_completionRing != m_submissionRing) {
+      munmap(m_completionRing, m_completionRingSize);
+    }
+    if (m_submissionRing != MAP_FAILED) {
+      munmap(m_submissionRing, m_submissionRingSize);
+    }
+    if (m_ringDescriptor >= 0) {
+      close(m_ringDescriptor);
+    }
+  }
+
+  /** Descriptor of the io_uring instance. */
+  int m_ringDescriptor { -1 };
+  /** Memory shared with the kernel, the two rings share one mapping on newer kernels. */
+  void *m_submissionRing { MAP_FAILED };
+  size_t m_submissionRingSize { 0 };
+  void *m_completionRing { MAP_FAILED };
+  size_t m_completionRingSize { 0 };
+  void *m_entries { MAP_FAILED };
+  size_t m_entriesSize { 0 };
+  /** Submission ring, the tail is moved by submitters under m_requestLatch, the head by the kernel. */
+  unsigned *m_submissionTail { nullptr };
+  unsigned *m_submissionMask { nullptr };
+  unsigned *m_submissionArray { nullptr };
+  /** Completion ring, the tail is moved by the kernel, the head by the completion thread. */
+  unsigned *m_completionHead { nullptr };
+  unsigned *m_completionTail { nullptr };
+  unsigned *m_completionMask { nullptr };
+  io_uring_cqe *m_completions { nullptr };
+};
+#else
+struct FileStore::IOEngine {
+};
+#endif
+
+FileStore::FileStore(const std::string &tableName, bool enableAsyncIO, bool enableUnbufferedIO)
+    : m_enableUnbufferedIO(enableUnbufferedIO), m_enableAsyncIO(enableAsyncIO) {
+  openFile(m_tableFile, tableName + ".db", "table file");
+  openFile(m_indexFile, tableName + ".idx", "index file");
+
+  if (enableAsyncIO) {
+    m_ioEngine = createIOEngine();
+  }
+  if (m_ioEngine != nullptr) {
+    try {
+      m_completionThread = std::thread { &FileStore::completionThreadMain, this };
+    } catch (const std::system_error &) {
+      // nobody would reap the completions, every request is served synchronously
+      m_ioEngine.reset();
     }
   }
 }
 
 FileStore::~FileStore() {
-  m_tableFileIO.close();
+  stopIOEngine();
+  trimFile_helper(m_tableFile);
+  trimFile_helper(m_indexFile);
+  closeFile(m_tableFile);
+  closeFile(m_indexFile);
 }
 
 FileSizeType FileStore::pageIDToOffset(PageIDType pageID) {
   // pageID * 4096
-  return pageID << 12;
+  return static_cast<FileSizeType>(pageID) << 12;
 }
 
-void FileStore::readRawPage(FileType fileType, PageIDType pageID, ByteType *raw) {
+FileStore::DataFile &FileStore::getDataFile(FileType fileType) {
   switch (fileType) {
   case FileType::TABLE:
-    readRawPage_helper(m_tableFileIO, pageID, raw, "table file");
-    break;
+    return m_tableFile;
+  case FileType::INDEX:
+    return m_indexFile;
   default:
     throw std::runtime_error("wrong file type");
-    break;
   }
 }
 
+PageIDType FileStore::getPageCount(FileType fileType) {
+  std::lock_guard<std::mutex> lck(m_fileLatch);
+  return getDataFile(fileType).m_pageCount;
+}
+
+void FileStore::setPageCount(FileType fileType, PageIDType pageCount) {
+  std::lock_guard<std::mutex> lck(m_fileLatch);
+  DataFile &file = getDataFile(fileType);
+  file.m_pageCount = pageCount;
+  file.m_allocatedPageCount = std::max(file.m_allocatedPageCount, pageCount);
+}
+
+const std::string &FileStore::getFileName(FileType fileType) {
+  return getDataFile(fileType).m_fileName;
+}
+
+void FileStore::reservePage(FileType fileType, PageIDType pageID) {
+  std::lock_guard<std::mutex> lck(m_fileLatch);
+  DataFile &file = getDataFile(fileType);
+  
+  if (pageID >= file.m_allocatedPageCount) {
+    // grow by whole extents, so that appending pages seldom touches the file
+    PageIDType extentCount = (pageID - file.m_allocatedPageCount) / EXTENT_PAGES + 1;
+    extendFile_helper(file, file.m_allocatedPageCount + extentCount * EXTENT_PAGES);
+  }
+  file.m_pageCount = std::max(file.m_pageCount, pageID + 1);
+}
+
+void FileStore::readRawPage(FileType fileType, PageIDType pageID, ByteType *raw) {
+  std::lock_guard<std::mutex> lck(m_fileLatch);
+  ScopedLatency latency(m_readLatency);
+  readRawPages_helper(getDataFile(fileType), pageID, &raw, 1);
+}
+
 void FileStore::writeRawPage(FileType fileType, PageIDType pageID, const ByteType *raw) {
-  switch (fileType) {
-  case FileType::TABLE:
-    writeRawPage_helper(m_tableFileIO, pageID, raw, "table file");
-    break;
-  default:
-    throw std::runtime_error("wrong file type");
-    break;
+  std::lock_guard<std::mutex> lck(m_fileLatch);
+  ScopedLatency latency(m_writeLatency);
+  writeRawPages_helper(getDataFile(fileType), pageID, &raw, 1);
+}
+
+void FileStore::readRawPages(FileType fileType, PageIDType firstPageID,
+                             ByteType *const *raws, size_t pageCount) {
+  std::lock_guard<std::mutex> lck(m_fileLatch);
+  ScopedLatency latency(m_readLatency);
+  readRawPages_helper(getDataFile(fileType), firstPageID, raws, pageCount);
+}
+
+void FileStore::writeRawPages(FileType fileType, PageIDType firstPageID,
+                              const ByteType *const *raws, size_t pageCount) {
+  std::lock_guard<std::mutex> lck(m_fileLatch);
+  ScopedLatency latency(m_writeLatency);
+  writeRawPages_helper(getDataFile(fileType), firstPageID, raws, pageCount);
+}
+
+void FileStore::readRawPages_helper(DataFile &file, PageIDType firstPageID,
+                                    ByteType *const *raws, size_t pageCount) {
+  FileSizeType offset = pageIDToOffset(firstPageID);
+  
+  // a single page, or every page of an unbuffered file, is read straight into its frame
+  if (pageCount == 1 || file.m_isUnbuffered) {
+    for (size_t i = 0; i < pageCount; ++i) {
+      ByteType *data = isDirectBuffer_helper(file, raws[i]) ? raws[i] : getStagingBuffer_helper(1);
+      if (readAt_helper(file, offset + i * PAGE_SIZE, data, PAGE_SIZE) < PAGE_SIZE) {
+        throw std::runtime_error("read less than one page while reading " + file.m_description);
+      }
+      if (data != raws[i]) {
+        memcpy(raws[i], data, PAGE_SIZE);
+      }
+    }
+    return;
+  }
+  
+  // read the whole range at once, then scatter it into the frames
+  ByteType *buffer = getStagingBuffer_helper(pageCount);
+  if (readAt_helper(file, offset, buffer, pageCount * PAGE_SIZE) < pageCount * PAGE_SIZE) {
+    throw std::runtime_error("read less than requested pages while reading " + file.m_description);
+  }
+  for (size_t i = 0; i < pageCount; ++i) {
+    memcpy(raws[i], buffer + i * PAGE_SIZE, PAGE_SIZE);
   }
 }
 
-void FileStore::readRawPage_helper(std::fstream &fileIO, PageIDType pageID,
-                                   ByteType *raw, const std::string &fileName) {
-  FileSizeType offset = pageIDToOffset(pageID);
+void FileStore::writeRawPages_helper(DataFile &file, PageIDType firstPageID,
+                                     const ByteType *const *raws, size_t pageCount) {
+  FileSizeType offset = pageIDToOffset(firstPageID);
+  
+  // a single page, or every page of an unbuffered file, is written straight from its frame
+  if (pageCount == 1 || file.m_isUnbuffered) {
+    for (size_t i = 0; i < pageCount; ++i) {
+      const ByteType *data = raws[i];
+      if (!isDirectBuffer_helper(file, data)) {
+        data = static_cast<const ByteType *>(memcpy(getStagingBuffer_helper(1), raws[i], PAGE_SIZE));
+      }
+      writeAt_helper(file, offset + i * PAGE_SIZE, data, PAGE_SIZE);
+    }
+  } else {
+    // gather the pages so that the whole range is written at once
+    ByteType *buffer = getStagingBuffer_helper(pageCount);
+    for (size_t i = 0; i < pageCount; ++i) {
+      memcpy(buffer + i * PAGE_SIZE, raws[i], PAGE_SIZE);
+    }
+    writeAt_helper(file, offset, buffer, pageCount * PAGE_SIZE);
+  }
   
-  fileIO.seekg(offset, std::ios::beg);
-  fileIO.read(raw, PAGE_SIZE);
-  if (fileIO.bad()) {
-    throw std::runtime_error("IO error while reading " + fileName);
+  PageIDType endPageID = firstPageID + static_cast<PageIDType>(pageCount);
+  file.m_pageCount = std::max(file.m_pageCount, endPageID);
+  file.m_allocatedPageCount = std::max(file.m_allocatedPageCount, endPageID);
+}
+
+void FileStore::extendFile_helper(DataFile &file, PageIDType allocatedPageCount) {
+  // the whole extent is allocated in one request, so that appended pages are laid out together on disk and
+  // writing them later cannot run out of space, the reserved pages read as zeros until they are written
+  allocateFile_helper(file, allocatedPageCount);
+  file.m_allocatedPageCount = allocatedPageCount;
+}
+
+void FileStore::sync(FileType fileType) {
+  DataFile &file = getDataFile(fileType);
+#ifdef _WIN32
+  bool isSynced = FlushFileBuffers(file.m_fileHandle);
+#else
+  bool isSynced = (fsync(file.m_fileDescriptor) == 0);
+#endif
+  if (!isSynced) {
+    throw std::runtime_error("IO error while syncing " + file.m_description);
+  }
+}
+
+bool FileStore::isDirectBuffer_helper(const DataFile &file, const ByteType *data) const {
+  return !file.m_isUnbuffered || reinterpret_cast<uintptr_t>(data) % PAGE_SIZE == 0;
+}
+
+ByteType *FileStore::getStagingBuffer_helper(size_t pageCount) {
+  if (pageCount > m_stagingPageCount) {
+    if (m_stagingBuffer != nullptr) {
+      m_stagingArena.freeBlock(m_stagingBuffer);
+    }
+    m_stagingBuffer = m_stagingArena.allocateBlock(pageCount);
+    m_stagingPageCount = pageCount;
   }
+  return m_stagingBuffer;
+}
+
+#ifdef _WIN32
+void FileStore::openFile(DataFile &file, const std::string &fileName, const std::string &description) {
+  file.m_fileName = fileName;
+  file.m_description = description;
   
-  int read_bits = fileIO.gcount();
-  if (read_bits < PAGE_SIZE) {
-    throw std::runtime_error("read less than one page while reading " + fileName);
+  // the file is created if it does not exist, the index file is mapped while it is open.
+  // Submitted requests need a file opened for overlapped io
+  DWORD flags = FILE_ATTRIBUTE_NORMAL | (m_enableAsyncIO ? FILE_FLAG_OVERLAPPED : 0);
+  HANDLE fileHandle = INVALID_HANDLE_VALUE;
+  if (m_enableUnbufferedIO) {
+    fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                             nullptr, OPEN_ALWAYS, flags | FILE_FLAG_NO_BUFFERING, nullptr);
+    file.m_isUnbuffered = (fileHandle != INVALID_HANDLE_VALUE);
+  }
+  if (fileHandle == INVALID_HANDLE_VALUE) {
+    fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                             nullptr, OPEN_ALWAYS, flags, nullptr);
+  }
+  if (fileHandle == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("fail to open " + description);
+  }
+  file.m_fileHandle = fileHandle;
+  
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(fileHandle, &fileSize)) {
+    throw std::runtime_error("fail to get the size of " + description);
   }
   
+  // a file closed cleanly ends at its logical end of file, after a crash the preallocated tail counts as pages
+  // until the owner of the pages sets the logical end of file
+  file.m_pageCount = static_cast<PageIDType>(static_cast<FileSizeType>(fileSize.QuadPart) / PAGE_SIZE);
+  file.m_allocatedPageCount = file.m_pageCount;
 }
 
-void FileStore::writeRawPage_helper(std::fstream &fileIO, PageIDType pageID,
-                                    const ByteType *raw, const std::string &fileName) {
-  FileSizeType offset = pageIDToOffset(pageID);
+void FileStore::closeFile(DataFile &file) {
+  if (file.m_fileHandle != nullptr) {
+    CloseHandle(file.m_fileHandle);
+    file.m_fileHandle = nullptr;
+  }
+}
+
+void FileStore::resizeFile_helper(DataFile &file, PageIDType pageCount) {
+  FILE_END_OF_FILE_INFO endOfFile;
+  endOfFile.EndOfFile.QuadPart = static_cast<LONGLONG>(pageIDToOffset(pageCount));
+  if (!SetFileInformationByHandle(file.m_fileHandle, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile))) {
+    throw std::runtime_error("IO error while resizing " + file.m_description);
+  }
+}
+
+void FileStore::allocateFile_helper(DataFile &file, PageIDType pageCount) {
+  // space allocated past the end of file is given back when the file is closed, so the end of file moves too
+  FILE_ALLOCATION_INFO allocation;
+  allocation.AllocationSize.QuadPart = static_cast<LONGLONG>(pageIDToOffset(pageCount));
+  if (!SetFileInformationByHandle(file.m_fileHandle, FileAllocationInfo, &allocation, sizeof(allocation))) {
+    throw std::runtime_error("IO error while allocating " + file.m_description);
+  }
+  resizeFile_helper(file, pageCount);
+}
+
+void FileStore::syncFile(const std::string &fileName) {
+  // flushing needs write access on Windows
+  HANDLE fileHandle = CreateFileA(fileName.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (fileHandle == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("fail to open " + fileName + " for syncing");
+  }
+  bool isSynced = FlushFileBuffers(fileHandle);
+  CloseHandle(fileHandle);
+  if (!isSynced) {
+    throw std::runtime_error("IO error while syncing " + fileName);
+  }
+}
+
+void FileStore::replaceFile(const std::string &fileName, const std::string &targetFileName) {
+  // a write-through move returns once the new directory entry is on disk
+  if (!MoveFileExA(fileName.c_str(), targetFileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+    throw std::runtime_error("fail to replace " + targetFileName);
+  }
+}
+
+void FileStore::syncDirectory(const std::string &) {
+  // directories cannot be flushed on Windows, replaceFile writes its change through instead
+}
+
+size_t FileStore::readAt_helper(DataFile &file, FileSizeType offset, ByteType *data, size_t size) {
+  size_t readSize = 0;
+  while (readSize < size) {
+    DWORD transferredSize = 0;
+    if (!transferAt(file.m_fileHandle, false, offset + readSize, data + readSize,
+                    static_cast<DWORD>(size - readSize), &transferredSize)) {
+      if (GetLastError() == ERROR_HANDLE_EOF) {
+        break;
+      }
+      throw std::runtime_error("IO error while reading " + file.m_description);
+    }
+    if (transferredSize == 0) {
+      break;
+    }
+    readSize += transferredSize;
+  }
+  return readSize;
+}
+
+void FileStore::writeAt_helper(DataFile &file, FileSizeType offset, const ByteType *data, size_t size) {
+  size_t writtenSize = 0;
+  while (writtenSize < size) {
+    DWORD transferredSize = 0;
+    if (!transferAt(file.m_fileHandle, true, offset + writtenSize, const_cast<ByteType *>(data + writtenSize),
+                    static_cast<DWORD>(size - writtenSize), &transferredSize) || transferredSize == 0) {
+      throw std::runtime_error("IO error while writing " + file.m_description);
+    }
+    writtenSize += transferredSize;
+  }
+}
+#else
+void FileStore::openFile(DataFile &file, const std::string &fileName, const std::string &description) {
+  file.m_fileName = fileName;
+  file.m_description = description;
   
-  fileIO.seekp(offset, std::ios::beg);
-  fileIO.write(raw, PAGE_SIZE);
-  if (fileIO.bad()) {
-    throw std::runtime_error("IO error while writing " + fileName);
+  // the file is created if it does not exist
+  int fileDescriptor = -1;
+#ifdef O_DIRECT
+  if (m_enableUnbufferedIO) {
+    fileDescriptor = open(fileName.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0644);
+    file.m_isUnbuffered = (fileDescriptor >= 0);
   }
+#endif
+  if (fileDescriptor < 0) {
+    fileDescriptor = open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+  }
+  if (fileDescriptor < 0) {
+    throw std::runtime_error("fail to open " + description);
+  }
+  file.m_fileDescriptor = fileDescriptor;
   
-  fileIO.flush();
+  struct stat fileStat;
+  if (fstat(fileDescriptor, &fileStat) != 0) {
+    throw std::runtime_error("fail to get the size of " + description);
+  }
+  
+  // a file closed cleanly ends at its logical end of file, after a crash the preallocated tail counts as pages
+  // until the owner of the pages sets the logical end of file
+  file.m_pageCount = static_cast<PageIDType>(static_cast<FileSizeType>(fileStat.st_size) / PAGE_SIZE);
+  file.m_allocatedPageCount = file.m_pageCount;
+}
+
+void FileStore::closeFile(DataFile &file) {
+  if (file.m_fileDescriptor >= 0) {
+    close(file.m_fileDescriptor);
+    file.m_fileDescriptor = -1;
+  }
+}
+
+void FileStore::resizeFile_helper(DataFile &file, PageIDType pageCount) {
+  if (ftruncate(file.m_fileDescriptor, static_cast<off_t>(pageIDToOffset(pageCount))) != 0) {
+    throw std::runtime_error("IO error while resizing " + file.m_description);
+  }
+}
+
+void FileStore::allocateFile_helper(DataFile &file, PageIDType pageCount) {
+  FileSizeType fileSize = pageIDToOffset(file.m_allocatedPageCount);
+  int error = posix_fallocate(file.m_fileDescriptor, static_cast<off_t>(fileSize),
+                              static_cast<off_t>(pageIDToOffset(pageCount) - fileSize));
+  if (error == EOPNOTSUPP || error == EINVAL) {
+    // the file system cannot allocate ahead, the file only grows and its pages are allocated when written
+    resizeFile_helper(file, pageCount);
+  } else if (error != 0) {
+    throw std::runtime_error("IO error while allocating " + file.m_description);
+  }
+}
+
+void FileStore::syncFile(const std::string &fileName) {
+  int fileDescriptor = open(fileName.c_str(), O_RDONLY);
+  if (fileDescriptor < 0) {
+    throw std::runtime_error("fail to open " + fileName + " for syncing");
+  }
+  bool isSynced = (fsync(fileDescriptor) == 0);
+  close(fileDescriptor);
+  if (!isSynced) {
+    throw std::runtime_error("IO error while syncing " + fileName);
+  }
+}
+
+void FileStore::replaceFile(const std::string &fileName, const std::string &targetFileName) {
+  if (rename(fileName.c_str(), targetFileName.c_str()) != 0) {
+    throw std::runtime_error("fail to replace " + targetFileName);
+  }
+}
+
+void FileStore::syncDirectory(const std::string &fileName) {
+  // a directory entry is durable once the directory itself is synced
+  std::filesystem::path directory = std::filesystem::absolute(fileName).parent_path();
+  int fileDescriptor = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fileDescriptor < 0) {
+    throw std::runtime_error("fail to open " + directory.string() + " for syncing");
+  }
+  bool isSynced = (fsync(fileDescriptor) == 0);
+  close(fileDescriptor);
+  if (!isSynced) {
+    throw std::runtime_error("IO error while syncing " + directory.string());
+  }
+}
+
+size_t FileStore::readAt_helper(DataFile &file, FileSizeType offset, ByteType *data, size_t size) {
+  size_t readSize = 0;
+  while (readSize < size) {
+    // the offset travels with the request, so the file has no position to share
+    ssize_t transferredSize = pread(file.m_fileDescriptor, data + readSize, size - readSize,
+                                    static_cast<off_t>(offset + readSize));
+    if (transferredSize < 0 && errno == EINTR) {
+      continue;
+    }
+    if (transferredSize < 0) {
+      throw std::runtime_error("IO error while reading " + file.m_description);
+    }
+    if (transferredSize == 0) {
+      break;
+    }
+    readSize += static_cast<size_t>(transferredSize);
+  }
+  return readSize;
+}
+
+void FileStore::writeAt_helper(DataFile &file, FileSizeType offset, const ByteType *data, size_t size) {
+  size_t writtenSize = 0;
+  while (writtenSize < size) {
+    ssize_t transferredSize = pwrite(file.m_fileDescriptor, data + writtenSize, size - writtenSize,
+                                     static_cast<off_t>(offset + writtenSize));
+    if (transferredSize < 0 && errno == EINTR) {
+      continue;
+    }
+    if (transferredSize <= 0) {
+      throw std::runtime_error("IO error while writing " + file.m_description);
+    }
+    writtenSize += static_cast<size_t>(transferredSize);
+  }
+}
+#endif
+
+void FileStore::trimFile_helper(DataFile &file) {
+  if (file.m_pageCount < file.m_allocatedPageCount) {
+    try {
+      resizeFile_helper(file, file.m_pageCount);
+    } catch (const std::exception &) {
+      // the file is left as it is, the owner sets the logical end of file on open
+    }
+  }
+}
+
+IORequestIDType FileStore::submitReadRawPage(FileType fileType, PageIDType pageID, ByteType *raw) {
+  return submitRequest(false, fileType, pageID, raw);
+}
+
+IORequestIDType FileStore::submitWriteRawPage(FileType fileType, PageIDType pageID,
+                                              const ByteType *raw) {
+  // the kernel only reads from raw for a write request
+  return submitRequest(true, fileType, pageID, const_cast<ByteType *>(raw));
+}
+
+bool FileStore::isRequestComplete(IORequestIDType requestID) {
+  std::lock_guard<std::mutex> lck(m_requestLatch);
+  auto requestIter = m_requests.find(requestID);
+  return requestIter == m_requests.end() || requestIter->second.m_isComplete;
+}
+
+void FileStore::waitForRequest(IORequestIDType requestID) {
+  std::unique_lock<std::mutex> lck(m_requestLatch);
+  auto requestIter = m_requests.find(requestID);
+  if (requestIter == m_requests.end()) {
+    return;
+  }
+  m_requestCondition.wait(lck, [&] { return requestIter->second.m_isComplete; });
+
+  std::exception_ptr error = requestIter->second.m_error;
+  m_requests.erase(requestIter);
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void FileStore::waitForAllRequests() {
+  std::unique_lock<std::mutex> lck(m_requestLatch);
+  m_requestCondition.wait(lck, [&] { return m_inFlightCount == 0; });
+}
+
+IORequestIDType FileStore::submitRequest(bool isWrite, FileType fileType,
+                                         PageIDType pageID, ByteType *raw) {
+  DataFile &file = getDataFile(fileType);
+  if (isWrite) {
+    // the file ends after the written page from now on, like after a synchronous write
+    std::lock_guard<std::mutex> lck(m_fileLatch);
+    file.m_pageCount = std::max(file.m_pageCount, pageID + 1);
+    file.m_allocatedPageCount = std::max(file.m_allocatedPageCount, pageID + 1);
+  }
+
+  std::unique_lock<std::mutex> lck(m_requestLatch);
+  IORequestIDType requestID = m_nextRequestID++;
+  IORequest &request = m_requests[requestID];
+  request.m_fileType = fileType;
+  request.m_isWrite = isWrite;
+  request.m_submitTime = std::chrono::steady_clock::now();
+
+  // the kernel transfers straight between raw and an unbuffered file, so raw has to be aligned for that
+  if (m_ioEngine != nullptr && isDirectBuffer_helper(file, raw)) {
+    m_requestCondition.wait(lck, [&] { return m_inFlightCount < MAX_IN_FLIGHT_REQUESTS; });
+    if (startRequest_helper(requestID, isWrite, &file, pageID, raw)) {
+      ++m_inFlightCount;
+      return requestID;
+    }
+  }
+
+  // synchronous fallback, the request is complete before its id is returned
+  lck.unlock();
+  std::exception_ptr error = executeRequest(isWrite, fileType, pageID, raw);
+  lck.lock();
+  completeRequest_helper(requestID, error);
+  return requestID;
+}
+
+std::exception_ptr FileStore::executeRequest(bool isWrite, FileType fileType, PageIDType pageID, ByteType *raw) {
+  try {
+    if (isWrite) {
+      writeRawPage(fileType, pageID, raw);
+    } else {
+      readRawPage(fileType, pageID, raw);
+    }
+  } catch (...) {
+    return std::current_exception();
+  }
+  return nullptr;
+}
+
+void FileStore::completeTransfer_helper(IORequestIDType requestID, bool isTransferred) {
+  IORequest &request = m_requests.at(requestID);
+  std::exception_ptr error;
+  if (!isTransferred) {
+    const std::string &description = getDataFile(request.m_fileType).m_description;
+    error = std::make_exception_ptr(std::runtime_error(
+        (request.m_isWrite ? "IO error while writing " : "IO error while reading ") + description));
+  }
+  (request.m_isWrite ? m_writeLatency : m_readLatency).record(std::chrono::steady_clock::now() - request.m_submitTime);
+
+  --m_inFlightCount;
+  completeRequest_helper(requestID, error);
+}
+
+void FileStore::completeRequest_helper(IORequestIDType requestID, std::exception_ptr error) {
+  IORequest &request = m_requests.at(requestID);
+  request.m_isComplete = true;
+  request.m_error = error;
+}
+
+void FileStore::stopIOEngine() {
+  if (m_ioEngine == nullptr) {
+    return;
+  }
+
+  // the completion thread exits on a request handed over after every other one has completed
+  waitForAllRequests();
+  {
+    std::lock_guard<std::mutex> lck(m_requestLatch);
+    startRequest_helper(INVALID_IO_REQUEST_ID, false, nullptr, 0, nullptr);
+  }
+  m_completionThread.join();
+  m_ioEngine.reset();
+}
+
+#if defined(_WIN32)
+std::unique_ptr<FileStore::IOEngine> FileStore::createIOEngine() {
+  auto engine = std::make_unique<IOEngine>();
+  engine->m_completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+  if (engine->m_completionPort == nullptr ||
+      CreateIoCompletionPort(m_tableFile.m_fileHandle, engine->m_completionPort, 0, 0) == nullptr ||
+      CreateIoCompletionPort(m_indexFile.m_fileHandle, engine->m_completionPort, 0, 0) == nullptr) {
+    return nullptr;
+  }
+  return engine;
+}
+
+bool FileStore::startRequest_helper(IORequestIDType requestID, bool isWrite, DataFile *file,
+                                    PageIDType pageID, ByteType *raw) {
+  if (file == nullptr) {
+    return PostQueuedCompletionStatus(m_ioEngine->m_completionPort, 0, 0, nullptr);
+  }
+
+  auto *request = new OverlappedRequest {};
+  request->m_requestID = requestID;
+  FileSizeType offset = pageIDToOffset(pageID);
+  request->m_overlapped.Offset = static_cast<DWORD>(offset);
+  request->m_overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+  BOOL isStarted = isWrite ? WriteFile(file->m_fileHandle, raw, PAGE_SIZE, nullptr, &request->m_overlapped)
+                           : ReadFile(file->m_fileHandle, raw, PAGE_SIZE, nullptr, &request->m_overlapped);
+
+  // the completion port gets the request back even if it has completed at once
+  if (!isStarted && GetLastError() != ERROR_IO_PENDING) {
+    delete request;
+    return false;
+  }
+  return true;
+}
+
+void FileStore::completionThreadMain() {
+  while (true) {
+    DWORD transferredSize = 0;
+    ULONG_PTR key = 0;
+    OVERLAPPED *overlapped = nullptr;
+    BOOL isDone = GetQueuedCompletionStatus(m_ioEngine->m_completionPort, &transferredSize, &key, &overlapped,
+                                            INFINITE);
+    // only the request handed over by stopIOEngine comes without an overlapped structure
+    if (overlapped == nullptr) {
+      return;
+    }
+
+    auto *request = CONTAINING_RECORD(overlapped, OverlappedRequest, m_overlapped);
+    IORequestIDType requestID = request->m_requestID;
+    delete request;
+    {
+      std::lock_guard<std::mutex> lck(m_requestLatch);
+      completeTransfer_helper(requestID, isDone && transferredSize == PAGE_SIZE);
+    }
+    m_requestCondition.notify_all();
+  }
+}
+#elif defined(__linux__)
+std::unique_ptr<FileStore::IOEngine> FileStore::createIOEngine() {
+  io_uring_params params {};
+  int ringDescriptor = static_cast<int>(syscall(__NR_io_uring_setup, MAX_IN_FLIGHT_REQUESTS, &params));
+  if (ringDescriptor < 0) {
+    // io_uring is missing or forbidden
+    return nullptr;
+  }
+  auto engine = std::make_unique<IOEngine>();
+  engine->m_ringDescriptor = ringDescriptor;
+
+  // map the rings and the submission entries the kernel has set up
+  engine->m_submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  engine->m_completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    engine->m_submissionRingSize = std::max(engine->m_submissionRingSize, engine->m_completionRingSize);
+  }
+  engine->m_submissionRing = mmap(nullptr, engine->m_submissionRingSize, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, ringDescriptor, IORING_OFF_SQ_RING);
+  if (engine->m_submissionRing == MAP_FAILED) {
+    return nullptr;
+  }
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    engine->m_completionRing = engine->m_submissionRing;
+  } else {
+    engine->m_completionRing = mmap(nullptr, engine->m_completionRingSize, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_POPULATE, ringDescriptor, IORING_OFF_CQ_RING);
+    if (engine->m_completionRing == MAP_FAILED) {
+      return nullptr;
+    }
+  }
+  engine->m_entriesSize = params.sq_entries * sizeof(io_uring_sqe);
+  engine->m_entries = mmap(nullptr, engine->m_entriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ringDescriptor, IORING_OFF_SQES);
+  if (engine->m_entries == MAP_FAILED) {
+    return nullptr;
+  }
+
+  auto *submissionRing = static_cast<ByteType *>(engine->m_submissionRing);
+  auto *completionRing = static_cast<ByteType *>(engine->m_completionRing);
+  engine->m_submissionTail = reinterpret_cast<unsigned *>(submissionRing + params.sq_off.tail);
+  engine->m_submissionMask = reinterpret_cast<unsigned *>(submissionRing + params.sq_off.ring_mask);
+  engine->m_submissionArray = reinterpret_cast<unsigned *>(submissionRing + params.sq_off.array);
+  engine->m_completionHead = reinterpret_cast<unsigned *>(completionRing + params.cq_off.head);
+  engine->m_completionTail = reinterpret_cast<unsigned *>(completionRing + params.cq_off.tail);
+  engine->m_completionMask = reinterpret_cast<unsigned *>(completionRing + params.cq_off.ring_mask);
+  engine->m_completions = reinterpret_cast<io_uring_cqe *>(completionRing + params.cq_off.cqes);
+  return engine;
+}
+
+bool FileStore::startRequest_helper(IORequestIDType requestID, bool isWrite, DataFile *file,
+                                    PageIDType pageID, ByteType *raw) {
+  IOEngine &engine = *m_ioEngine;
+  unsigned tail = *engine.m_submissionTail;
+  unsigned index = tail & *engine.m_submissionMask;
+  io_uring_sqe &entry = static_cast<io_uring_sqe *>(engine.m_entries)[index];
+  entry = {};
+  if (file == nullptr) {
+    entry.opcode = IORING_OP_NOP;
+    entry.fd = -1;
+  } else {
+    entry.opcode = isWrite ? IORING_OP_WRITE : IORING_OP_READ;
+    entry.fd = file->m_fileDescriptor;
+    entry.addr = reinterpret_cast<uint64_t>(raw);
+    entry.len = PAGE_SIZE;
+    entry.off = pageIDToOffset(pageID);
+  }
+  entry.user_data = requestID;
+  engine.m_submissionArray[index] = index;
+  std::atomic_ref<unsigned>(*engine.m_submissionTail).store(tail + 1, std::memory_order_release);
+
+  long submittedCount;
+  do {
+    submittedCount = syscall(__NR_io_uring_enter, engine.m_ringDescriptor, 1, 0, 0, nullptr, 0);
+  } while (submittedCount < 0 && errno == EINTR);
+  if (submittedCount != 1) {
+    // the kernel has not taken the entry, take it back
+    std::atomic_ref<unsigned>(*engine.m_submissionTail).store(tail, std::memory_order_release);
+    return false;
+  }
+  return true;
+}
+
+void FileStore::completionThreadMain() {
+  IOEngine &engine = *m_ioEngine;
+  bool isStopping = false;
+  while (!isStopping) {
+    unsigned head = *engine.m_completionHead;
+    unsigned tail = std::atomic_ref<unsigned>(*engine.m_completionTail).load(std::memory_order_acquire);
+    if (head == tail) {
+      // sleep in the kernel until a request completes
+      syscall(__NR_io_uring_enter, engine.m_ringDescriptor, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+      continue;
+    }
+
+    {
+      std::lock_guard<std::mutex> lck(m_requestLatch);
+      for (; head != tail; ++head) {
+        const io_uring_cqe &completion = engine.m_completions[head & *engine.m_completionMask];
+        // only the request handed over by stopIOEngine has no id
+        if (completion.user_data == INVALID_IO_REQUEST_ID) {
+          isStopping = true;
+        } else {
+          completeTransfer_helper(completion.user_data, completion.res == static_cast<int>(PAGE_SIZE));
+        }
+      }
+    }
+    std::atomic_ref<unsigned>(*engine.m_completionHead).store(head, std::memory_order_release);
+    m_requestCondition.notify_all();
+  }
+}
+#else
+std::unique_ptr<FileStore::IOEngine> FileStore::createIOEngine() {
+  // no kernel interface for overlapped io is used on this platform
+  return nullptr;
+}
+
+bool FileStore::startRequest_helper(IORequestIDType, bool, DataFile *, PageIDType, ByteType *) {
+  return false;
 }
 
-void FileStore::createFile(const std::string &fileName) {
-  std::fstream fs{fileName, std::ios::out};
-  fs.close();
+void FileStore::completionThreadMain() {
 }
+#endif
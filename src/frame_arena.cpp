@@ -0,0 +1,68 @@
+#include "frame_arena.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+FrameArena::FrameArena(HugePageMode hugePageMode) : m_hugePageMode(hugePageMode) {}
+
+FrameArena::~FrameArena() {
+  while (!m_blocks.empty()) {
+    freeBlock(m_blocks.begin()->first);
+  }
+}
+
+size_t FrameArena::getAlignment() const {
+  return m_hugePageMode == HugePageMode::NONE ? PAGE_SIZE : HUGE_PAGE_SIZE;
+}
+
+ByteType *FrameArena::allocateBlock(size_t frameCount) {
+  size_t alignment = getAlignment();
+  size_t size = (frameCount * PAGE_SIZE + alignment - 1) / alignment * alignment;
+  ByteType *block = nullptr;
+  bool isMapped = false;
+
+#ifdef __linux__
+  if (m_hugePageMode == HugePageMode::EXPLICIT) {
+    void *mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mapped != MAP_FAILED) {
+      // anonymous mappings are already zeroed
+      block = static_cast<ByteType *>(mapped);
+      isMapped = true;
+    }
+  }
+#endif
+
+  if (block == nullptr) {
+    block = static_cast<ByteType *>(::operator new(size, std::align_val_t { alignment }));
+#ifdef __linux__
+    if (m_hugePageMode != HugePageMode::NONE) {
+      // only a hint, the arena works the same if the kernel ignores it
+      madvise(block, size, MADV_HUGEPAGE);
+    }
+#endif
+    memset(block, 0, size);
+  }
+
+  m_blocks[block] = { size, isMapped };
+  m_allocatedSize += size;
+  return block;
+}
+
+void FrameArena::freeBlock(ByteType *block) {
+  auto blockIter = m_blocks.find(block);
+  if (blockIter == m_blocks.end()) {
+    return;
+  }
+
+  if (blockIter->second.m_isMapped) {
+#ifdef __linux__
+    munmap(block, blockIter->second.m_size);
+#endif
+  } else {
+    ::operator delete(block, std::align_val_t { getAlignment() });
+  }
+
+  m_allocatedSize -= blockIter->second.m_size;
+  m_blocks.erase(blockIter);
+}
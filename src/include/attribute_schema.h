@@ -0,0 +1,26 @@
+#pragma once
+#include "globals.h"
+
+/** Type of the values of an attribute */
+enum class AttributeKind { INTEGER, ENUM, STRING };
+
+/**
+ * AttributeSchema types the values of an attribute. The text of a value is parsed once, when the statement is parsed
+ * or bound, and the typed value flows to the indices and the rows. An INTEGER is ordered as a number, an ENUM is the
+ * position of its enumerator, and a STRING is kept as is.
+ */
+struct AttributeSchema {
+  AttributeKind m_kind { AttributeKind::STRING };
+  /** Names of the values of an ENUM */
+  std::vector<std::string> m_enumerators {};
+  /** Longest value of a STRING, 0 if it is not bounded */
+  size_t m_length { 0 };
+
+  /** @return the typed value of text, throws if text is not a value of the attribute */
+  ValueType parse(std::string_view text) const;
+
+  /** @return the text of a typed value */
+  std::string format(const ValueType &value) const;
+
+  bool operator==(const AttributeSchema &other) const = default;
+};
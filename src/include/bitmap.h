@@ -24,13 +24,34 @@ private:
   uint64_t m_currentPos;
 };
 
+/**
+ * Bitmap keeps its bits in chunks of one page each. A chunk is either owned, a read-only view of a page of the
+ * mapped index file, or absent if it has no bit set. A view is copied on the first write to it.
+ */
 class Bitmap
 {
 public:
   Bitmap(uint64_t &bitmapLength);
+  Bitmap(const Bitmap &other);
+  Bitmap(Bitmap &&other) noexcept = default;
 
   void resize();
 
+  /** Drop every chunk together with its page, all bits become 0 */
+  void clear();
+
+  /** Set all bits to 0, keeping the storage of the chunks for reuse */
+  void reset();
+
+  /** Copy the bits of other into the storage the bitmap already has */
+  Bitmap &assign(const Bitmap &other);
+
+  /** Set the bitmap to the union of disjoint bitmaps, in one pass over its chunks */
+  Bitmap &assignUnion(const std::vector<const Bitmap *> &bitmaps);
+
+  /** Set the bitmap to bitmap without the bits of bitmaps, in one pass over its chunks */
+  Bitmap &assignDifference(const Bitmap &bitmap, const std::vector<const Bitmap *> &bitmaps);
+
   void setBit(uint64_t pos);
   void clearBit(uint64_t pos);
 
@@ -45,11 +66,54 @@ public:
 
   uint64_t getLength() const;
 
+  /** @return number of bytes held by the bitmap storage */
+  size_t getMemoryUsage() const;
+
+  /** @return number of chunks, every chunk is stored in one index page */
+  uint64_t getChunkCount() const;
+
+  /** @return true if the chunk has been modified since it was stored or loaded */
+  bool isChunkDirty(uint64_t chunk) const;
+
+  /** @return number of bits set in the chunk */
+  uint64_t countChunkBits(uint64_t chunk) const;
+
+  /** @return positions of the bits set in the chunk, relative to the start of the chunk */
+  std::vector<uint64_t> getChunkBits(uint64_t chunk) const;
+
+  /** @return id of the index page holding the chunk, INVALID_PAGE_ID if it has never been stored */
+  PageIDType getChunkPageID(uint64_t chunk) const;
+
+  /** Attach the chunk to an index page */
+  void setChunkPageID(uint64_t chunk, PageIDType pageID);
+
+  /** Copy the chunk into a page, and mark it clean */
+  void storeChunk(uint64_t chunk, ByteType *raw);
+
+  /** Detach the chunk from its page and mark it clean, its bits are stored by position instead */
+  void detachChunk(uint64_t chunk);
+
+  /** Set the bits of a chunk stored by position, and mark it clean */
+  void loadChunkBits(uint64_t chunk, const std::vector<uint64_t> &bits);
+
+  /** Copy the chunk from a page, and mark it clean */
+  void loadChunk(uint64_t chunk, const ByteType *raw);
+
+  /** Use a page that outlives the bitmap as the chunk without copying it, and mark it clean */
+  void viewChunk(uint64_t chunk, const ByteType *raw);
+
+  /** Restore the set bit count recorded with the chunks instead of counting the bits of viewed chunks */
+  void setBitCount(uint64_t bitCount);
+
   bool operator[](uint64_t pos) const;
 
   Bitmap &operator&=(const Bitmap &rhs);
   Bitmap &operator|=(const Bitmap &rhs);
   Bitmap operator~();
+  /** Invert every bit in place */
+  Bitmap &flip();
+  /** Clear the bits set in rhs, this &= ~rhs without building ~rhs */
+  Bitmap &andNot(const Bitmap &rhs);
   friend Bitmap operator&(const Bitmap &lhs, const Bitmap &rhs);
   friend Bitmap operator|(const Bitmap &lhs, const Bitmap &rhs);
 
@@ -60,15 +124,41 @@ public:
 
 protected:
   std::out_of_range outOfRange_helper(uint64_t pos) const;
+  /** @return the words of a chunk for reading, an absent chunk reads as zeros */
+  const uint64_t *getChunkWords(uint64_t chunk) const;
+  /** @return the words of a chunk for writing, the chunk is allocated or copied from its view first */
+  uint64_t *getMutableChunkWords(uint64_t chunk);
+  /** @return true if the chunk has no storage, so all of its bits are 0 */
+  bool isAbsentChunk(uint64_t chunk) const;
 
 private:
+  struct Chunk {
+    /** Owned words, CHUNK_WORDS long */
+    std::unique_ptr<uint64_t[]> m_words;
+    /** Read-only words of a mapped page, used if there are no owned words */
+    const uint64_t *m_view { nullptr };
+    /** Index page of the chunk */
+    PageIDType m_pageID { INVALID_PAGE_ID };
+    /** True if the chunk has been modified since it was stored or loaded */
+    bool m_isDirty { true };
+  };
+
   /** Bitmap storage */
-  std::vector<uint64_t> m_bitmap;
+  std::vector<Chunk> m_chunks;
+  /** Number of words covering the bitmap length */
+  uint64_t m_wordCount { 0 };
   /** Bitmap length */
   uint64_t &m_bitmapLength;
   /** Bitmap seted bit count */
   uint64_t m_bitCount { 0 };
 
+  /** Number of words in a chunk, a chunk fills one page */
+  static constexpr uint64_t CHUNK_WORDS { PAGE_SIZE / sizeof(uint64_t) };
+  /** Number of bits in a chunk */
+  static constexpr uint64_t CHUNK_BITS { CHUNK_WORDS * 64 };
+  /** Words of every absent chunk */
+  inline static const uint64_t ms_zeroChunk[CHUNK_WORDS] { };
+
   /** Bitmap mask */
   inline static uint64_t ms_bitmapMask[64] { };
   /** Bitmap not mask */
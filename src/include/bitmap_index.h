@@ -1,11 +1,24 @@
 #pragma once
 #include "globals.h"
+#include "attribute_schema.h"
 #include "bitmap.h"
+#include "index_store.h"
 
+/**
+ * BitmapIndex keeps a bitmap per value of an attribute. The values form a dictionary of dense codes assigned in the
+ * order of the typed values, so that a value is looked up by hash and a range of values is a range of codes. An
+ * index read from the catalog starts as a stub holding only its catalog section, its bitmaps are loaded on first use.
+ * A loaded index that has not changed since it was saved can be unloaded again, it is loaded from the same section
+ * the next time it is used. Saving an index that has not changed costs nothing.
+ */
 class BitmapIndex
 {
 public:
-  BitmapIndex(uint64_t &bitmapLength);
+  /** @param schema types the values, it must outlive the index */
+  BitmapIndex(uint64_t &bitmapLength, const AttributeSchema &schema);
+
+  /** @return schema typing the values */
+  const AttributeSchema &getSchema() const;
 
   /** resize all bitmaps */
   void resize();
@@ -16,20 +29,121 @@ public:
   /** Set all the bitmap bit to 0 on pos */
   void clearAllBitmapBits(uint64_t pos);
 
+  /** Safe to call from concurrent readers, the first one loads the bitmaps */
   Bitmap getBitmap(Token comparator, const ValueType &value);
 
-  const std::map<ValueType, Bitmap> &getAllBitmaps() const;
+  /** Write the bitmap of the records matching comparator and value into resultBitmap, reusing its storage */
+  void getBitmap(Token comparator, const ValueType &value, Bitmap &resultBitmap);
+
+  /** @return bitmap of the records having any value */
+  const Bitmap &getNotNullBitmap();
+
+  /** Append the bitmap of a value to bitmaps, if a record has the value */
+  void collectBitmap(const ValueType &value, std::vector<const Bitmap *> &bitmaps);
+
+  /** Append the bitmaps of the values from low to high, both included, to bitmaps */
+  void collectRangeBitmaps(const ValueType &low, const ValueType &high, std::vector<const Bitmap *> &bitmaps);
+
+  /**
+   * Append the bitmaps of the values matching a LIKE pattern to bitmaps. % matches any characters, a prefix pattern
+   * is a range of the ordered values and a suffix pattern a range of the values reversed.
+   */
+  void collectMatchingBitmaps(const std::string &pattern, std::vector<const Bitmap *> &bitmaps);
+
+  /** @return number of distinct values */
+  size_t getValueCount();
+
+  /** @return code of a value, nullopt if no record has the value */
+  std::optional<ValueCodeType> getCode(const ValueType &value);
+
+  /** @return value of a code, codes are ordered as their values */
+  const ValueType &getValue(ValueCodeType code);
+
+  /** @return number of bytes held by all bitmaps and the value of every record */
+  size_t getMemoryUsage() const;
+
+  /**
+   * Store the changed chunks of all bitmaps and encode where they are into the catalog section, if anything has
+   * changed since the last save
+   * @return true if the section has been encoded again
+   */
+  bool save(IndexStore &indexStore);
+
+  /** @return the catalog section written by the last save or attached */
+  const std::string &getSection() const;
+
+  /** Read the bitmaps listed in the catalog */
+  void load(std::istream &in, IndexStore &indexStore);
+
+  /** Keep the catalog section of the index, the bitmaps are read from it on first use */
+  void attach(std::string section, IndexStore &indexStore);
+
+  /**
+   * Drop the bitmaps if they have not changed since they were saved
+   * @return true if the index has been unloaded
+   */
+  bool unload();
+
+  bool isLoaded() const;
+
+  /** @return the tick of the last use, ticks are shared by all indices */
+  uint64_t getLastAccess() const;
 
 protected:
   bool exist(const ValueType &value);
   /** Set all the bit in a bitmap to 0 on pos */
   void clearBitmapBit(const ValueType &value, uint64_t pos);
+  /** @return bitmap of a value, nullptr if no record has the value */
+  const Bitmap *find_helper(const ValueType &value) const;
+  /** @return first code whose value is not less than value */
+  ValueCodeType lowerBound_helper(const ValueType &value) const;
+  /** @return first code whose value is greater than value */
+  ValueCodeType upperBound_helper(const ValueType &value) const;
+  /** Add a value to the dictionary if it is new, the codes of the greater values move up by one */
+  Bitmap &emplace_helper(const ValueType &value);
+  /** Load the bitmaps from the catalog section if they are not loaded, and record the use */
+  void ensureLoaded_helper();
+  /** Build the reversed values on the first suffix search */
+  void ensureReversed_helper();
+  /** Build the value of every record on the first removal */
+  void ensureRecordValues_helper();
 
 private:
   /** Bitmap length */
   uint64_t &m_bitmapLength;
-  /** Value to bitmap */
-  std::map<ValueType, Bitmap> m_bitmaps;
+  /** Schema typing the values */
+  const AttributeSchema &m_schema;
+  /** Value to its code */
+  std::unordered_map<ValueType, ValueCodeType> m_codes;
+  /** Code to its entry of m_codes, in the order of the values */
+  std::vector<std::pair<const ValueType, ValueCodeType> *> m_values;
+  /** Code to the bitmap of its value, a bitmap is bound to the length so it is held by pointer */
+  std::vector<std::unique_ptr<Bitmap>> m_bitmaps;
   /** Not null value bitmap */
   Bitmap m_notNullBitmap;
+  /** Every value reversed to its bitmap, kept up to date once it has been built */
+  std::map<std::string, const Bitmap *> m_reversedBitmaps;
+  /** True if the reversed values have been built */
+  std::atomic<bool> m_hasReversedBitmaps { false };
+  /** Record position to its entry of m_codes, nullptr if the record has no value, kept up to date once built */
+  std::vector<std::pair<const ValueType, ValueCodeType> *> m_recordValues;
+  /** True if the value of every record has been built */
+  bool m_hasRecordValues { false };
+  /** Index pages of the bitmaps dropped since the last save */
+  std::vector<PageIDType> m_releasedPageIDs;
+  /** Catalog section written by the last save or read from the catalog, empty if there is none */
+  std::string m_section;
+  /** Index store the section refers to */
+  IndexStore *m_indexStore { nullptr };
+  /** True if the bitmaps are in memory */
+  std::atomic<bool> m_isLoaded { true };
+  /** True if the bitmaps have changed since the last save */
+  bool m_isDirty { false };
+  /** Tick of the last use */
+  std::atomic<uint64_t> m_lastAccess { 0 };
+  /** This latch serializes concurrent readers loading the bitmaps */
+  mutable std::mutex m_loadLatch;
+
+  /** Source of the access ticks */
+  inline static std::atomic<uint64_t> ms_accessClock { 0 };
 };
@@ -2,23 +2,67 @@
 #include "globals.h"
 #include "bitmap_index.h"
 #include "buffer_pool_manager.h"
+#include "index_store.h"
+#include "prepared_statement.h"
+#include "table_schema.h"
+#include "write_ahead_log.h"
 #include <fstream>
 
 class RecordIterator {
 public:
-  RecordIterator(const Bitmap &bitmap, BufferPoolManager &bufferPoolManager);
+  RecordIterator(const Bitmap &bitmap, BufferPoolManager &bufferPoolManager, const TableSchema &schema);
   bool hasNext();
-  Record next();
+  Row next();
+
+  /** @return true if the records are read through a scan ring instead of the whole buffer pool */
+  bool isScan() const { return this->m_ring.has_value(); }
+
+protected:
+  void hintPages();
+  BufferRing *getRing();
 
 private:
-  std::stack<RecordIDType> m_recordIDs;
+  /** Record ids in ascending order, so that pages are visited sequentially */
+  std::vector<RecordIDType> m_recordIDs;
+  /** Position of the next record id */
+  size_t m_currentPos { 0 };
+  /** Position of the first record id whose page has not been hinted yet */
+  size_t m_hintedPos { 0 };
   BufferPoolManager &m_bufferPoolManager;
+  /** Layout of the rows */
+  const TableSchema &m_schema;
+  /** Access strategy of a large result, empty for a small one */
+  std::optional<BufferRing> m_ring;
+
+  /** Number of upcoming pages hinted to the buffer pool at a time */
+  static constexpr size_t HINT_PAGES { 8 };
+  /** A result spanning more than this fraction of the pool is read as a scan */
+  static constexpr size_t SCAN_POOL_DIVISOR { 4 };
 };
 
+/**
+ * BitmapIndexManager keeps the bitmap indices of a table and its rows, laid out by the schema of the table. The
+ * schema is saved with the catalog, a table is opened again with the schema it was created with. Every change is logged before it is
+ * applied and committed before the operation returns. The manifest, the segment holding the catalog section of
+ * every attribute, the index file and the table file together form a checkpoint, which is taken once the log
+ * grows past a threshold. On startup the changes logged since the
+ * last checkpoint are redone. Changes are serialized, reads run concurrently with each other.
+ * Attributes read from the catalog are loaded on first use.
+ */
 class BitmapIndexManager
 {
 public:
-  BitmapIndexManager(const std::string &tableName, BufferPoolManager &bufferPoolManager);
+  /**
+   * Creates a new BitmapIndexManager, loading the catalog and redoing the log if they exist.
+   * @param tableName name of the catalog, the log is tableName.wal
+   * @param groupCommitWindow time a commit waits for concurrent commits to sync the log together
+   * @param checkpointLogSize number of log bytes after which a checkpoint is taken
+   * @param schema columns of the table, an attribute is a column
+   */
+  BitmapIndexManager(const std::string &tableName, BufferPoolManager &bufferPoolManager,
+                     std::chrono::microseconds groupCommitWindow = {},
+                     uint64_t checkpointLogSize = DEFAULT_CHECKPOINT_LOG_SIZE,
+                     const TableSchema &schema = TableSchema::getStudentSchema());
   ~BitmapIndexManager();
   uint64_t count(const ConditionType &conditions);
   uint64_t remove(const ConditionType &conditions);
@@ -26,23 +70,132 @@ public:
   uint64_t update(const ConditionType &conditions, const AttributeType &attributes);
   RecordIterator select(const ConditionType &conditions);
 
+  /**
+   * Compile a select or count statement once, its values may be written as ? and bound on every execution
+   * @param sql the statement, every attribute it names must have an index
+   */
+  PreparedStatement prepare(std::string_view sql);
+  uint64_t count(const PreparedStatement &statement, const std::vector<std::string> &parameters);
+  RecordIterator select(const PreparedStatement &statement, const std::vector<std::string> &parameters);
+
+  /** @return bitmap of the records matching the statement with its parameters bound */
+  Bitmap execute(const PreparedStatement &statement, const std::vector<std::string> &parameters);
+
+  /**
+   * Take a checkpoint: write the changed bitmap chunks and table pages, append the sections of the changed
+   * attributes to the segment, replace the manifest and empty the log. Its cost follows what has changed since
+   * the last checkpoint, not the size of the table.
+   */
+  void checkpoint();
+
+  /**
+   * Starts a background thread that takes a checkpoint periodically if anything has changed
+   * @param interval time between two checkpoints
+   */
+  void startBackgroundCheckpointer(std::chrono::milliseconds interval);
+
+  /** Stops the background checkpointer if it is running */
+  void stopBackgroundCheckpointer();
+
+  /** @return number of bytes held by the in-memory bitmap indices */
+  size_t getMemoryUsage() const;
+
+  const TableSchema &getSchema() const;
+
+  /**
+   * Unload the least recently used attributes until the bitmap indices fit the limit. Attributes changed since the
+   * last checkpoint are kept. An unloaded attribute is loaded again on its next use.
+   * @return number of bytes held by the bitmap indices after the call
+   */
+  size_t unloadColdIndices(size_t memoryLimit);
+
 protected:
   bool exist(const std::string &attributeName);
-  void writeRecord(uint64_t pos, Record &&record);
-  void insert_helper(const AttributeType &attributes, uint64_t pos);
-  void update_helper(const AttributeType &attributes, uint64_t pos);
-  Bitmap conditionToBitmap(const ConditionType &conditions);
+  /** @return column id of every attribute, throws if a value does not fit its column */
+  std::vector<ColumnIDType> getColumnIDs_helper(const AttributeType &attributes) const;
+  /** @return bitmap index of a column, created on first use */
+  BitmapIndex &getIndex_helper(ColumnIDType columnID);
+  void insert_helper(const AttributeType &attributes, const std::vector<ColumnIDType> &columnIDs, uint64_t pos,
+                     LSNType lsn);
+  void update_helper(const AttributeType &attributes, const std::vector<ColumnIDType> &columnIDs, uint64_t pos,
+                     LSNType lsn);
+  /** Insert a record at pos, appending records up to it */
+  void insertAt_helper(const AttributeType &attributes, const std::vector<ColumnIDType> &columnIDs, uint64_t pos,
+                       LSNType lsn);
+  void updateAll_helper(const std::vector<RecordIDType> &recordIDs, const AttributeType &attributes, LSNType lsn);
+  void removeAll_helper(const std::vector<RecordIDType> &recordIDs);
+  /** Apply a logged change again */
+  void redo_helper(const LogRecord &record);
+  /** Wait for the change to be durable, and take a checkpoint if the log has grown too long */
+  void commit_helper(LSNType lsn);
+  void checkpoint_helper();
+  void backgroundCheckpointerMain(std::chrono::milliseconds interval);
+  std::string getSegmentName_helper(uint64_t segmentGeneration) const;
+  size_t getMemoryUsage_helper() const;
+  /** Run task(0) to task(count - 1) on as many threads as there are cores */
+  static void forEachParallel_helper(size_t count, const std::function<void(size_t)> &task);
+  const Bitmap &conditionToBitmap(const ConditionType &conditions);
+  /** Compile the postfix conditions into a register program, looking up the bitmap index of every condition */
+  PreparedStatement compile_helper(Token operationType, const ConditionType &conditions);
+  /**
+   * Run the program of a statement
+   * @return the matching records, valid until the thread runs another program or the table changes
+   */
+  const Bitmap &execute_helper(const PreparedStatement &statement, const std::vector<std::string> &parameters);
+  void load_helper(std::istream &fin);
+  /** Load the text dump written before the index file existed, its chunks are stored on the next checkpoint */
+  void loadLegacy_helper(std::istream &fin);
 
 private:
   /** Table name */
   std::string m_tableName;
+  /** Columns and row layout of the table */
+  TableSchema m_schema;
   /** Next record ID */
   RecordIDType m_nextRecordID;
   /** Existence bitmap */
   Bitmap m_existenceBitmap;
   /** Attribute name to bitmap index */
   std::map<std::string, BitmapIndex> m_bitmapIndices;
+  /** Column id to its bitmap index, nullptr until the column has one */
+  std::vector<BitmapIndex *> m_columnIndices;
 
   /** Buffer pool manager */
   BufferPoolManager &m_bufferPoolManager;
+  /** Index pages of the bitmaps */
+  IndexStore m_indexStore;
+  /** Log of the changes since the last checkpoint */
+  WriteAheadLog m_log;
+  /** Number of log bytes after which a checkpoint is taken */
+  uint64_t m_checkpointLogSize;
+  /** Changes hold this latch exclusively, reads hold it shared */
+  mutable std::shared_mutex m_latch;
+
+  using SectionLocationType = std::map<std::string, std::pair<uint64_t, uint64_t>>;
+  /** Generation of the segment, a compaction writes the next one */
+  uint64_t m_segmentGeneration { 0 };
+  /** Number of bytes of the segment the manifest refers to */
+  uint64_t m_segmentSize { 0 };
+  /** Attribute name to the offset and size of its section in the segment */
+  SectionLocationType m_sectionLocations;
+
+  /** The background checkpointer, not joinable if it is not running */
+  std::thread m_checkpointerThread;
+  /** Bool value indicating whether the background checkpointer should exit */
+  bool m_stopCheckpointer { false };
+  /** This latch protects the stop flag of the background checkpointer */
+  std::mutex m_checkpointerLatch;
+  /** This condition variable wakes the background checkpointer up when it should exit */
+  std::condition_variable m_checkpointerCondition;
+
+  /** The segment is compacted once it is this large and less than half of it is alive */
+  static constexpr uint64_t MIN_COMPACTION_SIZE { 64 * 1024 };
+
+  /** Log size that triggers a checkpoint by default */
+  static constexpr uint64_t DEFAULT_CHECKPOINT_LOG_SIZE { 4 * 1024 * 1024 };
+
+  /** First word of a catalog */
+  static constexpr std::string_view CATALOG_HEADER { "BITMAP_INDEX_CATALOG_6" };
+  /** First word of a catalog of any version */
+  static constexpr std::string_view CATALOG_HEADER_PREFIX { "BITMAP_INDEX_CATALOG_" };
 };
@@ -3,19 +3,129 @@
 #include "page.h"
 #include "lru_replacer.h"
 #include "file_store.h"
+#include "frame_arena.h"
+#include "statistics.h"
+
+/**
+ * BufferPoolStatistics is a snapshot of the counters of a BufferPoolManager.
+ */
+struct BufferPoolStatistics {
+  /** Fetches that found the page resident. */
+  uint64_t m_hits { 0 };
+  /** Fetches that had to read the page from disk. */
+  uint64_t m_misses { 0 };
+  /** Pages evicted to make room for other pages. */
+  uint64_t m_evictions { 0 };
+  /** Dirty pages written back on eviction, i.e. on the query path, including the writes behind. */
+  uint64_t m_dirtyWritebacks { 0 };
+  /** Dirty pages written back by the background writer. */
+  uint64_t m_backgroundWrites { 0 };
+  /** Fetches and appends that had to wait on the pool condition for an unpinned frame. */
+  uint64_t m_pinWaits { 0 };
+
+  /** @return the fraction of fetches that found the page resident */
+  double getHitRatio() const {
+    return m_hits + m_misses == 0 ? 0.0 : static_cast<double>(m_hits) / static_cast<double>(m_hits + m_misses);
+  }
+};
+
+class BufferPoolManager;
+
+/**
+ * BufferRing is the access strategy of a large scan. The pages read by the scan recycle a small private ring
+ * of frames instead of taking victims from the whole pool, and they are unpinned at the cold end of the
+ * replacer, so one full scan cannot push the hot pages of point lookups out of the buffer pool.
+ * A ring belongs to one scan and must not be shared between threads.
+ */
+class BufferRing {
+public:
+  /**
+   * Creates a new BufferRing.
+   * @param ringSize number of frames the scan recycles
+   */
+  explicit BufferRing(size_t ringSize = DEFAULT_RING_SIZE) : m_slots(std::max<size_t>(1, ringSize)) {}
+  
+  /** @return number of frames the scan recycles */
+  size_t getRingSize() const { return m_slots.size(); }
+  
+  /** Default number of frames of a ring, it covers the pages read ahead and hinted by a scan. */
+  static constexpr size_t DEFAULT_RING_SIZE = 32;
+
+private:
+  friend class BufferPoolManager;
+  
+  struct Slot {
+    /** The frame last taken by the ring in this slot. */
+    FrameIDType m_frameID = std::numeric_limits<FrameIDType>::max();
+    /** The version of the frame when the ring took it, it changes once the frame is evicted by anybody else. */
+    uint64_t m_version = 0;
+  };
+  
+  std::vector<Slot> m_slots;
+  /** The slot recycled by the next miss. */
+  size_t m_nextSlot = 0;
+};
+
+/**
+ * PageHandle keeps a page pinned for as long as it lives. It unpins the page through its frame,
+ * so releasing it needs neither the pool latch nor a page table lookup.
+ */
+class PageHandle {
+public:
+  PageHandle() = default;
+  PageHandle(BufferPoolManager *bufferPoolManager, Page *page)
+      : m_bufferPoolManager(bufferPoolManager), m_page(page) {}
+  PageHandle(const PageHandle &) = delete;
+  PageHandle &operator=(const PageHandle &) = delete;
+  PageHandle(PageHandle &&other) noexcept { *this = std::move(other); }
+  PageHandle &operator=(PageHandle &&other) noexcept;
+  ~PageHandle() { release(); }
+  
+  /** @return the pinned page, nullptr if the handle is empty */
+  Page *getPage() const { return m_page; }
+  
+  /** @return the data of the pinned page */
+  ByteType *getData() const { return m_page->getData(); }
+  
+  /** @return true if the handle holds a page */
+  explicit operator bool() const { return m_page != nullptr; }
+  
+  /** Marks the page dirty when it is released. */
+  void markDirty() { m_isDirty = true; }
+  
+  /**
+   * Marks the page dirty when it is released, and records that it holds the change logged under lsn.
+   * The page is not written before the log is durable up to lsn.
+   */
+  void markDirty(LSNType lsn);
+  
+  /** Unpins the page, the handle becomes empty. */
+  void release();
+
+private:
+  BufferPoolManager *m_bufferPoolManager = nullptr;
+  Page *m_page = nullptr;
+  bool m_isDirty = false;
+};
 
 /**
  * BufferPoolManager reads disk pages to and from its internal buffer pool.
  */
 class BufferPoolManager {
+  // PageHandle unpins through the frame directly.
+  friend class PageHandle;
+
 public:
   /**
    * Creates a new BufferPoolManager.
    * @param poolSize the size of the buffer pool
    * @param fileStore the disk manager
    * @param enableCondVar indicates whether conditional variables are enabled
+   * @param hugePageMode kind of pages backing the frame arena
+   * @param maxPoolSize the size the buffer pool can grow to, 0 if it cannot grow beyond poolSize
    */
-  BufferPoolManager(size_t poolSize, FileStore *fileStore, bool enableCondVar = false);
+  BufferPoolManager(size_t poolSize, FileStore *fileStore, bool enableCondVar = false,
+                    HugePageMode hugePageMode = HugePageMode::NONE, size_t maxPoolSize = 0);
   
   /**
    * Destroys an existing BufferPoolManager.
@@ -25,16 +135,78 @@ public:
   /** @return pointer to all the pages in the buffer pool */
   Page *getPages() { return m_pages; }
   
+  /** @return the file store the pages are read from and written to */
+  FileStore *getFileStore() const { return m_fileStore; }
+  
   /** @return size of the buffer pool */
   size_t getPoolSize() const { return m_poolSize; }
   
+  /** @return the size the buffer pool can grow to */
+  size_t getMaxPoolSize() const { return m_maxPoolSize; }
+  
+  /** @return number of bytes held by the frames of the buffer pool */
+  size_t getMemoryUsage();
+  
+  /**
+   * Grows or shrinks the buffer pool online. Growing adds frames backed by a new block of the arena.
+   * Shrinking evicts the frames at the end of the pool, writing the dirty ones back, and stops early
+   * at the first pinned frame.
+   * @param poolSize the requested size, clamped to [1, getMaxPoolSize()]
+   * @return the size of the buffer pool after the call
+   */
+  size_t resize(size_t poolSize);
+  
+  /** @return a snapshot of the buffer pool counters */
+  BufferPoolStatistics getStatistics() const;
+  
+  /** Zeroes out the buffer pool counters. */
+  void resetStatistics() { m_statistics.reset(); }
+  
   /**
    * Fetch the requested page from the buffer pool.
    * @param fileType type of file which page belongs
    * @param pageID id of page to be fetched
+   * @param ring access strategy of a scan, nullptr for a normal fetch
    * @return the requested page
    */
-  virtual Page *fetchPage(FileType fileType, PageIDType pageID);
+  virtual Page *fetchPage(FileType fileType, PageIDType pageID, BufferRing *ring = nullptr);
+  
+  /**
+   * Fetch the requested page from the buffer pool, the returned handle unpins it when released.
+   * @param fileType type of file which page belongs
+   * @param pageID id of page to be fetched
+   * @param ring access strategy of a scan, nullptr for a normal fetch
+   * @return a handle of the requested page, empty if no frame could be found for it
+   */
+  PageHandle fetchPageHandle(FileType fileType, PageIDType pageID, BufferRing *ring = nullptr);
+  
+  /**
+   * Fetch a range of consecutive pages, reading the missing ones with as few read requests as possible.
+   * Stops early if no more frames are available.
+   * @param fileType type of file which pages belong
+   * @param firstPageID id of the first page to be fetched
+   * @param pageCount number of pages to be fetched
+   * @return the fetched pages in page id order, all of them are pinned
+   */
+  std::vector<Page *> fetchPages(FileType fileType, PageIDType firstPageID, size_t pageCount);
+  
+  /**
+   * Reads the hinted pages into the buffer pool without pinning them. The reads are submitted without waiting
+   * for them if the file store serves requests asynchronously, otherwise consecutive page ids are read together.
+   * @param fileType type of file which pages belong
+   * @param pageIDs ids of pages that are going to be fetched soon, in ascending order
+   * @param ring access strategy of a scan, nullptr if the pages are read for normal fetches
+   */
+  void prefetchPages(FileType fileType, const std::vector<PageIDType> &pageIDs, BufferRing *ring = nullptr);
+  
+  /**
+   * Starts reading the requested page into the buffer pool without pinning it, so that a later fetchPage
+   * finds it resident. Never waits for a frame to become available.
+   * @param fileType type of file which page belongs
+   * @param pageID id of page to be prefetched
+   * @return true if the page is resident or being read, false if no frame could be found for it
+   */
+  bool prefetchPage(FileType fileType, PageIDType pageID);
   
   /**
    * Unpin the target page from the buffer pool.
@@ -62,26 +234,119 @@ public:
   virtual Page *appendNewPage(FileType fileType, PageIDType pageID);
   
   /**
-   * Flushes all the pages in the buffer pool to disk.
+   * Flushes all the dirty pages in the buffer pool to disk. Pages with adjacent page ids are written together.
+   * The writes of evicted pages still in flight are waited for too.
    */
   void flushAllPages();
+  
+  /**
+   * Starts a background thread that periodically writes dirty unpinned pages back to disk,
+   * so that evictions seldom have to write on the query path.
+   * @param interval time between two rounds of writing
+   * @param maxPagesPerRound maximum number of pages written in one round
+   */
+  void startBackgroundWriter(std::chrono::milliseconds interval, size_t maxPagesPerRound = 64);
+  
+  /**
+   * Stops the background writer if it is running.
+   */
+  void stopBackgroundWriter();
+  
+  /**
+   * Sets the function that makes the write-ahead log durable up to a log sequence number. It is called before
+   * any page changed under a logged change is written. Must be set before such pages exist.
+   */
+  void setLogFlusher(std::function<void(LSNType)> logFlusher) { m_logFlusher = std::move(logFlusher); }
 
 private:
   Page *fetchExistentPage(FileType fileType, PageIDType pageID);
 
+  Page *tryFetchResidentPage_helper(FileType fileType, PageIDType pageID);
+
+  bool tryPin_helper(Page *p);
+
+  bool unpinFrame(Page *p, bool isDirty);
+
+  void mapPage_helper(Page *p, FileType fileType, PageIDType pageID);
+
+  void unmapPage_helper(Page *p);
+
   Page *getVictimPage();
 
+  void evictPage_helper(Page *p);
+
+  Page *getRingVictimPage_helper(BufferRing *ring);
+
+  void unpinNewPage_helper(Page *p, BufferRing *ring);
+
+  Page *waitForVictimPage_helper(std::unique_lock<std::mutex> &lck);
+
   bool flushPage_helper(FileType fileType, PageIDType pageID);
 
+  /**
+   * Waits for the read of the page still in flight. If the page cannot be read, it is dropped from the page
+   * table before the error propagates, and its frame is recycled once unpinned.
+   */
+  void waitForPendingIO_helper(Page *p);
+
+  /**
+   * Takes frames for the pages up to the first resident one and reads them in.
+   * @param isAsync true to submit the reads without waiting for them if the file store serves requests
+   *        asynchronously, the pages are mapped with their requests pending
+   */
+  size_t loadPages_helper(FileType fileType, PageIDType firstPageID, size_t pageCount, Page **pages,
+                          BufferRing *ring = nullptr, bool isAsync = false);
+
+  /** Writes an evicted dirty page from a copy without waiting for it, so the frame can be reused right away */
+  void writeBehind_helper(Page *p);
+
+  /** Waits for the write of the page if it has been evicted with its write still in flight */
+  void finishPendingWrite_helper(FileType fileType, PageIDType pageID);
+
+  /** Releases the writes behind that have completed, and waits for one if there are MAX_PENDING_WRITES */
+  void reapPendingWrites_helper();
+
+  size_t getReadaheadWindow_helper(FileType fileType, PageIDType pageID, BufferRing *ring);
+
+  /**
+   * Writes sorted pages, adjacent pages together, after the log of their changes.
+   * @param copies contents to write instead of the frames, PAGE_SIZE bytes per page, nullptr to write the frames
+   */
+  void writePages_helper(const std::vector<Page *> &pages, const ByteType *copies = nullptr);
+
+  /** Releases a pin taken without the replacer, the frame is not moved to the most recently used end */
+  void unpinWithoutPromotion_helper(Page *p);
+
+  void flushLog_helper(LSNType lsn);
+
+  void backgroundWriterMain(std::chrono::milliseconds interval, size_t maxPagesPerRound);
+
+  void grow_helper(size_t poolSize);
+
+  void shrink_helper(size_t poolSize);
+
 protected:
-  /** Number of pages in the buffer pool. */
-  size_t m_poolSize;
-  /** Array of buffer pool pages. */
+  /** Number of pages in the buffer pool, changed only while holding the pool latch. */
+  std::atomic<size_t> m_poolSize;
+  /** Number of pages the buffer pool can grow to. */
+  size_t m_maxPoolSize;
+  /** Array of buffer pool pages, m_maxPoolSize long so that pages never move when the pool grows. */
   Page *m_pages;
+  /** Memory holding the data of the pages. */
+  FrameArena m_frameArena;
+  /** Blocks of the arena backing the frames, with the id of the first frame of each, in frame order. */
+  std::vector<std::pair<FrameIDType, ByteType *>> m_frameBlocks;
   /** Pointer to the file store. */
   FileStore *m_fileStore;
+  /** Makes the write-ahead log durable up to a log sequence number, empty if changes are not logged. */
+  std::function<void(LSNType)> m_logFlusher;
   /** Page table for keeping track of buffer pool pages. */
   std::map<std::pair<FileType, PageIDType>, FrameIDType> m_pageTable;
+  /**
+   * This latch protects the page table against the optimistic fetch path, which only takes it shared.
+   * Changes to the page table take it exclusively while holding the pool latch.
+   */
+  std::shared_mutex m_pageTableLatch;
   /** Replacer to find unpinned pages for replacement. */
   Replacer *m_replacer;
   /** List of free pages. */
@@ -92,4 +357,37 @@ protected:
   std::condition_variable m_poolCondition;
   /** Bool value indicating whether conditional variables are enabled **/
   bool m_enableCondVar;
+  /** Id of the last page missed in each file, used to detect sequential access. */
+  std::map<FileType, PageIDType> m_lastMissPageIDs;
+  /** Number of consecutive sequential misses in each file. */
+  std::map<FileType, size_t> m_sequentialMissCounts;
+  /** Number of sequential misses after which the following pages are read ahead. */
+  static constexpr size_t READAHEAD_TRIGGER = 2;
+  /** Maximum number of pages read by a single readahead. */
+  static constexpr size_t READAHEAD_PAGES = 16;
+  /** Maximum number of frames in a block of the arena added by growing the pool. */
+  static constexpr size_t FRAME_BLOCK_PAGES = 64;
+  struct PendingWrite {
+    /** The write in flight, INVALID_IO_REQUEST_ID once it has failed and has to be done synchronously. */
+    IORequestIDType m_requestID;
+    /** Copy of the page being written. */
+    ByteType *m_data;
+  };
+  /** Dirty pages evicted while their writes are in flight, a page is not resident while it is here. */
+  std::map<std::pair<FileType, PageIDType>, PendingWrite> m_pendingWrites;
+  /** Memory of the copies written behind, aligned so that it can be used for unbuffered io. */
+  FrameArena m_writeArena;
+  /** Copies not used by any pending write. */
+  std::vector<ByteType *> m_freeWriteBuffers;
+  /** Maximum number of evicted pages written behind at once. */
+  static constexpr size_t MAX_PENDING_WRITES = 32;
+  /** Counters of the buffer pool. */
+  enum Counter { HIT, MISS, EVICTION, DIRTY_WRITEBACK, BACKGROUND_WRITE, PIN_WAIT, COUNTER_COUNT };
+  ShardedCounters<COUNTER_COUNT> m_statistics;
+  /** The background writer, not joinable if it is not running. */
+  std::thread m_writerThread;
+  /** Bool value indicating whether the background writer should exit */
+  bool m_stopWriter = false;
+  /** This condition variable wakes the background writer up when it should exit. */
+  std::condition_variable m_writerCondition;
 };
@@ -1,24 +1,247 @@
 #pragma once
 
 #include "globals.h"
+#include "frame_arena.h"
+#include "statistics.h"
+
+using IORequestIDType = uint64_t;
+
+constexpr IORequestIDType INVALID_IO_REQUEST_ID { 0 };
 
 class FileStore final {
 public:
-  FileStore(const std::string &tableName);
+  /**
+   * Creates a new FileStore.
+   * @param tableName name of the table, the table file is tableName.db and the index file is tableName.idx
+   * @param enableAsyncIO indicates whether submitted page requests are handed to the kernel (io_uring on Linux,
+   *        an io completion port on Windows), so that up to MAX_IN_FLIGHT_REQUESTS of them are served at once
+   *        and complete in any order. Requests are served synchronously on submission if the kernel interface
+   *        is unavailable
+   * @param enableUnbufferedIO indicates whether the files bypass the page cache of the operating system
+   *        (FILE_FLAG_NO_BUFFERING, O_DIRECT on Linux), so that pages go straight between the frames and the disk.
+   *        A buffer that is not PAGE_SIZE aligned goes through an aligned staging buffer. A file falls back to
+   *        cached io if its file system does not support it.
+   */
+  FileStore(const std::string &tableName, bool enableAsyncIO = false, bool enableUnbufferedIO = false);
   ~FileStore();
   void readRawPage(FileType fileType, PageIDType pageID, ByteType *raw);
   void writeRawPage(FileType fileType, PageIDType pageID, const ByteType *raw);
 
+  /**
+   * Reads consecutive pages with a single read request.
+   * @param raws destinations of the pages, one per page
+   * @param pageCount number of pages to read starting from firstPageID
+   */
+  void readRawPages(FileType fileType, PageIDType firstPageID, ByteType *const *raws, size_t pageCount);
+
+  /**
+   * Writes consecutive pages with a single write request.
+   * @param raws sources of the pages, one per page
+   * @param pageCount number of pages to write starting from firstPageID
+   */
+  void writeRawPages(FileType fileType, PageIDType firstPageID, const ByteType *const *raws, size_t pageCount);
+
+  /** @return number of pages in the file, including pages reserved but not written yet */
+  PageIDType getPageCount(FileType fileType);
+
+  /**
+   * Sets the logical end of file, the owner of the pages knows it from its catalog. After a crash the file still
+   * ends with the preallocated extent, which is not taken for pages then.
+   * @param pageCount number of pages in use
+   */
+  void setPageCount(FileType fileType, PageIDType pageCount);
+
+  /** @return name of the file on disk */
+  const std::string &getFileName(FileType fileType);
+
+  /**
+   * Reserves space for a newly appended page. The file grows by whole extents, so a page appended
+   * in memory can stay there until it is evicted instead of being written immediately.
+   * @param pageID id of the appended page
+   */
+  void reservePage(FileType fileType, PageIDType pageID);
+
+  /** Makes every page written to the file durable, along with the size of the file */
+  void sync(FileType fileType);
+
+  /**
+   * Makes a file written through another handle durable.
+   * @param fileName name of the file, it must exist
+   */
+  static void syncFile(const std::string &fileName);
+
+  /**
+   * Replaces a file by another one at once, a crash leaves either of them. The replacement is durable once
+   * syncDirectory returns.
+   * @param fileName name of the new file, it is gone after the call
+   * @param targetFileName name of the file to be replaced
+   */
+  static void replaceFile(const std::string &fileName, const std::string &targetFileName);
+
+  /**
+   * Makes the files created, replaced and removed in the directory of a file durable.
+   * @param fileName name of a file in the directory
+   */
+  static void syncDirectory(const std::string &fileName);
+
+  /**
+   * Submits a page read, raw must stay valid until the request completes. Blocks while MAX_IN_FLIGHT_REQUESTS
+   * requests are in flight. Every submitted request has to be waited on once, which releases it.
+   * @param raw destination of the page, a buffer that is not PAGE_SIZE aligned is read synchronously
+   *        if the file is unbuffered
+   * @return id of the request to wait on
+   */
+  IORequestIDType submitReadRawPage(FileType fileType, PageIDType pageID, ByteType *raw);
+
+  /**
+   * Submits a page write, raw must stay valid until the request completes. Blocks while MAX_IN_FLIGHT_REQUESTS
+   * requests are in flight. Every submitted request has to be waited on once, which releases it.
+   * @param raw source of the page, a buffer that is not PAGE_SIZE aligned is written synchronously
+   *        if the file is unbuffered
+   * @return id of the request to wait on
+   */
+  IORequestIDType submitWriteRawPage(FileType fileType, PageIDType pageID, const ByteType *raw);
+
+  /** @return true if the request has completed, successfully or not, or has been released */
+  bool isRequestComplete(IORequestIDType requestID);
+
+  /** Blocks until the request completes and releases it, rethrows the io error if the request failed */
+  void waitForRequest(IORequestIDType requestID);
+
+  /** Blocks until no request is in flight, the completed requests still have to be waited on */
+  void waitForAllRequests();
+
+  /** @return latencies of page reads, a multi-page read counts once, a submitted one from its submission */
+  const LatencyHistogram &getReadLatencyHistogram() const { return m_readLatency; }
+
+  /** @return latencies of page writes, a multi-page write counts once, a submitted one from its submission */
+  const LatencyHistogram &getWriteLatencyHistogram() const { return m_writeLatency; }
+
+  /** @return true if submitted requests are served asynchronously */
+  bool isAsyncIOEnabled() const { return m_ioEngine != nullptr; }
+
+  /** @return true if the file bypasses the page cache of the operating system */
+  bool isUnbufferedIOEnabled(FileType fileType) { return getDataFile(fileType).m_isUnbuffered; }
+
+  /** Maximum number of submitted requests in flight at once. */
+  static constexpr size_t MAX_IN_FLIGHT_REQUESTS { 64 };
+
 private:
+  /** The kernel interface serving submitted requests, defined per platform. */
+  struct IOEngine;
+
+  struct IORequest {
+    FileType m_fileType;
+    bool m_isWrite;
+    /** Time of submission, the latency of the request is measured from here. */
+    std::chrono::steady_clock::time_point m_submitTime;
+    bool m_isComplete { false };
+    /** Error of the request if it failed. */
+    std::exception_ptr m_error;
+  };
+
+  struct DataFile {
+#ifdef _WIN32
+    /** Handle of the file. */
+    void *m_fileHandle { nullptr };
+#else
+    /** Descriptor of the file. */
+    int m_fileDescriptor { -1 };
+#endif
+    /** Name of the file on disk. */
+    std::string m_fileName;
+    /** Name of the file used in error messages. */
+    std::string m_description;
+    /** Logical end of file, the number of pages appended or written so far. */
+    PageIDType m_pageCount { 0 };
+    /** Physical end of file, the number of pages preallocated on disk. */
+    PageIDType m_allocatedPageCount { 0 };
+    /** True if the file bypasses the page cache, its buffers, offsets and sizes must be PAGE_SIZE aligned. */
+    bool m_isUnbuffered { false };
+  };
+
   FileSizeType pageIDToOffset(PageIDType pageID);
-  
-  void readRawPage_helper(std::fstream &fileIO, PageIDType pageID,
-                          ByteType *raw, const std::string &fileName);
-  void writeRawPage_helper(std::fstream &fileIO, PageIDType pageID,
-                           const ByteType *raw, const std::string &fileName);
-  void createFile(const std::string &fileName);
-  
-  std::fstream m_tableFileIO;
-};
 
+  DataFile &getDataFile(FileType fileType);
+
+  void readRawPages_helper(DataFile &file, PageIDType firstPageID, ByteType *const *raws, size_t pageCount);
+  void writeRawPages_helper(DataFile &file, PageIDType firstPageID, const ByteType *const *raws, size_t pageCount);
+  void extendFile_helper(DataFile &file, PageIDType allocatedPageCount);
+  void openFile(DataFile &file, const std::string &fileName, const std::string &description);
+  void closeFile(DataFile &file);
+  /** Cuts the preallocated tail off a file, so that its size is its logical end of file */
+  void trimFile_helper(DataFile &file);
+  /** Sets the size of a file, the pages it grows by read as zeros */
+  void resizeFile_helper(DataFile &file, PageIDType pageCount);
+  /** Grows a file, allocating disk space for the pages it grows by */
+  void allocateFile_helper(DataFile &file, PageIDType pageCount);
+
+  /**
+   * Reads from a position of the file, a read past the end of file stops there.
+   * @return number of bytes read
+   */
+  size_t readAt_helper(DataFile &file, FileSizeType offset, ByteType *data, size_t size);
+  void writeAt_helper(DataFile &file, FileSizeType offset, const ByteType *data, size_t size);
+
+  /** @return true if the buffer can be used for the io of the file without going through the staging buffer */
+  bool isDirectBuffer_helper(const DataFile &file, const ByteType *data) const;
+
+  /** @return a PAGE_SIZE aligned buffer of at least pageCount pages, m_fileLatch must be held */
+  ByteType *getStagingBuffer_helper(size_t pageCount);
+
+  IORequestIDType submitRequest(bool isWrite, FileType fileType, PageIDType pageID, ByteType *raw);
+  /** Serves a request synchronously */
+  std::exception_ptr executeRequest(bool isWrite, FileType fileType, PageIDType pageID, ByteType *raw);
+  /** @return the kernel interface, nullptr if it is unavailable */
+  std::unique_ptr<IOEngine> createIOEngine();
+  /**
+   * Hands a request to the kernel, m_requestLatch must be held. A nullptr file hands over a request that
+   * transfers nothing and makes the completion thread exit.
+   * @return false if the kernel refused the request
+   */
+  bool startRequest_helper(IORequestIDType requestID, bool isWrite, DataFile *file, PageIDType pageID, ByteType *raw);
+  /** Records the completion of a request handed to the kernel, m_requestLatch must be held */
+  void completeTransfer_helper(IORequestIDType requestID, bool isTransferred);
+  /** Records the completion of a request, m_requestLatch must be held */
+  void completeRequest_helper(IORequestIDType requestID, std::exception_ptr error);
+  void stopIOEngine();
+  void completionThreadMain();
+
+  DataFile m_tableFile;
+  DataFile m_indexFile;
+  /** Bool value indicating whether the files should bypass the page cache */
+  bool m_enableUnbufferedIO;
+  /** Bool value indicating whether submitted requests should be served asynchronously */
+  bool m_enableAsyncIO;
+  /** Latencies of reads. */
+  LatencyHistogram m_readLatency;
+  /** Latencies of writes. */
+  LatencyHistogram m_writeLatency;
+  /** Memory of the staging buffer, aligned so that it can be used for unbuffered io. */
+  FrameArena m_stagingArena;
+  /** Staging buffer of multi-page reads and writes and of unaligned buffers, nullptr until first used. */
+  ByteType *m_stagingBuffer { nullptr };
+  /** Number of pages the staging buffer holds. */
+  size_t m_stagingPageCount { 0 };
+  /** This latch serializes accesses to the files. */
+  std::mutex m_fileLatch;
+
+  /** Submitted requests that have not been waited on yet. */
+  std::map<IORequestIDType, IORequest> m_requests;
+  /** Id of the next submitted request. */
+  IORequestIDType m_nextRequestID { INVALID_IO_REQUEST_ID + 1 };
+  /** Number of requests handed to the kernel that have not completed. */
+  size_t m_inFlightCount { 0 };
+  /** This latch protects the requests and the submission side of the kernel interface. */
+  std::mutex m_requestLatch;
+  /** Signaled when a request completes. */
+  std::condition_variable m_requestCondition;
+  /** The kernel interface, nullptr if async io is disabled or unavailable. */
+  std::unique_ptr<IOEngine> m_ioEngine;
+  /** Reaps the completions of the kernel, runs as long as m_ioEngine exists. */
+  std::thread m_completionThread;
+
+  /** Number of pages the file grows by when it runs out of preallocated space. */
+  static constexpr PageIDType EXTENT_PAGES { 64 };
+};
 
@@ -0,0 +1,68 @@
+#pragma once
+#include "globals.h"
+
+/** Kind of pages backing the frame arena. */
+enum class HugePageMode {
+  /** Regular pages. */
+  NONE,
+  /** Ask the kernel to back the arena with transparent huge pages where it can. */
+  TRANSPARENT,
+  /** Map the arena from the explicit huge page pool, falling back to transparent huge pages. */
+  EXPLICIT
+};
+
+/**
+ * FrameArena owns the memory holding the data of buffer pool frames. Every block it hands out is
+ * at least PAGE_SIZE aligned, so that frames can be used for direct io, and huge page aligned
+ * if huge pages are requested.
+ */
+class FrameArena {
+public:
+  /**
+   * Creates a new FrameArena.
+   * @param hugePageMode kind of pages backing the blocks
+   */
+  explicit FrameArena(HugePageMode hugePageMode = HugePageMode::NONE);
+
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  /** Releases every block that is still allocated. */
+  ~FrameArena();
+
+  /**
+   * Allocates a zeroed block of consecutive frames.
+   * @param frameCount number of frames in the block
+   * @return the start of the block
+   */
+  ByteType *allocateBlock(size_t frameCount);
+
+  /**
+   * Releases a block allocated by this arena.
+   * @param block the start of the block
+   */
+  void freeBlock(ByteType *block);
+
+  /** @return total number of bytes allocated */
+  size_t getAllocatedSize() const { return m_allocatedSize; }
+
+private:
+  struct Block {
+    /** Size of the block rounded up to the alignment. */
+    size_t m_size;
+    /** True if the block was mapped from the explicit huge page pool. */
+    bool m_isMapped;
+  };
+
+  size_t getAlignment() const;
+
+  /** Kind of pages backing the blocks. */
+  HugePageMode m_hugePageMode;
+  /** Start of every allocated block to its book-keeping information. */
+  std::map<ByteType *, Block> m_blocks;
+  /** Total number of bytes allocated. */
+  size_t m_allocatedSize { 0 };
+
+  /** Size of a huge page on the platforms that support them. */
+  static constexpr size_t HUGE_PAGE_SIZE { 2 * 1024 * 1024 };
+};
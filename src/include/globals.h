@@ -5,26 +5,33 @@
 enum class Token {
   SELECT, INSERT, DELETE, UPDATE, WHERE, COUNT,
   LEFT, RIGHT,
-  ATTRIBUTE_NAME, VALUE,
-  AND, OR,
+  ATTRIBUTE_NAME, VALUE, PARAMETER,
+  AND, OR, NOT,
+  IN, BETWEEN,
   EQUAL, NOT_EQUAL,
   IS_NULL, IS_NOT_NULL,
   GREATER_THAN, GREATER_THAN_OR_EQUAL_TO,
   LESS_THAN, LESS_THAN_OR_EQUAL_TO,
+  LIKE,
   EOL
 };
 
 using RecordIDType = uint64_t;
 
-using ValueType = std::string;
+/** A value typed by the schema of its attribute, an integer or an enumerator is held as a number */
+using ValueType = std::variant<int64_t, std::string>;
 
-using SubConditionType = std::tuple<std::string, Token, ValueType>;
+/** Dense code of a value within the dictionary of one attribute */
+using ValueCodeType = uint32_t;
+
+/** A condition keeps the text of its value, it is typed by the index it is compiled against */
+using SubConditionType = std::tuple<std::string, Token, std::string>;
 
 using ConditionType = std::vector<std::variant<Token, SubConditionType>>;
 
 using AttributeType = std::vector<std::pair<std::string, ValueType>>;
 
-enum class FileType {INVALID, TABLE};
+enum class FileType {INVALID, TABLE, INDEX};
 constexpr size_t PAGE_SIZE {4096};
 using FileSizeType = uint64_t;
 using PageIDType = uint32_t;
@@ -32,17 +39,8 @@ using FrameIDType = uint32_t;
 
 constexpr PageIDType INVALID_PAGE_ID { std::numeric_limits<uint32_t>::max() };
 
-using ByteType = char;
-
-enum class Gender { NULL_VALUE, MALE, FEMALE };
+using LSNType = uint64_t;
 
-enum class Department { NULL_VALUE, COMPUTER_SCIENCE, PHYSICS, CHEMISTRY, FOREIGN_LANG };
+constexpr LSNType INVALID_LSN { 0 };
 
-struct Record {
-  char m_name[20] { 0 } ;
-  int m_age { -1 };
-  Gender m_gender { Gender::NULL_VALUE };
-  Department m_department { Department::NULL_VALUE };
-};
-
-constexpr uint8_t MAX_PAGE_RECORD_SIZE { PAGE_SIZE / sizeof(Record)};
+using ByteType = char;
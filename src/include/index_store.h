@@ -0,0 +1,73 @@
+#pragma once
+#include "globals.h"
+#include "bitmap.h"
+#include "buffer_pool_manager.h"
+#include "mapped_file.h"
+
+/**
+ * IndexStore keeps bitmap chunks in the pages of the index file. Pages are read and written through the
+ * buffer pool and a chunk is written only if it has changed. A changed chunk never overwrites its page, it is
+ * written into a free page, so the pages the current catalog refers to stay intact until a new catalog replaces
+ * it. Pages left behind by changed chunks and dropped bitmaps become free once the new catalog is durable.
+ * Which pages belong to which bitmap is recorded in the catalog of the BitmapIndexManager. A chunk with only a few
+ * bits set takes no page, the catalog records the positions of its bits, so a value of a high cardinality attribute
+ * costs bytes rather than a page per chunk.
+ * When bitmaps are read from the catalog, the index file is mapped and the chunks become read-only views of its
+ * pages, so loading costs one step per chunk and no bit is read until it is used.
+ * Bitmaps can be stored and loaded from several threads at once.
+ */
+class IndexStore
+{
+public:
+  IndexStore(BufferPoolManager &bufferPoolManager);
+
+  /** Write the dirty chunks of a bitmap into its pages, new chunks get new pages and sparse chunks none */
+  void storeBitmap(Bitmap &bitmap);
+
+  /** Read every chunk of a bitmap from its pages, through views of the mapped index file where possible */
+  void loadBitmap(Bitmap &bitmap);
+
+  /** Give pages of a dropped bitmap back, they are reused once the next catalog is durable */
+  void releasePages(const std::vector<PageIDType> &pageIDs);
+
+  /** Make the pages released since the last call free, the catalog that no longer refers to them is durable */
+  void commitReleasedPages();
+
+  /** Store a bitmap and write its page ids into the catalog, a sparse chunk is written as the positions of its bits */
+  void writeBitmap(std::ostream &out, Bitmap &bitmap);
+
+  /** Read the page ids of a bitmap from the catalog and load it */
+  void readBitmap(std::istream &in, Bitmap &bitmap);
+
+  /** Write the page allocation state into the catalog, released pages are written as free */
+  void writeAllocation(std::ostream &out) const;
+
+  /** Read the page allocation state from the catalog */
+  void readAllocation(std::istream &in);
+
+  /** @return number of pages of the index file that have ever been used */
+  PageIDType getPageCount() const;
+
+protected:
+  /** Take a free page or append a new one, the page is pinned */
+  Page *allocatePage_helper(PageIDType &pageID);
+
+private:
+  /** Buffer pool manager */
+  BufferPoolManager &m_bufferPoolManager;
+  /** Pages at and after this one have never been used */
+  PageIDType m_nextPageID { 0 };
+  /** Pages no catalog refers to */
+  std::vector<PageIDType> m_freePageIDs;
+  /** Pages the catalog in place still refers to, they become free once the next catalog is durable */
+  std::vector<PageIDType> m_releasedPageIDs;
+  /** This latch protects the page allocation state */
+  mutable std::mutex m_allocationLatch;
+  /** The index file as it was when bitmaps were first read, viewed chunks point into it */
+  std::unique_ptr<MappedFile> m_mappedFile;
+  /** Maps the index file once */
+  std::once_flag m_mapOnce;
+
+  /** A chunk with at most this many bits set is recorded in the catalog instead of a page */
+  static constexpr uint64_t MAX_INLINE_CHUNK_BITS { 128 };
+};
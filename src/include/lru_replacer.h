@@ -14,6 +14,7 @@ public:
   bool victim(FrameIDType *frameID) override;
   void pin(FrameIDType frameID) override;
   void unpin(FrameIDType frameID) override;
+  void unpinCold(FrameIDType frameID) override;
   size_t size() override;
 
 private:
@@ -0,0 +1,40 @@
+#pragma once
+#include "globals.h"
+
+/**
+ * MappedFile maps a whole file read-only into memory. Pages of the mapping are read in by the operating system
+ * on first access, so mapping a large file costs nothing until its data is used. Writes made to the file through
+ * other handles are visible in the mapping, the file must not shrink while it is mapped.
+ */
+class MappedFile {
+public:
+  /**
+   * Maps a file.
+   * @param fileName name of the file, the mapping is empty if the file is empty or cannot be mapped
+   */
+  explicit MappedFile(const std::string &fileName);
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /** Unmaps the file. */
+  ~MappedFile();
+
+  /** @return the start of the mapping, nullptr if nothing is mapped */
+  const ByteType *getData() const { return this->m_data; }
+
+  /** @return number of bytes mapped */
+  size_t getSize() const { return this->m_size; }
+
+private:
+  /** The start of the mapping. */
+  const ByteType *m_data { nullptr };
+  /** Number of bytes mapped. */
+  size_t m_size { 0 };
+#ifdef _WIN32
+  /** Handle of the file. */
+  void *m_fileHandle { nullptr };
+  /** Handle of the file mapping object. */
+  void *m_mappingHandle { nullptr };
+#endif
+};
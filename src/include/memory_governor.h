@@ -0,0 +1,52 @@
+#pragma once
+#include "globals.h"
+#include "buffer_pool_manager.h"
+#include "bitmap_index_manager.h"
+
+/**
+ * MemoryGovernor splits a global memory budget between the buffer pool and the in-memory bitmap indices.
+ * The bitmap indices in use have to stay in memory, so they take what they need and the buffer pool is shrunk to
+ * fit the rest of the budget. If that leaves too little for the buffer pool, cold attributes are unloaded. Within
+ * what is left, the buffer pool grows while its miss ratio is high, e.g. during large scans, and keeps its size while
+ * the working set fits.
+ */
+class MemoryGovernor {
+public:
+  /**
+   * Creates a new MemoryGovernor.
+   * @param memoryBudget number of bytes the buffer pool and the bitmap indices may hold together
+   * @param bufferPoolManager the buffer pool to resize
+   * @param bitmapIndexManager the owner of the bitmap indices
+   */
+  MemoryGovernor(size_t memoryBudget, BufferPoolManager &bufferPoolManager, BitmapIndexManager &bitmapIndexManager);
+
+  /**
+   * Moves memory between the buffer pool and the bitmap indices according to what has been observed since the
+   * last call. Meant to be called between statements.
+   * @return the size of the buffer pool after the call
+   */
+  size_t rebalance();
+
+  /** @return the memory budget in bytes */
+  size_t getMemoryBudget() const { return this->m_memoryBudget; }
+
+  /** Changes the memory budget, it takes effect on the next rebalance. */
+  void setMemoryBudget(size_t memoryBudget) { this->m_memoryBudget = memoryBudget; }
+
+private:
+  /** Number of bytes the buffer pool and the bitmap indices may hold together. */
+  size_t m_memoryBudget;
+  BufferPoolManager &m_bufferPoolManager;
+  BitmapIndexManager &m_bitmapIndexManager;
+  /** Counters of the buffer pool at the last rebalance that looked at them. */
+  BufferPoolStatistics m_lastStatistics;
+
+  /** The buffer pool is never shrunk below this many pages. */
+  static constexpr size_t MIN_POOL_SIZE { 16 };
+  /** Number of fetches needed before the miss ratio is trusted. */
+  static constexpr uint64_t MIN_FETCHES { 256 };
+  /** The buffer pool grows while more fetches than this miss. */
+  static constexpr double GROW_MISS_RATIO { 0.1 };
+  /** The buffer pool grows by this fraction of its size at a time. */
+  static constexpr size_t GROW_DIVISOR { 4 };
+};
@@ -1,18 +1,22 @@
 #pragma once
 #include "globals.h"
+#include "file_store.h"
 
 /**
  * Page is the basic unit of storage within the database system. Page provides a wrapper for actual data pages being
  * held in main memory. Page also contains book-keeping information that is used by the buffer pool manager, e.g.
- * pin count, dirty flag, page id, etc.
+ * pin count, dirty flag, page id, etc. The data itself lives in the frame arena of the buffer pool manager,
+ * so that the book-keeping information of all pages stays compact.
  */
 class Page {
   // There is book-keeping information inside the page that should only be relevant to the buffer pool manager.
   friend class BufferPoolManager;
+  // PageHandle records the log sequence number of the changes made through it.
+  friend class PageHandle;
 
 public:
-  /** Constructor. Zeros out the page data. */
-  Page() { resetMemory(); }
+  /** Constructor. The data is attached by the buffer pool manager. */
+  Page() = default;
   
   /** Default destructor. */
   ~Page() = default;
@@ -27,27 +31,46 @@ public:
   inline PageIDType getPageID() const { return m_pageID; }
   
   /** @return the pin count of this page */
-  inline int getPinCount() const { return m_pinCount; }
+  inline int getPinCount() const { return m_pinCount.load(); }
   
   /** @return true if the page in memory has been modified from the page on disk, false otherwise */
-  inline bool isDirty() const { return m_isDirty; }
+  inline bool isDirty() const { return m_isDirty.load(); }
+  
+  /** @return the version of the frame, bumped every time the frame is taken away from its page */
+  inline uint64_t getVersion() const { return m_version.load(); }
+  
+  /** @return the log sequence number of the last logged change to the page */
+  inline LSNType getLSN() const { return m_lsn.load(); }
 
 protected:
   static constexpr size_t OFFSET_PAGE_START = 0;
+  /** The pin count of a frame while it is being evicted, the optimistic fetch path cannot pin it. */
+  static constexpr int EVICTING_PIN_COUNT = -1;
 
 private:
   /** Zeroes out the data that is held within the page. */
   inline void resetMemory() { memset(m_data, OFFSET_PAGE_START, PAGE_SIZE); }
   
-  /** The type of file which this page belongs. */
-  FileType m_fileType = FileType::INVALID;
-  /** The actual data that is stored within a page. */
-  ByteType m_data[PAGE_SIZE]{};
+  /** The actual data that is stored within a page, a PAGE_SIZE aligned frame of the arena. */
+  ByteType *m_data = nullptr;
+  /** The id of the read still in flight for this page, INVALID_IO_REQUEST_ID if there is none. */
+  std::atomic<IORequestIDType> m_ioRequestID = INVALID_IO_REQUEST_ID;
+  /** The version of the frame, checked by the optimistic fetch path after pinning. */
+  std::atomic<uint64_t> m_version = 0;
+  /** True if the page was read by a scan through a buffer ring and has not been fetched normally since. */
+  std::atomic<bool> m_isScanPage = false;
   /** The ID of this page. */
   PageIDType m_pageID = INVALID_PAGE_ID ;
-  /** The pin count of this page. */
-  int m_pinCount = 0;
+  /** The pin count of this page, changed with atomic operations so that hits need no latch. */
+  std::atomic<int> m_pinCount = 0;
+  /** The type of file which this page belongs. */
+  FileType m_fileType = FileType::INVALID;
   /** True if the page is dirty, i.e. it is different from its corresponding page on disk. */
-  bool m_isDirty = false;
+  std::atomic<bool> m_isDirty = false;
+  /**
+   * The log sequence number of the last logged change to the page, the log is made durable up to it before the
+   * page is written. It is kept when the frame gets another page, which costs at most a log flush that is a no-op.
+   */
+  std::atomic<LSNType> m_lsn = INVALID_LSN;
 };
 
@@ -0,0 +1,71 @@
+#pragma once
+#include "globals.h"
+#include "bitmap_index_manager.h"
+
+struct PlanCacheStatistics {
+  /** Lookups that found the plan of their shape. */
+  uint64_t m_hits { 0 };
+  /** Lookups that had to prepare a plan. */
+  uint64_t m_misses { 0 };
+  /** Plans dropped to make room for other shapes. */
+  uint64_t m_evictions { 0 };
+
+  /** @return the fraction of lookups that found their plan */
+  double getHitRatio() const {
+    return m_hits + m_misses == 0 ? 0.0 : static_cast<double>(m_hits) / static_cast<double>(m_hits + m_misses);
+  }
+};
+
+/**
+ * PlanCache keeps the prepared statements of recently run queries. The literal values of a statement are taken
+ * out of its text, so statements that differ only in their values share one plan and are executed with their
+ * values bound. Finding a plan only tokenizes the statement, it is neither parsed nor compiled again. The least
+ * recently used plan is dropped once the cache is full. Safe to use from concurrent sessions.
+ */
+class PlanCache {
+public:
+  /**
+   * @param bitmapIndexManager manager the plans are prepared by and executed on
+   * @param capacity maximum number of plans kept
+   */
+  PlanCache(BitmapIndexManager &bitmapIndexManager, size_t capacity = DEFAULT_CAPACITY);
+
+  /**
+   * Find the plan of a statement, preparing it if its shape has not been seen recently
+   * @param sql the statement
+   * @param parameters set to the literal values of the statement, to be bound on execution
+   * @return the plan, or null if the statement is not a select or count
+   */
+  std::shared_ptr<const PreparedStatement> lookup(std::string_view sql, std::vector<std::string> &parameters);
+
+  /** @return number of plans in the cache */
+  size_t size();
+
+  PlanCacheStatistics getStatistics();
+
+  /** Maximum number of plans kept by default */
+  static constexpr size_t DEFAULT_CAPACITY { 256 };
+
+protected:
+  /**
+   * Replace the literal values of a statement by parameters
+   * @param schema schema of the table, its column names are kept in the shape
+   * @return the first token of the statement
+   */
+  static Token normalize_helper(std::string_view sql, const TableSchema &schema, std::string &shape,
+                                std::vector<std::string> &parameters);
+
+private:
+  using PlanListType = std::list<std::pair<std::string, std::shared_ptr<const PreparedStatement>>>;
+
+  BitmapIndexManager &m_bitmapIndexManager;
+  /** Maximum number of plans kept */
+  size_t m_capacity;
+  /** Shapes and their plans, the most recently used first */
+  PlanListType m_plans;
+  /** Shape to its position in the plan list */
+  std::unordered_map<std::string_view, PlanListType::iterator> m_planMap;
+  PlanCacheStatistics m_statistics;
+  /** This latch protects the plans and the statistics */
+  std::mutex m_cacheLatch;
+};
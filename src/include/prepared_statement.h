@@ -0,0 +1,94 @@
+#pragma once
+#include "globals.h"
+#include "bitmap_index.h"
+
+/**
+ * BitmapRegisters are the bitmaps a program computes in. They keep their storage between executions, so once
+ * they have grown to the size of the table a program runs without allocating.
+ */
+class BitmapRegisters {
+public:
+  BitmapRegisters() = default;
+  BitmapRegisters(const BitmapRegisters &) = delete;
+  BitmapRegisters &operator=(const BitmapRegisters &) = delete;
+
+  /** Make room for registerCount registers of bitmapLength bits */
+  void prepare(size_t registerCount, uint64_t bitmapLength);
+
+  Bitmap &operator[](size_t index) { return this->m_registers[index]; }
+
+  /** Scratch space of the bound value of an operand, an instruction holds at most two bound values at a time */
+  ValueType &getBoundValue(size_t position) { return this->m_boundValues[position]; }
+
+  /** Scratch list of the bitmaps of a union */
+  std::vector<const Bitmap *> &getUnionBitmaps() { return this->m_unionBitmaps; }
+
+private:
+  /** Length of every register */
+  uint64_t m_bitmapLength { 0 };
+  std::vector<Bitmap> m_registers;
+  std::array<ValueType, 2> m_boundValues;
+  std::vector<const Bitmap *> m_unionBitmaps;
+};
+
+/**
+ * PreparedStatement is a query compiled against the bitmap indices of a table into a program for a small file
+ * of bitmap registers. Every instruction refers to the bitmap index of its attribute directly, and values written
+ * as ? are bound on each execution, so running it again neither lexes nor parses anything. A statement is valid
+ * as long as the BitmapIndexManager that prepared it, and can be executed by many threads at once.
+ */
+class PreparedStatement {
+public:
+  /** @return SELECT or COUNT, the type of the prepared statement */
+  Token getOperationType() const { return this->m_operationType; }
+
+  /** @return number of values to bind on execution */
+  size_t getParameterCount() const { return this->m_parameterCount; }
+
+private:
+  friend class BitmapIndexManager;
+
+  enum class OpCode : uint8_t {
+    /** target = the records matching a condition on one attribute */
+    LOAD,
+    /** target = the records whose value is any of the operands, built in one pass */
+    UNION,
+    /** target = the records whose value is between the two operands, built in one pass */
+    RANGE,
+    /** target = the records whose value matches the LIKE pattern of the operand, built in one pass */
+    MATCH,
+    /** target &= source */
+    AND,
+    /** target |= source */
+    OR
+  };
+
+  struct Operand {
+    ValueType m_value;
+    /** Position of the bound value if the operand is a parameter */
+    std::optional<size_t> m_parameter;
+  };
+
+  struct Instruction {
+    OpCode m_opCode { OpCode::LOAD };
+    uint8_t m_target { 0 };
+    uint8_t m_source { 0 };
+    /** Comparator of a LOAD */
+    Token m_comparator { Token::EQUAL };
+    /** Index of the attribute of a LOAD, UNION, RANGE or MATCH */
+    BitmapIndex *m_bitmapIndex { nullptr };
+    /** Values compared with */
+    std::vector<Operand> m_operands;
+    /** A negated UNION, RANGE or MATCH matches the records having a value outside of its operands */
+    bool m_isNegated { false };
+  };
+
+  Token m_operationType { Token::SELECT };
+  /** The program, its result is left in register 0 */
+  std::vector<Instruction> m_instructions;
+  size_t m_registerCount { 0 };
+  size_t m_parameterCount { 0 };
+
+  /** Programs are short, a register is addressed by a byte */
+  static constexpr size_t MAX_REGISTER_COUNT { 256 };
+};
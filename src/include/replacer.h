@@ -29,6 +29,12 @@ public:
    */
   virtual void unpin(FrameIDType frameID) = 0;
   
+  /**
+   * Unpins a frame that is unlikely to be used again, so that it is victimized before the others.
+   * @param frameID the id of the frame to unpin
+   */
+  virtual void unpinCold(FrameIDType frameID) { unpin(frameID); }
+  
   /** @return the number of elements in the replacer that can be victimized */
   virtual size_t size() = 0;
 };
@@ -1,24 +1,36 @@
 #pragma once
-#include "sqlscannar.h"
+#include "sqltokenizer.h"
+#include "table_schema.h"
+
+/** Value of a condition that is bound when a prepared statement is executed */
+constexpr std::string_view PARAMETER_MARKER { "?" };
 
 struct Where {
-  Where();
+  Where(SQLTokenizer &tokenizer);
   void A();
   void B();
   void C();
+  void In(const std::string &attributeName);
+  void Between(const std::string &attributeName);
+  SQLTokenizer &m_tokenizer;
   ConditionType m_conditions;
 };
 
 struct Attributes {
-  Attributes();
+  Attributes(SQLTokenizer &tokenizer, const TableSchema &schema);
   void A();
+  SQLTokenizer &m_tokenizer;
+  /** Schema typing the values */
+  const TableSchema &m_schema;
   AttributeType m_attributes;
 };
 
+/** A parsed statement. Parsing keeps no global state, so sessions can parse concurrently. */
 struct SQL {
-  SQL(const std::string &sql);
-  void getConditions();
-  void getAttributes();
+  /** @param schema schema of the table the statement runs on, it types the values of an insert or update */
+  SQL(std::string_view sql, const TableSchema &schema = TableSchema::getStudentSchema());
+  void getConditions(SQLTokenizer &tokenizer);
+  void getAttributes(SQLTokenizer &tokenizer, const TableSchema &schema);
   Token m_operationType;
   AttributeType m_attributes;
   ConditionType m_conditions;
@@ -0,0 +1,40 @@
+#pragma once
+#include "globals.h"
+#include "table_schema.h"
+
+/**
+ * SQLTokenizer splits a statement into tokens. A token is a view into the statement, which must outlive the
+ * tokenizer. A word naming a column of the schema is an attribute name, any other word that is not a keyword is a
+ * value. Nothing is shared between tokenizers, so statements can be tokenized concurrently.
+ */
+class SQLTokenizer {
+public:
+  /**
+   * @param sql the statement
+   * @param schema schema of the table the statement runs on, it must outlive the tokenizer
+   */
+  explicit SQLTokenizer(std::string_view sql, const TableSchema &schema = TableSchema::getStudentSchema())
+      : m_sql(sql), m_schema(schema) {}
+
+  /** Moves to the next token, the token is EOL once the statement is exhausted */
+  void next();
+
+  /** @return the current token */
+  Token getToken() const { return m_token; }
+
+  /** @return text of the current token */
+  std::string_view getText() const { return m_text; }
+
+private:
+  bool matchKeyword_helper(std::string_view keyword) const;
+  bool isColumnName_helper(std::string_view word) const;
+
+  /** The statement. */
+  std::string_view m_sql;
+  /** Schema whose column names are the attribute names. */
+  const TableSchema &m_schema;
+  /** Offset of the first character after the current token. */
+  size_t m_position { 0 };
+  Token m_token { Token::EOL };
+  std::string_view m_text;
+};
@@ -0,0 +1,99 @@
+#pragma once
+#include "globals.h"
+
+/**
+ * ShardedCounters is a group of counters that many threads bump concurrently. Every thread is assigned a shard
+ * of its own cache line, so bumping a counter is a relaxed atomic add that seldom contends with other threads.
+ * Reading a counter sums it over all shards.
+ */
+template <size_t CounterCount>
+class ShardedCounters {
+public:
+  /** Adds value to the counter in the shard of the calling thread. */
+  inline void add(size_t counter, uint64_t value = 1) {
+    m_shards[getShardIndex()].m_counters[counter].fetch_add(value, std::memory_order_relaxed);
+  }
+
+  /** @return the sum of the counter over all shards */
+  uint64_t get(size_t counter) const {
+    uint64_t sum { 0 };
+    for (const auto &shard : m_shards) sum += shard.m_counters[counter].load(std::memory_order_relaxed);
+    return sum;
+  }
+
+  /** Zeroes out every counter. */
+  void reset() {
+    for (auto &shard : m_shards) {
+      for (auto &counter : shard.m_counters) counter.store(0, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  static constexpr size_t SHARD_COUNT { 16 };
+
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> m_counters[CounterCount] { };
+  };
+
+  /** @return the shard of the calling thread, assigned round robin on its first use */
+  static size_t getShardIndex() {
+    static std::atomic<size_t> nextShardIndex { 0 };
+    thread_local size_t shardIndex { nextShardIndex.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT };
+    return shardIndex;
+  }
+
+  Shard m_shards[SHARD_COUNT];
+};
+
+/**
+ * LatencyHistogram records latencies into power of two buckets: bucket i holds the latencies in
+ * [2^i, 2^(i+1)) nanoseconds, bucket 0 also holds latencies below one nanosecond.
+ */
+class LatencyHistogram {
+public:
+  static constexpr size_t BUCKET_COUNT { 40 };
+
+  /** Records one latency. */
+  void record(std::chrono::nanoseconds latency);
+
+  /** @return number of latencies recorded */
+  uint64_t getCount() const;
+
+  /** @return number of latencies recorded in the bucket */
+  uint64_t getBucketCount(size_t bucket) const;
+
+  /** @return the exclusive upper bound of the bucket */
+  static std::chrono::nanoseconds getBucketUpperBound(size_t bucket);
+
+  /** @return the mean of the recorded latencies */
+  std::chrono::nanoseconds getMean() const;
+
+  /**
+   * @param percentile a number in [0, 100]
+   * @return upper bound of the bucket holding the percentile, zero if nothing has been recorded
+   */
+  std::chrono::nanoseconds getPercentile(double percentile) const;
+
+  /** Zeroes out every bucket. */
+  void reset();
+
+private:
+  std::atomic<uint64_t> m_buckets[BUCKET_COUNT] { };
+  /** Sum of all latencies recorded, in nanoseconds. */
+  std::atomic<uint64_t> m_totalLatency { 0 };
+};
+
+/**
+ * ScopedLatency records the time between its construction and its destruction into a histogram.
+ */
+class ScopedLatency {
+public:
+  explicit ScopedLatency(LatencyHistogram &histogram)
+      : m_histogram { histogram }, m_start { std::chrono::steady_clock::now() } { }
+
+  ~ScopedLatency() { m_histogram.record(std::chrono::steady_clock::now() - m_start); }
+
+private:
+  LatencyHistogram &m_histogram;
+  std::chrono::steady_clock::time_point m_start;
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include "globals.h"
+#include "attribute_schema.h"
+
+/** Position of a column in the schema of its table */
+using ColumnIDType = uint16_t;
+
+/** A column of a table, stored at a fixed offset of every row */
+struct ColumnSchema {
+  std::string m_name;
+  AttributeSchema m_attribute;
+  /** Offset of the column in a row */
+  uint32_t m_offset { 0 };
+  /** Number of bytes of the column in a row */
+  uint32_t m_width { 0 };
+
+  bool operator==(const ColumnSchema &other) const = default;
+};
+
+/**
+ * TableSchema lays out the fixed-width rows of a table. The layout is computed once when the schema is created: a row
+ * starts with one bit per column telling whether it has a value, then every column follows at its offset, encoded by
+ * the codec of its kind. An INTEGER takes 8 bytes, an ENUM the byte of its position and a STRING its length, padded
+ * with zeros. Reading or writing a column is then a copy at a known offset, addressed by the id of the column.
+ */
+class TableSchema {
+public:
+  /**
+   * Creates a schema, throws if a column cannot be laid out
+   * @param columns name and type of every column, in the order of their ids
+   */
+  TableSchema(std::vector<std::pair<std::string, AttributeSchema>> columns);
+
+  size_t getColumnCount() const;
+
+  const ColumnSchema &getColumn(ColumnIDType columnID) const;
+
+  /** @return id of a column, throws if the table has no such column */
+  ColumnIDType getColumnID(std::string_view columnName) const;
+
+  /** @return number of bytes of a row */
+  size_t getRowSize() const;
+
+  /** @return number of rows stored in a page */
+  RecordIDType getRowsPerPage() const;
+
+  /** Set every column of a row to null */
+  void clearRow(ByteType *row) const;
+
+  /** Encode a value into its column of a row */
+  void writeValue(ByteType *row, ColumnIDType columnID, const ValueType &value) const;
+
+  /** @return value of a column of a row, nullopt if it is null */
+  std::optional<ValueType> readValue(const ByteType *row, ColumnIDType columnID) const;
+
+  /** Write the columns, so that the table is opened again with the schema it was created with */
+  void write(std::ostream &out) const;
+
+  /** Read the columns written by write */
+  static TableSchema read(std::istream &in);
+
+  bool operator==(const TableSchema &other) const;
+
+  /** @return schema of the student table, the table of the server */
+  static const TableSchema &getStudentSchema();
+
+  /** Longest row, so that a row can be copied out of its page without allocating */
+  static constexpr size_t MAX_ROW_SIZE { 256 };
+
+private:
+  std::vector<ColumnSchema> m_columns;
+  /** Column name to id */
+  std::map<std::string, ColumnIDType, std::less<>> m_columnIDs;
+  size_t m_rowSize { 0 };
+};
+
+/** A row copied out of its page, decoded column by column */
+class Row {
+public:
+  Row(const TableSchema &schema, const ByteType *data);
+
+  /** @return value of a column, nullopt if it is null */
+  std::optional<ValueType> getValue(ColumnIDType columnID) const;
+  std::optional<ValueType> getValue(std::string_view columnName) const;
+
+  /** @return text of the value of a column, NULL if it is null */
+  std::string getText(ColumnIDType columnID) const;
+  std::string getText(std::string_view columnName) const;
+
+  const TableSchema &getSchema() const;
+
+private:
+  const TableSchema *m_schema;
+  std::array<ByteType, TableSchema::MAX_ROW_SIZE> m_data;
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include "globals.h"
+
+/** Kind of change described by a log record. */
+enum class LogOperation : uint8_t { INSERT, UPDATE, REMOVE };
+
+/** A logical redo record: which records an operation changed and the values it wrote into them. */
+struct LogRecord {
+  LSNType m_lsn { INVALID_LSN };
+  LogOperation m_operation { LogOperation::INSERT };
+  std::vector<RecordIDType> m_recordIDs;
+  AttributeType m_attributes;
+};
+
+/**
+ * WriteAheadLog appends logical redo records of the changes to a table. Appending only buffers the record, a
+ * commit makes it durable. Concurrent commits are grouped, the first one waits up to the group commit window for
+ * others to join and syncs the log once for all of them. After a checkpoint the log is truncated, the log sequence
+ * numbers keep increasing so that records older than the checkpoint are recognized if the truncation is lost.
+ */
+class WriteAheadLog {
+public:
+  /**
+   * Opens the log, creating it if it does not exist. replay must be called before anything is appended.
+   * @param fileName name of the log file
+   * @param groupCommitWindow time a commit waits for concurrent commits before syncing, 0 to sync at once
+   */
+  WriteAheadLog(const std::string &fileName, std::chrono::microseconds groupCommitWindow = {});
+
+  WriteAheadLog(const WriteAheadLog &) = delete;
+  WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+  /** Closes the log, records that have not been committed are lost. */
+  ~WriteAheadLog();
+
+  /**
+   * Redoes the records written after a checkpoint, and drops a torn record at the end of the log. Throws if the log
+   * was written by another version.
+   * @param checkpointLSN log sequence number of the last change contained in the checkpoint
+   * @param redo applies a record
+   * @return number of records redone
+   */
+  uint64_t replay(LSNType checkpointLSN, const std::function<void(const LogRecord &)> &redo);
+
+  /**
+   * Appends a record to the log buffer.
+   * @return log sequence number of the record
+   */
+  LSNType append(LogOperation operation, const std::vector<RecordIDType> &recordIDs, const AttributeType &attributes);
+
+  /** Blocks until the log is durable up to lsn, syncing together with concurrent commits */
+  void commit(LSNType lsn);
+
+  /** Blocks until the log is durable up to lsn, without waiting for concurrent commits */
+  void flush(LSNType lsn);
+
+  /** Empties the log down to its header, everything appended must be durable and contained in a checkpoint */
+  void truncate();
+
+  /** @return log sequence number of the last appended record */
+  LSNType getLastLSN();
+
+  /** @return number of bytes appended since the last truncation */
+  uint64_t getSize();
+
+  /** @return number of times the log has been synced */
+  uint64_t getSyncCount();
+
+private:
+  void sync_helper(std::unique_lock<std::mutex> &lck, LSNType lsn, std::chrono::microseconds groupCommitWindow);
+  void writeGroup_helper(const std::vector<ByteType> &group);
+  /** Empties the log file and writes the header */
+  void writeHeader_helper();
+  void reopen_helper(uint64_t fileSize);
+  static bool decodeRecord_helper(const std::vector<ByteType> &data, size_t &offset, LogRecord &record);
+  static uint32_t checksum_helper(const ByteType *data, size_t size);
+
+  /** Name of the log file. */
+  std::string m_fileName;
+  /** The log file, opened for appending without buffering. */
+  std::FILE *m_file { nullptr };
+  /** Time a commit waits for concurrent commits to join its group. */
+  std::chrono::microseconds m_groupCommitWindow;
+  /** Records appended but not written yet. */
+  std::vector<ByteType> m_buffer;
+  /** Number of bytes written to the log file since the last truncation. */
+  uint64_t m_fileSize { 0 };
+  /** Log sequence number of the next appended record. */
+  LSNType m_nextLSN { INVALID_LSN + 1 };
+  /** Every record up to this one is durable. */
+  LSNType m_durableLSN { INVALID_LSN };
+  /** Bool value indicating whether a group is being written */
+  bool m_isSyncing { false };
+  /** Number of times the log has been synced. */
+  uint64_t m_syncCount { 0 };
+  /** This latch protects the buffer and the log sequence numbers. */
+  std::mutex m_logLatch;
+  /** Signaled when a group becomes durable or the buffer fills up. */
+  std::condition_variable m_logCondition;
+
+  /** A group is written without waiting for the rest of the window once this many bytes are buffered. */
+  static constexpr size_t MAX_GROUP_BYTES { 1 << 20 };
+
+  /** First line of a log */
+  static constexpr std::string_view LOG_HEADER { "BITMAP_INDEX_LOG_2\n" };
+  /** First line of a log of any version */
+  static constexpr std::string_view LOG_HEADER_PREFIX { "BITMAP_INDEX_LOG_" };
+};
@@ -0,0 +1,140 @@
+#include "index_store.h"
+
+IndexStore::IndexStore(BufferPoolManager &bufferPoolManager) : m_bufferPoolManager { bufferPoolManager } { }
+
+void IndexStore::storeBitmap(Bitmap &bitmap) {
+  for (uint64_t chunk { 0 }; chunk < bitmap.getChunkCount(); ++chunk) {
+    if (not bitmap.isChunkDirty(chunk)) continue;
+
+    // A sparse chunk takes no page, the catalog records the positions of its bits
+    PageIDType oldPageID { bitmap.getChunkPageID(chunk) }, pageID;
+    if (bitmap.countChunkBits(chunk) <= MAX_INLINE_CHUNK_BITS) {
+      bitmap.detachChunk(chunk);
+      if (INVALID_PAGE_ID not_eq oldPageID) releasePages({ oldPageID });
+      continue;
+    }
+
+    // The chunk moves to a free page, its old page is still referred to by the catalog in place
+    Page *page { allocatePage_helper(pageID) };
+    if (nullptr == page) throw std::runtime_error("no frame available for index page");
+    bitmap.setChunkPageID(chunk, pageID);
+    if (INVALID_PAGE_ID not_eq oldPageID) releasePages({ oldPageID });
+
+    bitmap.storeChunk(chunk, page->getData());
+    this->m_bufferPoolManager.unpinPage(FileType::INDEX, pageID, true);
+  }
+}
+
+void IndexStore::loadBitmap(Bitmap &bitmap) {
+  std::call_once(this->m_mapOnce, [this] {
+    // The mapping has to see every page the pool has changed
+    this->m_bufferPoolManager.flushAllPages();
+    FileStore *fileStore { this->m_bufferPoolManager.getFileStore() };
+    this->m_mappedFile = std::make_unique<MappedFile>(fileStore->getFileName(FileType::INDEX));
+  });
+
+  for (uint64_t chunk { 0 }; chunk < bitmap.getChunkCount(); ++chunk) {
+    PageIDType pageID { bitmap.getChunkPageID(chunk) };
+    // The bits of the chunk were read from the catalog, or the bitmap has grown since it was stored
+    if (INVALID_PAGE_ID == pageID) continue;
+
+    // Pages appended after the file was mapped are read through the pool
+    FileSizeType offset { static_cast<FileSizeType>(pageID) * PAGE_SIZE };
+    if (offset + PAGE_SIZE <= this->m_mappedFile->getSize()) {
+      bitmap.viewChunk(chunk, this->m_mappedFile->getData() + offset);
+      continue;
+    }
+
+    PageHandle page { this->m_bufferPoolManager.fetchPageHandle(FileType::INDEX, pageID) };
+    if (not page) throw std::runtime_error("no frame available for index page");
+    bitmap.loadChunk(chunk, page.getData());
+  }
+}
+
+void IndexStore::releasePages(const std::vector<PageIDType> &pageIDs) {
+  std::lock_guard lck { this->m_allocationLatch };
+  for (const auto &pageID : pageIDs) {
+    if (INVALID_PAGE_ID not_eq pageID) this->m_releasedPageIDs.emplace_back(pageID);
+  }
+}
+
+void IndexStore::commitReleasedPages() {
+  std::lock_guard lck { this->m_allocationLatch };
+  this->m_freePageIDs.insert(end(this->m_freePageIDs), begin(this->m_releasedPageIDs), end(this->m_releasedPageIDs));
+  this->m_releasedPageIDs.clear();
+}
+
+void IndexStore::writeBitmap(std::ostream &out, Bitmap &bitmap) {
+  storeBitmap(bitmap);
+
+  out << bitmap.countBits() << " " << bitmap.getChunkCount();
+  for (uint64_t chunk { 0 }; chunk < bitmap.getChunkCount(); ++chunk) {
+    PageIDType pageID { bitmap.getChunkPageID(chunk) };
+    out << " " << pageID;
+    if (INVALID_PAGE_ID not_eq pageID) continue;
+
+    // A chunk without a page is written as its bits, an absent one has none
+    std::vector<uint64_t> bits { bitmap.getChunkBits(chunk) };
+    out << " " << bits.size();
+    for (const auto &bit : bits) out << " " << bit;
+  }
+  out << " ";
+}
+
+void IndexStore::readBitmap(std::istream &in, Bitmap &bitmap) {
+  uint64_t bitCount, chunkCount;
+  in >> bitCount >> chunkCount;
+  for (uint64_t chunk { 0 }; chunk < chunkCount; ++chunk) {
+    PageIDType pageID;
+    in >> pageID;
+    if (INVALID_PAGE_ID == pageID) {
+      uint64_t bitCount;
+      in >> bitCount;
+      std::vector<uint64_t> bits(bitCount);
+      for (auto &bit : bits) in >> bit;
+      if (chunk < bitmap.getChunkCount()) bitmap.loadChunkBits(chunk, bits);
+      continue;
+    }
+    if (chunk < bitmap.getChunkCount()) bitmap.setChunkPageID(chunk, pageID);
+  }
+
+  // Viewed chunks are not counted
+  loadBitmap(bitmap);
+  bitmap.setBitCount(bitCount);
+}
+
+void IndexStore::writeAllocation(std::ostream &out) const {
+  std::lock_guard lck { this->m_allocationLatch };
+  out << this->m_nextPageID << " " << this->m_freePageIDs.size() + this->m_releasedPageIDs.size();
+  for (const auto &pageID : this->m_freePageIDs) out << " " << pageID;
+  for (const auto &pageID : this->m_releasedPageIDs) out << " " << pageID;
+  out << " ";
+}
+
+void IndexStore::readAllocation(std::istream &in) {
+  std::lock_guard lck { this->m_allocationLatch };
+  uint64_t freePageCount;
+  in >> this->m_nextPageID >> freePageCount;
+  this->m_freePageIDs.resize(freePageCount);
+  for (auto &pageID : this->m_freePageIDs) in >> pageID;
+}
+
+PageIDType IndexStore::getPageCount() const {
+  std::lock_guard lck { this->m_allocationLatch };
+  return this->m_nextPageID;
+}
+
+Page *IndexStore::allocatePage_helper(PageIDType &pageID) {
+  // Reuse a released page first, the file only grows when there is none
+  std::unique_lock lck { this->m_allocationLatch };
+  if (not this->m_freePageIDs.empty()) {
+    pageID = this->m_freePageIDs.back();
+    this->m_freePageIDs.pop_back();
+    lck.unlock();
+    return this->m_bufferPoolManager.fetchPage(FileType::INDEX, pageID);
+  }
+
+  pageID = this->m_nextPageID++;
+  lck.unlock();
+  return this->m_bufferPoolManager.appendNewPage(FileType::INDEX, pageID);
+}
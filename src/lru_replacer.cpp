@@ -45,6 +45,18 @@ void LRUReplacer::unpin(FrameIDType frameID) {
   m_lruMap[frameID] = m_lruCache.begin();
 }
 
+void LRUReplacer::unpinCold(FrameIDType frameID) {
+  std::lock_guard<std::mutex> lck(m_lruLatch);
+  /* repeat unpin have no effect */
+  if (exist(frameID)) {
+    return;
+  }
+  
+  /* the least recently used end is victimized first */
+  m_lruCache.push_back(frameID);
+  m_lruMap[frameID] = std::prev(m_lruCache.end());
+}
+
 size_t LRUReplacer::size() {
   std::unique_lock<std::mutex> lck(m_lruLatch);
   return m_lruCache.size();
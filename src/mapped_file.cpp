@@ -0,0 +1,57 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string &fileName) {
+  HANDLE fileHandle { CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+  if (INVALID_HANDLE_VALUE == fileHandle) return;
+  this->m_fileHandle = fileHandle;
+
+  LARGE_INTEGER fileSize;
+  if (not GetFileSizeEx(fileHandle, &fileSize) or 0 == fileSize.QuadPart) return;
+
+  HANDLE mappingHandle { CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr) };
+  if (nullptr == mappingHandle) return;
+  this->m_mappingHandle = mappingHandle;
+
+  void *data { MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) };
+  if (nullptr == data) return;
+  this->m_data = static_cast<const ByteType *>(data);
+  this->m_size = static_cast<size_t>(fileSize.QuadPart);
+}
+
+MappedFile::~MappedFile() {
+  if (nullptr not_eq this->m_data) UnmapViewOfFile(this->m_data);
+  if (nullptr not_eq this->m_mappingHandle) CloseHandle(this->m_mappingHandle);
+  if (nullptr not_eq this->m_fileHandle) CloseHandle(this->m_fileHandle);
+}
+#else
+MappedFile::MappedFile(const std::string &fileName) {
+  int fileDescriptor { open(fileName.c_str(), O_RDONLY) };
+  if (fileDescriptor < 0) return;
+
+  // The mapping stays valid after the descriptor is closed
+  struct stat fileStat;
+  if (0 == fstat(fileDescriptor, &fileStat) and fileStat.st_size > 0) {
+    void *data { mmap(nullptr, fileStat.st_size, PROT_READ, MAP_SHARED, fileDescriptor, 0) };
+    if (MAP_FAILED not_eq data) {
+      this->m_data = static_cast<const ByteType *>(data);
+      this->m_size = static_cast<size_t>(fileStat.st_size);
+    }
+  }
+  close(fileDescriptor);
+}
+
+MappedFile::~MappedFile() {
+  if (nullptr not_eq this->m_data) munmap(const_cast<ByteType *>(this->m_data), this->m_size);
+}
+#endif
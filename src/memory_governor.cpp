@@ -0,0 +1,44 @@
+#include "memory_governor.h"
+
+MemoryGovernor::MemoryGovernor(size_t memoryBudget, BufferPoolManager &bufferPoolManager,
+                               BitmapIndexManager &bitmapIndexManager)
+    : m_memoryBudget { memoryBudget }, m_bufferPoolManager { bufferPoolManager },
+      m_bitmapIndexManager { bitmapIndexManager }, m_lastStatistics { bufferPoolManager.getStatistics() } { }
+
+size_t MemoryGovernor::rebalance() {
+  // 1.   The bitmap indices come first, the buffer pool may use whatever they leave of the budget.
+  //      If they leave less than the smallest pool, cold attributes are unloaded.
+  // 2.   If the buffer pool is larger than that, shrink it.
+  // 3.   Otherwise grow it step by step while enough fetches miss.
+  size_t indexMemory { this->m_bitmapIndexManager.getMemoryUsage() };
+  size_t indexLimit { this->m_memoryBudget - std::min(this->m_memoryBudget, MIN_POOL_SIZE * PAGE_SIZE) };
+  if (indexMemory > indexLimit) indexMemory = this->m_bitmapIndexManager.unloadColdIndices(indexLimit);
+  size_t maxPoolSize { this->m_bufferPoolManager.getMaxPoolSize() };
+  size_t poolLimit { this->m_memoryBudget > indexMemory ? (this->m_memoryBudget - indexMemory) / PAGE_SIZE : 0 };
+  poolLimit = std::clamp(poolLimit, std::min(MIN_POOL_SIZE, maxPoolSize), maxPoolSize);
+
+  size_t poolSize { this->m_bufferPoolManager.getPoolSize() };
+  size_t targetPoolSize { poolSize };
+  if (poolSize > poolLimit) {
+    targetPoolSize = poolLimit;
+  } else {
+    BufferPoolStatistics statistics { this->m_bufferPoolManager.getStatistics() };
+    // The counters have been reset in between
+    if (statistics.m_hits < this->m_lastStatistics.m_hits or statistics.m_misses < this->m_lastStatistics.m_misses) {
+      this->m_lastStatistics = { };
+    }
+    uint64_t hits { statistics.m_hits - this->m_lastStatistics.m_hits };
+    uint64_t misses { statistics.m_misses - this->m_lastStatistics.m_misses };
+
+    // Too few fetches say nothing about the working set, keep accumulating them
+    if (hits + misses >= MIN_FETCHES) {
+      this->m_lastStatistics = statistics;
+      if (static_cast<double>(misses) / static_cast<double>(hits + misses) > GROW_MISS_RATIO) {
+        targetPoolSize = std::min(poolLimit, poolSize + std::max<size_t>(1, poolSize / GROW_DIVISOR));
+      }
+    }
+  }
+
+  if (targetPoolSize == poolSize) return poolSize;
+  return this->m_bufferPoolManager.resize(targetPoolSize);
+}
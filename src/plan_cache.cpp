@@ -0,0 +1,80 @@
+#include "plan_cache.h"
+#include "sqlparser.h"
+
+PlanCache::PlanCache(BitmapIndexManager &bitmapIndexManager, size_t capacity)
+    : m_bitmapIndexManager { bitmapIndexManager }, m_capacity { std::max<size_t>(capacity, 1) } {}
+
+std::shared_ptr<const PreparedStatement> PlanCache::lookup(std::string_view sql,
+                                                           std::vector<std::string> &parameters) {
+  std::string shape;
+  parameters.clear();
+  Token operationType { normalize_helper(sql, this->m_bitmapIndexManager.getSchema(), shape, parameters) };
+  if (Token::SELECT not_eq operationType and Token::COUNT not_eq operationType) return nullptr;
+
+  std::shared_ptr<const PreparedStatement> statement;
+  {
+    std::lock_guard lck { this->m_cacheLatch };
+    auto planIter { this->m_planMap.find(shape) };
+    if (end(this->m_planMap) not_eq planIter) {
+      ++this->m_statistics.m_hits;
+      this->m_plans.splice(begin(this->m_plans), this->m_plans, planIter->second);
+      statement = planIter->second->second;
+    } else {
+      ++this->m_statistics.m_misses;
+    }
+  }
+
+  if (not statement) {
+    // Prepare outside the latch, a concurrent miss on the same shape prepares it as well and keeps its own plan
+    statement = std::make_shared<const PreparedStatement>(this->m_bitmapIndexManager.prepare(shape));
+
+    std::lock_guard lck { this->m_cacheLatch };
+    if (not this->m_planMap.count(shape)) {
+      if (this->m_plans.size() >= this->m_capacity) {
+        this->m_planMap.erase(this->m_plans.back().first);
+        this->m_plans.pop_back();
+        ++this->m_statistics.m_evictions;
+      }
+      this->m_plans.emplace_front(std::move(shape), statement);
+      this->m_planMap.emplace(this->m_plans.front().first, begin(this->m_plans));
+    }
+  }
+
+  // A value the parser would not read as a condition, as in "age is null x", leaves the statement to the parser
+  if (statement->getParameterCount() not_eq parameters.size()) return nullptr;
+  return statement;
+}
+
+size_t PlanCache::size() {
+  std::lock_guard lck { this->m_cacheLatch };
+  return this->m_plans.size();
+}
+
+PlanCacheStatistics PlanCache::getStatistics() {
+  std::lock_guard lck { this->m_cacheLatch };
+  return this->m_statistics;
+}
+
+Token PlanCache::normalize_helper(std::string_view sql, const TableSchema &schema, std::string &shape,
+                                  std::vector<std::string> &parameters) {
+  // Keywords are written in lower case so that their spelling does not split a shape, attribute names are kept
+  // as written since they name the index
+  SQLTokenizer tokenizer { sql, schema };
+  tokenizer.next();
+  Token operationType { tokenizer.getToken() };
+  shape.reserve(sql.size());
+  for (; Token::EOL not_eq tokenizer.getToken(); tokenizer.next()) {
+    if (not shape.empty()) shape += ' ';
+    switch (tokenizer.getToken()) {
+    case Token::VALUE:
+      shape += PARAMETER_MARKER;
+      parameters.emplace_back(tokenizer.getText());
+      break;
+    case Token::ATTRIBUTE_NAME: shape += tokenizer.getText(); break;
+    default:
+      for (char c : tokenizer.getText()) shape += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+      break;
+    }
+  }
+  return operationType;
+}
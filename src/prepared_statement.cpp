@@ -0,0 +1,8 @@
+#include "prepared_statement.h"
+
+void BitmapRegisters::prepare(size_t registerCount, uint64_t bitmapLength) {
+  // The registers refer to the length, it changes as the table grows
+  this->m_bitmapLength = bitmapLength;
+  while (this->m_registers.size() < registerCount) this->m_registers.emplace_back(this->m_bitmapLength);
+  for (size_t index { 0 }; index < registerCount; ++index) this->m_registers[index].resize();
+}
@@ -1,39 +1,71 @@
 #include "bitmap_index_manager.h"
+#include "memory_governor.h"
+#include "plan_cache.h"
 #include "sqlparser.h"
 #include "server.h"
 
-void printRecord(const Record &record) {
-  if (0 == strlen(record.m_name)) std::cout << "NULL";
-  else std::cout << record.m_name;
-  std::cout << "\t\t";
+void printRecord(const Row &row) {
+  // Every column is printed in the order of the schema
+  for (ColumnIDType columnID { 0 }; columnID < row.getSchema().getColumnCount(); ++columnID) {
+    if (0 < columnID) std::cout << "\t\t";
+    std::cout << row.getText(columnID);
+  }
+  std::cout << std::endl;
+}
 
-  if (-1 == record.m_age) std::cout << "NULL";
-  else std::cout << record.m_age;
-  std::cout << "\t\t";
+void printLatency(const std::string &name, const LatencyHistogram &histogram) {
+  std::cout << name << "\t\tcount " << histogram.getCount()
+            << "\tmean " << histogram.getMean().count() << "ns"
+            << "\tp50 < " << histogram.getPercentile(50).count() << "ns"
+            << "\tp99 < " << histogram.getPercentile(99).count() << "ns"
+            << "\tp99.9 < " << histogram.getPercentile(99.9).count() << "ns" << std::endl;
+}
 
-  switch (record.m_gender) {
-  case Gender::NULL_VALUE: std::cout << "NULL"; break;
-  case Gender::MALE: std::cout << "male"; break;
-  case Gender::FEMALE: std::cout << "female"; break;
+void printRecords(RecordIterator iter, const TableSchema &schema) {
+  for (ColumnIDType columnID { 0 }; columnID < schema.getColumnCount(); ++columnID) {
+    if (0 < columnID) std::cout << "\t\t";
+    std::cout << schema.getColumn(columnID).m_name;
   }
-  std::cout << "\t\t";
-
-  switch (record.m_department) {
-  case Department::NULL_VALUE: std::cout << "NULL"; break;
-  case Department::CHEMISTRY: std::cout << "Chemistry"; break;
-  case Department::COMPUTER_SCIENCE: std::cout << "ComputerScience"; break;
-  case Department::FOREIGN_LANG: std::cout << "ForeignLanguage"; break;
-  case Department::PHYSICS: std::cout << "Physics"; break;
+  std::cout << std::endl;
+  uint64_t rowCount { 0 };
+  while (iter.hasNext()) {
+    ++rowCount;
+    printRecord(iter.next());
   }
+  std::cout << "Total " << rowCount << " row(s) selected";
+}
 
-  std::cout << std::endl;
+void printStatistics(BufferPoolManager &bufferPoolManager, FileStore &fileStore, PlanCache &planCache) {
+  BufferPoolStatistics statistics { bufferPoolManager.getStatistics() };
+  std::cout << "pool size\t\t" << bufferPoolManager.getPoolSize() << std::endl;
+  std::cout << "pool memory\t\t" << bufferPoolManager.getMemoryUsage() << std::endl;
+  std::cout << "hits\t\t\t" << statistics.m_hits << std::endl;
+  std::cout << "misses\t\t\t" << statistics.m_misses << std::endl;
+  std::cout << "hit ratio\t\t" << statistics.getHitRatio() << std::endl;
+  std::cout << "evictions\t\t" << statistics.m_evictions << std::endl;
+  std::cout << "dirty writebacks\t" << statistics.m_dirtyWritebacks << std::endl;
+  std::cout << "background writes\t" << statistics.m_backgroundWrites << std::endl;
+  std::cout << "pin waits\t\t" << statistics.m_pinWaits << std::endl;
+  printLatency("reads", fileStore.getReadLatencyHistogram());
+  printLatency("writes", fileStore.getWriteLatencyHistogram());
+
+  PlanCacheStatistics planStatistics { planCache.getStatistics() };
+  std::cout << "cached plans\t\t" << planCache.size() << std::endl;
+  std::cout << "plan hits\t\t" << planStatistics.m_hits << std::endl;
+  std::cout << "plan misses\t\t" << planStatistics.m_misses << std::endl;
+  std::cout << "plan hit ratio\t\t" << planStatistics.getHitRatio() << std::endl;
+  std::cout << "plan evictions\t\t" << planStatistics.m_evictions << std::endl;
 }
 
 int main() {
   Bitmap::initBitmap();
-  FileStore fileStore { "testTable" };
-  BufferPoolManager bufferPoolManager { 100, &fileStore, 0};
+  FileStore fileStore { "testTable", true };
+  BufferPoolManager bufferPoolManager { 100, &fileStore, 0, HugePageMode::NONE, 16384 };
+  bufferPoolManager.startBackgroundWriter(std::chrono::milliseconds { 100 });
   BitmapIndexManager bitmapIndexManager { "TestTable.txt", bufferPoolManager };
+  bitmapIndexManager.startBackgroundCheckpointer(std::chrono::seconds { 10 });
+  MemoryGovernor memoryGovernor { 64 * 1024 * 1024, bufferPoolManager, bitmapIndexManager };
+  PlanCache planCache { bitmapIndexManager };
 
   while (true) {
     std::string sqlString;
@@ -41,36 +73,54 @@ int main() {
     std::getline(std::cin, sqlString);
     if (sqlString == "") continue;
     if (sqlString == "exit") break;
+    if (sqlString == "show stats" or sqlString == "SHOW STATS") {
+      printStatistics(bufferPoolManager, fileStore, planCache);
+      std::cout << std::endl;
+      continue;
+    }
 
-    SQL sql { sqlString };
-    if (Token::SELECT == sql.m_operationType) {
-      std::cout << "name\t\tage\t\tgender\t\tdepartment" << std::endl;
-      uint64_t rowCount { 0 };
-      RecordIterator iter { bitmapIndexManager.select(sql.m_conditions) };
-      while (iter.hasNext()) {
-        ++rowCount;
-        printRecord(iter.next());
+    // A statement the schema does not accept is reported, the table stays open
+    try {
+      // Queries of a shape seen before run their cached plan without being parsed
+      std::vector<std::string> parameters;
+      if (auto plan { planCache.lookup(sqlString, parameters) }) {
+        if (Token::SELECT == plan->getOperationType()) {
+          printRecords(bitmapIndexManager.select(*plan, parameters), bitmapIndexManager.getSchema());
+        }
+        else {
+          std::cout << "There are total " << bitmapIndexManager.count(*plan, parameters) << " row(s) counted";
+        }
+        memoryGovernor.rebalance();
+        std::cout << std::endl << std::endl;
+        continue;
       }
-      std::cout << "Total " << rowCount << " row(s) selected";
-    }
-    else if (Token::INSERT == sql.m_operationType){
-      bitmapIndexManager.insert(sql.m_attributes);
-      std::cout << "Insert success.";
-    }
-    else if (Token::UPDATE == sql.m_operationType) {
-      uint64_t rowCount { bitmapIndexManager.update(sql.m_conditions, sql.m_attributes) };
-      std::cout << "Update success, " << rowCount << " row(s) affected";
-    }
-    else if (Token::DELETE == sql.m_operationType) {
-      uint64_t rowCount { bitmapIndexManager.remove(sql.m_conditions) };
-      std::cout << "Delete success, " << rowCount << " row(s) affected";
-    }
-    else if (Token::COUNT == sql.m_operationType) {
-      std::cout << "There are total " << bitmapIndexManager.count(sql.m_conditions)
-                << " row(s) counted";
+
+      SQL sql { sqlString, bitmapIndexManager.getSchema() };
+      if (Token::SELECT == sql.m_operationType) {
+        printRecords(bitmapIndexManager.select(sql.m_conditions), bitmapIndexManager.getSchema());
+      }
+      else if (Token::INSERT == sql.m_operationType){
+        bitmapIndexManager.insert(sql.m_attributes);
+        std::cout << "Insert success.";
+      }
+      else if (Token::UPDATE == sql.m_operationType) {
+        uint64_t rowCount { bitmapIndexManager.update(sql.m_conditions, sql.m_attributes) };
+        std::cout << "Update success, " << rowCount << " row(s) affected";
+      }
+      else if (Token::DELETE == sql.m_operationType) {
+        uint64_t rowCount { bitmapIndexManager.remove(sql.m_conditions) };
+        std::cout << "Delete success, " << rowCount << " row(s) affected";
+      }
+      else if (Token::COUNT == sql.m_operationType) {
+        std::cout << "There are total " << bitmapIndexManager.count(sql.m_conditions)
+                  << " row(s) counted";
+      }
+      else std::cout << "Unrecognized command";
+    } catch (const std::exception &error) {
+      std::cout << "Error: " << error.what();
     }
-    else std::cout << "Unrecognized command";
 
+    memoryGovernor.rebalance();
     std::cout << std::endl << std::endl;
   }
 
@@ -1,12 +1,12 @@
 #include "sqlparser.h"
 
-Where::Where() { A(); }
+Where::Where(SQLTokenizer &tokenizer) : m_tokenizer(tokenizer) { A(); }
 
 void Where::A() {
   B();
   while (true) {
-    if (Token::OR not_eq CURRENT_TOKEN) break;
-    yylex();
+    if (Token::OR not_eq this->m_tokenizer.getToken()) break;
+    this->m_tokenizer.next();
     B();
     this->m_conditions.emplace_back(Token::OR);
   }
@@ -15,8 +15,8 @@ void Where::A() {
 void Where::B() {
   C();
   while (true) {
-    if (Token::AND not_eq CURRENT_TOKEN) break;
-    yylex();
+    if (Token::AND not_eq this->m_tokenizer.getToken()) break;
+    this->m_tokenizer.next();
     C();
     this->m_conditions.emplace_back(Token::AND);
   }
@@ -25,88 +25,116 @@ void Where::B() {
 void Where::C() {
   SubConditionType condition;
 
-  switch (CURRENT_TOKEN) {
-  case Token::LEFT: yylex(); A(); yylex(); break;
+  switch (this->m_tokenizer.getToken()) {
+  case Token::LEFT: this->m_tokenizer.next(); A(); this->m_tokenizer.next(); return;
+  case Token::NOT: this->m_tokenizer.next(); C(); this->m_conditions.emplace_back(Token::NOT); return;
   case Token::ATTRIBUTE_NAME:
-    std::get<0>(condition) = yytext;
-    yylex();
-    std::get<1>(condition) = CURRENT_TOKEN;
-    yylex();
-    if (Token::IS_NULL not_eq CURRENT_TOKEN and Token::IS_NOT_NULL not_eq CURRENT_TOKEN) {
-      std::get<2>(condition) = yytext;
-      yylex();
+    std::get<0>(condition) = this->m_tokenizer.getText();
+    this->m_tokenizer.next();
+    std::get<1>(condition) = this->m_tokenizer.getToken();
+    this->m_tokenizer.next();
+    if (Token::IN == std::get<1>(condition)) return In(std::get<0>(condition));
+    if (Token::BETWEEN == std::get<1>(condition)) return Between(std::get<0>(condition));
+    if (Token::IS_NULL not_eq std::get<1>(condition) and Token::IS_NOT_NULL not_eq std::get<1>(condition)) {
+      std::get<2>(condition) = this->m_tokenizer.getText();
+      this->m_tokenizer.next();
     }
     break;
   case Token::VALUE:
-    std::get<2>(condition) = yytext;
-    yylex();
-    std::get<1>(condition) = CURRENT_TOKEN;
-    yylex();
-    std::get<0>(condition) = yytext;
-    yylex();
+  case Token::PARAMETER:
+    std::get<2>(condition) = this->m_tokenizer.getText();
+    this->m_tokenizer.next();
+    std::get<1>(condition) = this->m_tokenizer.getToken();
+    this->m_tokenizer.next();
+    std::get<0>(condition) = this->m_tokenizer.getText();
+    this->m_tokenizer.next();
     break;
   default: return;
   }
 
-  this->m_conditions.emplace_back(condition);
+  this->m_conditions.emplace_back(std::move(condition));
 }
 
-Attributes::Attributes() { A(); }
+void Where::In(const std::string &attributeName) {
+  // attr in (v1, v2, ...) is attr = v1 or attr = v2 or ..., the commas are skipped by the tokenizer
+  this->m_tokenizer.next();
+  size_t valueCount { 0 };
+  while (Token::VALUE == this->m_tokenizer.getToken() or Token::PARAMETER == this->m_tokenizer.getToken()) {
+    this->m_conditions.emplace_back(SubConditionType { attributeName, Token::EQUAL, this->m_tokenizer.getText() });
+    if (1 < ++valueCount) this->m_conditions.emplace_back(Token::OR);
+    this->m_tokenizer.next();
+  }
+  if (0 == valueCount) throw std::runtime_error("empty in list of " + attributeName);
+  this->m_tokenizer.next();
+}
+
+void Where::Between(const std::string &attributeName) {
+  // attr between a and b is attr >= a and attr <= b
+  this->m_conditions.emplace_back(
+      SubConditionType { attributeName, Token::GREATER_THAN_OR_EQUAL_TO, this->m_tokenizer.getText() });
+  this->m_tokenizer.next();
+  this->m_tokenizer.next();
+  this->m_conditions.emplace_back(
+      SubConditionType { attributeName, Token::LESS_THAN_OR_EQUAL_TO, this->m_tokenizer.getText() });
+  this->m_tokenizer.next();
+  this->m_conditions.emplace_back(Token::AND);
+}
+
+Attributes::Attributes(SQLTokenizer &tokenizer, const TableSchema &schema)
+    : m_tokenizer(tokenizer), m_schema(schema) { A(); }
 
 void Attributes::A() {
   std::string attributeName;
-  ValueType value;
+  std::string_view value;
 
   while (true) {
-    switch (CURRENT_TOKEN) {
+    switch (this->m_tokenizer.getToken()) {
     case Token::ATTRIBUTE_NAME:
-      attributeName = yytext;
-      yylex();
-      yylex();
-      value = yytext;
+      attributeName = this->m_tokenizer.getText();
+      this->m_tokenizer.next();
+      this->m_tokenizer.next();
+      value = this->m_tokenizer.getText();
       break;
     case Token::VALUE:
-      value = yytext;
-      yylex();
-      yylex();
-      attributeName = yytext;
+      value = this->m_tokenizer.getText();
+      this->m_tokenizer.next();
+      this->m_tokenizer.next();
+      attributeName = this->m_tokenizer.getText();
       break;
     default: return;
     }
 
-    yylex();
-    this->m_attributes.emplace_back(attributeName, value);
+    this->m_tokenizer.next();
+    // The value is typed once here, the index and the record use it as it is
+    const ColumnSchema &column { this->m_schema.getColumn(this->m_schema.getColumnID(attributeName)) };
+    ValueType typedValue { column.m_attribute.parse(value) };
+    this->m_attributes.emplace_back(std::move(attributeName), std::move(typedValue));
   }
 }
 
-SQL::SQL(const std::string &sql) {
-  yy_scan_string(sql.c_str());
-  yylex();
-  this->m_operationType = CURRENT_TOKEN;
-  switch (CURRENT_TOKEN) {
-  case Token::SELECT: yylex(); getConditions(); break;
-  case Token::INSERT: yylex(); getAttributes(); break;
-  case Token::DELETE: yylex(); getConditions(); break;
-  case Token::UPDATE: yylex(); getAttributes(); yylex(); getConditions(); break;
-  case Token::COUNT: yylex(); getConditions(); break;
+SQL::SQL(std::string_view sql, const TableSchema &schema) {
+  SQLTokenizer tokenizer { sql, schema };
+  tokenizer.next();
+  this->m_operationType = tokenizer.getToken();
+  switch (tokenizer.getToken()) {
+  case Token::SELECT: tokenizer.next(); getConditions(tokenizer); break;
+  case Token::INSERT: tokenizer.next(); getAttributes(tokenizer, schema); break;
+  case Token::DELETE: tokenizer.next(); getConditions(tokenizer); break;
+  case Token::UPDATE:
+    tokenizer.next();
+    getAttributes(tokenizer, schema);
+    tokenizer.next();
+    getConditions(tokenizer);
+    break;
+  case Token::COUNT: tokenizer.next(); getConditions(tokenizer); break;
   default: break;
   }
+}
 
-  // Special cases for age
-  for (auto &[attributeName, value] : this->m_attributes) {
-    if ("age" == attributeName && 3 > value.length()) {
-      value = std::string(3 - value.length(), '0') + value;
-    }
-  }
-  for (auto &condition : this->m_conditions) {
-    if (1 == condition.index()) {
-      auto &[attributeName, comparator, value] { std::get<1>(condition) };
-      if ("age" == attributeName and 3 > value.length()){
-        value = std::string(3 - value.length(), '0') + value;
-      }
-    }
-  }
+void SQL::getConditions(SQLTokenizer &tokenizer) {
+  this->m_conditions = std::move(Where { tokenizer }.m_conditions);
 }
 
-void SQL::getConditions() { this->m_conditions = Where{}.m_conditions; }
-void SQL::getAttributes() { this->m_attributes = Attributes{}.m_attributes; }
+void SQL::getAttributes(SQLTokenizer &tokenizer, const TableSchema &schema) {
+  this->m_attributes = std::move(Attributes { tokenizer, schema }.m_attributes);
+}
@@ -0,0 +1,102 @@
+#include "sqltokenizer.h"
+
+namespace {
+
+bool equalsIgnoreCase(std::string_view text, std::string_view keyword) {
+  return text.size() == keyword.size() and
+         std::equal(text.begin(), text.end(), keyword.begin(), [](char lhs, char rhs) {
+           return std::tolower(static_cast<unsigned char>(lhs)) == std::tolower(static_cast<unsigned char>(rhs));
+         });
+}
+
+constexpr std::pair<std::string_view, Token> WORDS[] {
+  { "select", Token::SELECT }, { "insert", Token::INSERT }, { "delete", Token::DELETE },
+  { "update", Token::UPDATE }, { "where", Token::WHERE }, { "count", Token::COUNT },
+  { "and", Token::AND }, { "or", Token::OR }, { "not", Token::NOT },
+  { "in", Token::IN }, { "between", Token::BETWEEN }, { "like", Token::LIKE },
+};
+
+/** % is part of a word so that a LIKE pattern is read as one value */
+bool isWordCharacter(char c) { return std::isalnum(static_cast<unsigned char>(c)) or '%' == c; }
+
+}
+
+void SQLTokenizer::next() {
+  // Keywords and attribute names are case insensitive and must be whole words, so a word is read as a whole
+  // before it is classified. Characters that cannot start a token are skipped like whitespace.
+  while (this->m_position < this->m_sql.size()) {
+    size_t start { this->m_position };
+    char c { this->m_sql[start] };
+
+    if (isWordCharacter(c)) {
+      size_t end { start };
+      while (end < this->m_sql.size() and isWordCharacter(this->m_sql[end])) ++end;
+      this->m_position = end;
+      std::string_view word { this->m_sql.substr(start, end - start) };
+      this->m_token = isColumnName_helper(word) ? Token::ATTRIBUTE_NAME : Token::VALUE;
+      for (const auto &[text, token] : WORDS) {
+        if (equalsIgnoreCase(word, text)) {
+          this->m_token = token;
+          break;
+        }
+      }
+
+      // "is null" and "is not null" are single tokens, they win over the word "is" even if a word follows
+      if (equalsIgnoreCase(word, "is")) {
+        if (matchKeyword_helper(" not null")) {
+          this->m_token = Token::IS_NOT_NULL;
+          this->m_position += std::string_view { " not null" }.size();
+        } else if (matchKeyword_helper(" null")) {
+          this->m_token = Token::IS_NULL;
+          this->m_position += std::string_view { " null" }.size();
+        }
+      }
+      this->m_text = this->m_sql.substr(start, this->m_position - start);
+      return;
+    }
+
+    bool isFollowedByEqual { start + 1 < this->m_sql.size() and '=' == this->m_sql[start + 1] };
+    size_t length { 1 };
+    switch (c) {
+    case '(': this->m_token = Token::LEFT; break;
+    case ')': this->m_token = Token::RIGHT; break;
+    case '=': this->m_token = Token::EQUAL; break;
+    case '?': this->m_token = Token::PARAMETER; break;
+    case '!':
+      if (not isFollowedByEqual) {
+        ++this->m_position;
+        continue;
+      }
+      this->m_token = Token::NOT_EQUAL;
+      length = 2;
+      break;
+    case '>':
+      this->m_token = isFollowedByEqual ? Token::GREATER_THAN_OR_EQUAL_TO : Token::GREATER_THAN;
+      length = isFollowedByEqual ? 2 : 1;
+      break;
+    case '<':
+      this->m_token = isFollowedByEqual ? Token::LESS_THAN_OR_EQUAL_TO : Token::LESS_THAN;
+      length = isFollowedByEqual ? 2 : 1;
+      break;
+    default: ++this->m_position; continue;
+    }
+
+    this->m_position += length;
+    this->m_text = this->m_sql.substr(start, length);
+    return;
+  }
+
+  this->m_token = Token::EOL;
+  this->m_text = {};
+}
+
+bool SQLTokenizer::matchKeyword_helper(std::string_view keyword) const {
+  return equalsIgnoreCase(this->m_sql.substr(this->m_position, keyword.size()), keyword);
+}
+
+bool SQLTokenizer::isColumnName_helper(std::string_view word) const {
+  for (ColumnIDType columnID { 0 }; columnID < this->m_schema.getColumnCount(); ++columnID) {
+    if (equalsIgnoreCase(word, this->m_schema.getColumn(columnID).m_name)) return true;
+  }
+  return false;
+}
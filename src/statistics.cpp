@@ -0,0 +1,50 @@
+#include "statistics.h"
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency) {
+  uint64_t nanoseconds { static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0)) };
+  // The bucket is the position of the highest set bit
+  size_t bucket { nanoseconds ? static_cast<size_t>(63 - __builtin_clzll(nanoseconds)) : 0 };
+  bucket = std::min(bucket, BUCKET_COUNT - 1);
+
+  this->m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  this->m_totalLatency.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getCount() const {
+  uint64_t count { 0 };
+  for (const auto &bucket : this->m_buckets) count += bucket.load(std::memory_order_relaxed);
+  return count;
+}
+
+uint64_t LatencyHistogram::getBucketCount(size_t bucket) const {
+  return this->m_buckets[bucket].load(std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds LatencyHistogram::getBucketUpperBound(size_t bucket) {
+  return std::chrono::nanoseconds { 1LL << (bucket + 1) };
+}
+
+std::chrono::nanoseconds LatencyHistogram::getMean() const {
+  uint64_t count { getCount() };
+  if (0 == count) return std::chrono::nanoseconds { 0 };
+  return std::chrono::nanoseconds { this->m_totalLatency.load(std::memory_order_relaxed) / count };
+}
+
+std::chrono::nanoseconds LatencyHistogram::getPercentile(double percentile) const {
+  uint64_t count { getCount() };
+  if (0 == count) return std::chrono::nanoseconds { 0 };
+
+  // Walk the buckets until the rank of the percentile is reached
+  uint64_t rank { static_cast<uint64_t>(std::ceil(percentile / 100 * count)) };
+  uint64_t seen { 0 };
+  for (size_t bucket { 0 }; bucket < BUCKET_COUNT; ++bucket) {
+    seen += getBucketCount(bucket);
+    if (seen >= rank and 0 not_eq seen) return getBucketUpperBound(bucket);
+  }
+  return getBucketUpperBound(BUCKET_COUNT - 1);
+}
+
+void LatencyHistogram::reset() {
+  for (auto &bucket : this->m_buckets) bucket.store(0, std::memory_order_relaxed);
+  this->m_totalLatency.store(0, std::memory_order_relaxed);
+}
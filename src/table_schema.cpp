@@ -0,0 +1,144 @@
+#include "table_schema.h"
+
+TableSchema::TableSchema(std::vector<std::pair<std::string, AttributeSchema>> columns) {
+  if (std::numeric_limits<ColumnIDType>::max() < columns.size()) throw std::runtime_error("too many columns");
+
+  // The null bits come first, every column follows the previous one
+  this->m_rowSize = (columns.size() + 7) / 8;
+  for (auto &[name, attribute] : columns) {
+    ColumnSchema column { std::move(name), std::move(attribute) };
+    switch (column.m_attribute.m_kind) {
+    case AttributeKind::INTEGER: column.m_width = sizeof(int64_t); break;
+    case AttributeKind::ENUM:
+      if (std::numeric_limits<uint8_t>::max() < column.m_attribute.m_enumerators.size()) {
+        throw std::runtime_error("too many enumerators in column " + column.m_name);
+      }
+      column.m_width = sizeof(uint8_t);
+      break;
+    case AttributeKind::STRING:
+      if (0 == column.m_attribute.m_length) throw std::runtime_error("unbounded string column " + column.m_name);
+      column.m_width = column.m_attribute.m_length;
+      break;
+    }
+    column.m_offset = this->m_rowSize;
+    this->m_rowSize += column.m_width;
+
+    if (not this->m_columnIDs.try_emplace(column.m_name, this->m_columns.size()).second) {
+      throw std::runtime_error("duplicate column " + column.m_name);
+    }
+    this->m_columns.emplace_back(std::move(column));
+  }
+  if (MAX_ROW_SIZE < this->m_rowSize) throw std::runtime_error("row too long");
+}
+
+size_t TableSchema::getColumnCount() const { return this->m_columns.size(); }
+
+const ColumnSchema &TableSchema::getColumn(ColumnIDType columnID) const { return this->m_columns[columnID]; }
+
+ColumnIDType TableSchema::getColumnID(std::string_view columnName) const {
+  auto columnIDIter { this->m_columnIDs.find(columnName) };
+  if (end(this->m_columnIDs) == columnIDIter) throw std::runtime_error("unknown column " + std::string { columnName });
+  return columnIDIter->second;
+}
+
+size_t TableSchema::getRowSize() const { return this->m_rowSize; }
+
+RecordIDType TableSchema::getRowsPerPage() const { return PAGE_SIZE / this->m_rowSize; }
+
+void TableSchema::clearRow(ByteType *row) const { std::memset(row, 0, this->m_rowSize); }
+
+void TableSchema::writeValue(ByteType *row, ColumnIDType columnID, const ValueType &value) const {
+  const ColumnSchema &column { this->m_columns[columnID] };
+  ByteType *field { row + column.m_offset };
+  switch (column.m_attribute.m_kind) {
+  case AttributeKind::INTEGER: {
+    int64_t number { std::get<int64_t>(value) };
+    std::memcpy(field, &number, sizeof(number));
+    break;
+  }
+  case AttributeKind::ENUM: *field = static_cast<ByteType>(std::get<int64_t>(value)); break;
+  case AttributeKind::STRING: {
+    const std::string &text { std::get<std::string>(value) };
+    size_t length { std::min<size_t>(text.size(), column.m_width) };
+    std::memcpy(field, text.data(), length);
+    std::memset(field + length, 0, column.m_width - length);
+    break;
+  }
+  }
+  row[columnID / 8] |= static_cast<ByteType>(1 << columnID % 8);
+}
+
+std::optional<ValueType> TableSchema::readValue(const ByteType *row, ColumnIDType columnID) const {
+  if (not (row[columnID / 8] & 1 << columnID % 8)) return std::nullopt;
+
+  const ColumnSchema &column { this->m_columns[columnID] };
+  const ByteType *field { row + column.m_offset };
+  switch (column.m_attribute.m_kind) {
+  case AttributeKind::INTEGER: {
+    int64_t number;
+    std::memcpy(&number, field, sizeof(number));
+    return number;
+  }
+  case AttributeKind::ENUM: return static_cast<int64_t>(static_cast<uint8_t>(*field));
+  default: return std::string { field, strnlen(field, column.m_width) };
+  }
+}
+
+void TableSchema::write(std::ostream &out) const {
+  out << this->m_columns.size() << " ";
+  for (const auto &column : this->m_columns) {
+    const AttributeSchema &attribute { column.m_attribute };
+    out << column.m_name << " " << static_cast<int>(attribute.m_kind) << " " << attribute.m_length << " "
+        << attribute.m_enumerators.size() << " ";
+    for (const auto &enumerator : attribute.m_enumerators) out << enumerator << " ";
+  }
+}
+
+TableSchema TableSchema::read(std::istream &in) {
+  size_t columnCount;
+  in >> columnCount;
+  std::vector<std::pair<std::string, AttributeSchema>> columns(columnCount);
+  for (auto &[name, attribute] : columns) {
+    int kind;
+    size_t enumeratorCount;
+    in >> name >> kind >> attribute.m_length >> enumeratorCount;
+    attribute.m_kind = static_cast<AttributeKind>(kind);
+    attribute.m_enumerators.resize(enumeratorCount);
+    for (auto &enumerator : attribute.m_enumerators) in >> enumerator;
+  }
+  if (not in) throw std::runtime_error("table schema is truncated");
+  return TableSchema { std::move(columns) };
+}
+
+bool TableSchema::operator==(const TableSchema &other) const { return this->m_columns == other.m_columns; }
+
+const TableSchema &TableSchema::getStudentSchema() {
+  static const TableSchema studentSchema { {
+    { "name", { AttributeKind::STRING, {}, 20 } },
+    { "age", { AttributeKind::INTEGER } },
+    { "gender", { AttributeKind::ENUM, { "male", "female" } } },
+    { "department", { AttributeKind::ENUM, { "ComputerScience", "Physics", "Chemistry", "ForeignLanguage" } } },
+  } };
+  return studentSchema;
+}
+
+Row::Row(const TableSchema &schema, const ByteType *data) : m_schema { &schema } {
+  std::memcpy(this->m_data.data(), data, schema.getRowSize());
+}
+
+std::optional<ValueType> Row::getValue(ColumnIDType columnID) const {
+  return this->m_schema->readValue(this->m_data.data(), columnID);
+}
+
+std::optional<ValueType> Row::getValue(std::string_view columnName) const {
+  return getValue(this->m_schema->getColumnID(columnName));
+}
+
+std::string Row::getText(ColumnIDType columnID) const {
+  std::optional<ValueType> value { getValue(columnID) };
+  return value ? this->m_schema->getColumn(columnID).m_attribute.format(*value) : "NULL";
+}
+
+std::string Row::getText(std::string_view columnName) const { return getText(this->m_schema->getColumnID(columnName)); }
+
+const TableSchema &Row::getSchema() const { return *this->m_schema; }
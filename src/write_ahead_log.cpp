@@ -0,0 +1,354 @@
+#include "write_ahead_log.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+// A log starts with its header, which names the version of the record format.
+// A record is laid out as: payload size, checksum of the payload, then the payload of
+// lsn, operation, runs of consecutive record ids as (first id, length), and the attributes.
+// A typed value is its alternative index followed by the value.
+using RecordSizeType = uint32_t;
+constexpr size_t RECORD_HEADER_SIZE = sizeof(RecordSizeType) + sizeof(uint32_t);
+
+template <typename T>
+void encode(std::vector<ByteType> &out, T value) {
+  const ByteType *raw = reinterpret_cast<const ByteType *>(&value);
+  out.insert(out.end(), raw, raw + sizeof(T));
+}
+
+void encode(std::vector<ByteType> &out, const std::string &value) {
+  encode<uint32_t>(out, value.size());
+  out.insert(out.end(), value.begin(), value.end());
+}
+
+void encode(std::vector<ByteType> &out, const ValueType &value) {
+  encode<uint8_t>(out, value.index());
+  std::visit([&out](const auto &alternative) { encode(out, alternative); }, value);
+}
+
+template <typename T>
+bool decode(const std::vector<ByteType> &data, size_t &offset, size_t end, T &value) {
+  if (end - offset < sizeof(T)) {
+    return false;
+  }
+  memcpy(&value, data.data() + offset, sizeof(T));
+  offset += sizeof(T);
+  return true;
+}
+
+bool decode(const std::vector<ByteType> &data, size_t &offset, size_t end, std::string &value) {
+  uint32_t size;
+  if (!decode(data, offset, end, size) || end - offset < size) {
+    return false;
+  }
+  value.assign(data.data() + offset, size);
+  offset += size;
+  return true;
+}
+
+bool decode(const std::vector<ByteType> &data, size_t &offset, size_t end, ValueType &value) {
+  uint8_t index;
+  if (!decode(data, offset, end, index)) {
+    return false;
+  }
+  if (index == 0) {
+    int64_t number;
+    if (!decode(data, offset, end, number)) {
+      return false;
+    }
+    value = number;
+    return true;
+  }
+  std::string text;
+  if (index != 1 || !decode(data, offset, end, text)) {
+    return false;
+  }
+  value = std::move(text);
+  return true;
+}
+
+}
+
+WriteAheadLog::WriteAheadLog(const std::string &fileName, std::chrono::microseconds groupCommitWindow)
+    : m_fileName(fileName), m_groupCommitWindow(groupCommitWindow) {
+  std::error_code error;
+  uintmax_t fileSize = std::filesystem::file_size(fileName, error);
+  reopen_helper(error ? 0 : fileSize);
+}
+
+WriteAheadLog::~WriteAheadLog() {
+  if (m_file != nullptr) {
+    std::fclose(m_file);
+  }
+}
+
+uint64_t WriteAheadLog::replay(LSNType checkpointLSN, const std::function<void(const LogRecord &)> &redo) {
+  std::lock_guard<std::mutex> lck(m_logLatch);
+
+  std::vector<ByteType> data;
+  {
+    std::ifstream fin(m_fileName, std::ios::binary);
+    data.assign(std::istreambuf_iterator<ByteType>(fin), std::istreambuf_iterator<ByteType>());
+  }
+
+  // A log of another version is not replayed, its records would be misread
+  std::string_view text { data.data(), data.size() };
+  if (LOG_HEADER.starts_with(text)) {
+    // a new log, or one whose header did not reach the disk
+    writeHeader_helper();
+    data.assign(LOG_HEADER.begin(), LOG_HEADER.end());
+  } else if (not text.starts_with(LOG_HEADER)) {
+    size_t headerSize { std::min(text.find('\n'), LOG_HEADER.size()) };
+    if (text.starts_with(LOG_HEADER_PREFIX)) {
+      throw std::runtime_error("unsupported write-ahead log version: " + std::string { text.substr(0, headerSize) });
+    }
+    throw std::runtime_error("write-ahead log has no version header");
+  }
+
+  // records up to the checkpoint survive a truncation that did not reach the disk, they are skipped
+  uint64_t redoCount = 0;
+  LSNType lastLSN = checkpointLSN;
+  size_t offset = LOG_HEADER.size();
+  LogRecord record;
+  while (decodeRecord_helper(data, offset, record)) {
+    if (record.m_lsn > lastLSN) {
+      redo(record);
+      lastLSN = record.m_lsn;
+      ++redoCount;
+    }
+  }
+
+  // a crash while writing a group leaves a torn record, what follows it was never committed
+  if (offset < data.size()) {
+    reopen_helper(offset);
+  }
+  m_fileSize = offset;
+  m_nextLSN = lastLSN + 1;
+  m_durableLSN = lastLSN;
+  return redoCount;
+}
+
+LSNType WriteAheadLog::append(LogOperation operation, const std::vector<RecordIDType> &recordIDs,
+                              const AttributeType &attributes) {
+  std::vector<ByteType> payload;
+  std::lock_guard<std::mutex> lck(m_logLatch);
+  LSNType lsn = m_nextLSN++;
+  encode(payload, lsn);
+  encode(payload, operation);
+
+  // record ids come from bitmaps in ascending order, so consecutive ones are stored as runs
+  std::vector<std::pair<RecordIDType, uint64_t>> runs;
+  for (RecordIDType recordID : recordIDs) {
+    if (!runs.empty() && runs.back().first + runs.back().second == recordID) {
+      ++runs.back().second;
+    } else {
+      runs.emplace_back(recordID, 1);
+    }
+  }
+  encode<uint64_t>(payload, runs.size());
+  for (const auto &[firstRecordID, length] : runs) {
+    encode(payload, firstRecordID);
+    encode(payload, length);
+  }
+
+  encode<uint32_t>(payload, attributes.size());
+  for (const auto &[attributeName, value] : attributes) {
+    encode(payload, attributeName);
+    encode(payload, value);
+  }
+
+  encode<RecordSizeType>(m_buffer, payload.size());
+  encode(m_buffer, checksum_helper(payload.data(), payload.size()));
+  m_buffer.insert(m_buffer.end(), payload.begin(), payload.end());
+
+  // a leader waiting for its group to fill up does not wait any longer
+  if (m_isSyncing && m_buffer.size() >= MAX_GROUP_BYTES) {
+    m_logCondition.notify_all();
+  }
+  return lsn;
+}
+
+void WriteAheadLog::commit(LSNType lsn) {
+  std::unique_lock<std::mutex> lck(m_logLatch);
+  sync_helper(lck, lsn, m_groupCommitWindow);
+}
+
+void WriteAheadLog::flush(LSNType lsn) {
+  std::unique_lock<std::mutex> lck(m_logLatch);
+  sync_helper(lck, lsn, std::chrono::microseconds { 0 });
+}
+
+void WriteAheadLog::truncate() {
+  std::lock_guard<std::mutex> lck(m_logLatch);
+  if (!m_buffer.empty() || m_isSyncing) {
+    throw std::runtime_error("write-ahead log truncated before it is durable");
+  }
+  writeHeader_helper();
+}
+
+LSNType WriteAheadLog::getLastLSN() {
+  std::lock_guard<std::mutex> lck(m_logLatch);
+  return m_nextLSN - 1;
+}
+
+uint64_t WriteAheadLog::getSize() {
+  std::lock_guard<std::mutex> lck(m_logLatch);
+  return m_fileSize - LOG_HEADER.size() + m_buffer.size();
+}
+
+uint64_t WriteAheadLog::getSyncCount() {
+  std::lock_guard<std::mutex> lck(m_logLatch);
+  return m_syncCount;
+}
+
+void WriteAheadLog::sync_helper(std::unique_lock<std::mutex> &lck, LSNType lsn,
+                                std::chrono::microseconds groupCommitWindow) {
+  // 1.   If another thread is writing a group, wait for it, the record may be part of that group.
+  // 2.   Otherwise become the leader of the next group. Wait up to the window so that concurrent commits
+  //      append to the group, a full group is written at once.
+  // 3.   Write and sync the group without holding the latch, records appended meanwhile go to a new buffer.
+  // 4.   Wake up the members of the group.
+  lsn = std::min(lsn, m_nextLSN - 1);
+  while (m_durableLSN < lsn) {
+    if (m_isSyncing) {
+      m_logCondition.wait(lck);
+      continue;
+    }
+
+    m_isSyncing = true;
+    if (groupCommitWindow.count() > 0) {
+      m_logCondition.wait_for(lck, groupCommitWindow, [&] { return m_buffer.size() >= MAX_GROUP_BYTES; });
+    }
+
+    std::vector<ByteType> group;
+    group.swap(m_buffer);
+    LSNType groupLSN = m_nextLSN - 1;
+    lck.unlock();
+    std::exception_ptr error;
+    try {
+      writeGroup_helper(group);
+    } catch (const std::exception &) {
+      error = std::current_exception();
+    }
+    lck.lock();
+
+    m_isSyncing = false;
+    m_logCondition.notify_all();
+    if (error) {
+      // cut off what was written of the group, the next leader writes it again
+      m_buffer.insert(m_buffer.begin(), group.begin(), group.end());
+      try {
+        reopen_helper(m_fileSize);
+      } catch (const std::exception &) {
+        // the torn group is dropped by the replay
+      }
+      std::rethrow_exception(error);
+    }
+    m_fileSize += group.size();
+    m_durableLSN = groupLSN;
+    ++m_syncCount;
+  }
+}
+
+void WriteAheadLog::writeGroup_helper(const std::vector<ByteType> &group) {
+  if (std::fwrite(group.data(), 1, group.size(), m_file) != group.size()) {
+    throw std::runtime_error("IO error while writing write-ahead log");
+  }
+
+#ifdef _WIN32
+  int result = _commit(_fileno(m_file));
+#else
+  int result = fsync(fileno(m_file));
+#endif
+  if (result != 0) {
+    throw std::runtime_error("IO error while syncing write-ahead log");
+  }
+}
+
+void WriteAheadLog::writeHeader_helper() {
+  reopen_helper(0);
+  writeGroup_helper(std::vector<ByteType>(LOG_HEADER.begin(), LOG_HEADER.end()));
+  m_fileSize = LOG_HEADER.size();
+}
+
+void WriteAheadLog::reopen_helper(uint64_t fileSize) {
+  if (m_file != nullptr) {
+    std::fclose(m_file);
+    m_file = nullptr;
+  }
+
+  // the file is created empty if it does not exist
+  m_file = std::fopen(m_fileName.c_str(), "ab");
+  if (m_file == nullptr) {
+    throw std::runtime_error("fail to open write-ahead log");
+  }
+  // groups are written whole, a buffer would only copy them once more
+  std::setvbuf(m_file, nullptr, _IONBF, 0);
+
+  std::error_code error;
+  std::filesystem::resize_file(m_fileName, fileSize, error);
+  if (error) {
+    throw std::runtime_error("fail to truncate write-ahead log");
+  }
+}
+
+bool WriteAheadLog::decodeRecord_helper(const std::vector<ByteType> &data, size_t &offset, LogRecord &record) {
+  // a record is decoded as a whole, offset only moves past complete and intact records
+  size_t position = offset;
+  RecordSizeType payloadSize;
+  uint32_t checksum;
+  if (!decode(data, position, data.size(), payloadSize) || !decode(data, position, data.size(), checksum) ||
+      data.size() - position < payloadSize || checksum_helper(data.data() + position, payloadSize) != checksum) {
+    return false;
+  }
+
+  size_t end = position + payloadSize;
+  uint64_t runCount;
+  uint32_t attributeCount;
+  if (!decode(data, position, end, record.m_lsn) || !decode(data, position, end, record.m_operation) ||
+      !decode(data, position, end, runCount)) {
+    return false;
+  }
+
+  record.m_recordIDs.clear();
+  for (uint64_t i = 0; i < runCount; ++i) {
+    RecordIDType firstRecordID;
+    uint64_t length;
+    if (!decode(data, position, end, firstRecordID) || !decode(data, position, end, length)) {
+      return false;
+    }
+    for (uint64_t j = 0; j < length; ++j) {
+      record.m_recordIDs.emplace_back(firstRecordID + j);
+    }
+  }
+
+  if (!decode(data, position, end, attributeCount)) {
+    return false;
+  }
+  record.m_attributes.clear();
+  for (uint32_t i = 0; i < attributeCount; ++i) {
+    std::string attributeName;
+    ValueType value;
+    if (!decode(data, position, end, attributeName) || !decode(data, position, end, value)) {
+      return false;
+    }
+    record.m_attributes.emplace_back(std::move(attributeName), std::move(value));
+  }
+
+  offset = end;
+  return true;
+}
+
+uint32_t WriteAheadLog::checksum_helper(const ByteType *data, size_t size) {
+  // FNV-1a, enough to tell a torn record from a complete one
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+  }
+  return hash;
+}
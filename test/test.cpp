@@ -1,5 +1,6 @@
 #include "gtest/gtest.h"
 #include "bitmap_index_manager.h"
+#include "plan_cache.h"
 #include "sqlparser.h"
 
 class BitmapIndexTest : public testing::Test {
@@ -21,11 +22,11 @@ TEST_F(BitmapIndexTest, InsertTest) {
 TEST_F(BitmapIndexTest, SelectTest) {
   // Select
   SQL sql2 { "select name=lihua and age=3 and gender=male and department=Chemistry" };
-  Record record { bitmapIndexManager.select(sql2.m_conditions).next() };
-  ASSERT_EQ(strcmp(record.m_name, "lihua"), 0);
-  ASSERT_EQ(record.m_age, 3);
-  ASSERT_EQ(record.m_gender, Gender::MALE);
-  ASSERT_EQ(record.m_department, Department::CHEMISTRY);
+  Row row { bitmapIndexManager.select(sql2.m_conditions).next() };
+  ASSERT_EQ(row.getText("name"), "lihua");
+  ASSERT_EQ(row.getValue("age"), ValueType { 3 });
+  ASSERT_EQ(row.getText("gender"), "male");
+  ASSERT_EQ(row.getText("department"), "Chemistry");
 }
 
 TEST_F(BitmapIndexTest, UpdateTest) {
@@ -33,8 +34,8 @@ TEST_F(BitmapIndexTest, UpdateTest) {
   SQL sql3 { "update name=liuhai where name=lihua" };
   ASSERT_EQ(bitmapIndexManager.update(sql3.m_conditions, sql3.m_attributes), 1);
   SQL sql4 { "select name=liuhai" };
-  Record record2 { bitmapIndexManager.select(sql4.m_conditions).next() };
-  ASSERT_EQ(strcmp(record2.m_name, "liuhai"), 0);
+  Row row2 { bitmapIndexManager.select(sql4.m_conditions).next() };
+  ASSERT_EQ(row2.getText("name"), "liuhai");
 
 }
 
@@ -69,24 +70,17 @@ TEST_F(BitmapIndexTest, LargeIntegratedTest) {
     // Select
     SQL sql2 { "select name=" + name + " gender=" + gender +
             " age=" + age + " department=" + department };
-    Record record { bitmapIndexManager.select(sql2.m_conditions).next() };
-    assert(record.m_name == name);
-    ASSERT_EQ(record.m_age, i % 150);
-    ASSERT_EQ(record.m_gender, i % 2 ? Gender::MALE : Gender::FEMALE);
-    Department testDepartment;
-    switch (i % 4) {
-    case 0: testDepartment = Department::CHEMISTRY; break;
-    case 1: testDepartment = Department::COMPUTER_SCIENCE; break;
-    case 2: testDepartment = Department::PHYSICS; break;
-    case 3: testDepartment = Department::FOREIGN_LANG; break;
-    }
-    ASSERT_EQ(record.m_department, testDepartment);
+    Row row { bitmapIndexManager.select(sql2.m_conditions).next() };
+    assert(row.getText("name") == name);
+    ASSERT_EQ(row.getValue("age"), ValueType { static_cast<int64_t>(i % 150) });
+    ASSERT_EQ(row.getText("gender"), gender);
+    ASSERT_EQ(row.getText("department"), department);
 
     // Update
     SQL sql3 { "update name=" + name + "a where name=" + name };
     ASSERT_EQ(bitmapIndexManager.update(sql3.m_conditions, sql3.m_attributes), 1);
     SQL sql4 { "select name=" + name + "a" };
-    assert(bitmapIndexManager.select(sql4.m_conditions).next().m_name == name + "a");
+    assert(bitmapIndexManager.select(sql4.m_conditions).next().getText("name") == name + "a");
 
     // Count
     ASSERT_EQ(bitmapIndexManager.count(sql4.m_conditions), 1);
@@ -96,3 +90,871 @@ TEST_F(BitmapIndexTest, LargeIntegratedTest) {
   // Delete
   ASSERT_EQ(bitmapIndexManager.remove({}), 10000);
 }
+
+TEST(SQLParserTest, TokenizerTest) {
+  // Keywords are case insensitive whole words, tokens are views into the statement
+  std::string_view statement { "SELECT name1 != Age AND (age >= 7 or x<>y) and gender is nullx" };
+  SQLTokenizer tokenizer { statement };
+  std::vector<Token> tokens;
+  for (tokenizer.next(); Token::EOL not_eq tokenizer.getToken(); tokenizer.next()) {
+    ASSERT_GE(tokenizer.getText().data(), statement.data());
+    ASSERT_LE(tokenizer.getText().data() + tokenizer.getText().size(), statement.data() + statement.size());
+    tokens.push_back(tokenizer.getToken());
+  }
+  std::vector<Token> expected { Token::SELECT, Token::VALUE, Token::NOT_EQUAL, Token::ATTRIBUTE_NAME, Token::AND,
+                                Token::LEFT, Token::ATTRIBUTE_NAME, Token::GREATER_THAN_OR_EQUAL_TO, Token::VALUE,
+                                Token::OR, Token::VALUE, Token::LESS_THAN, Token::GREATER_THAN, Token::VALUE,
+                                Token::RIGHT, Token::AND, Token::ATTRIBUTE_NAME, Token::IS_NULL, Token::VALUE };
+  ASSERT_EQ(tokens, expected);
+
+  // Attribute names are the column names of the schema of the table
+  TableSchema schema { { { "city", { AttributeKind::STRING, {}, 8 } }, { "population", { AttributeKind::INTEGER } } } };
+  SQL citySQL { "select City=paris and population>100 and name=x", schema };
+  ASSERT_EQ(citySQL.m_conditions.size(), 5);
+  ASSERT_EQ(std::get<0>(std::get<SubConditionType>(citySQL.m_conditions[0])), "City");
+  ASSERT_EQ(std::get<0>(std::get<SubConditionType>(citySQL.m_conditions[1])), "population");
+  ASSERT_EQ(std::get<2>(std::get<SubConditionType>(citySQL.m_conditions[3])), "name");
+  ASSERT_THROW((SQL { "insert name=lihua", schema }), std::runtime_error);
+
+  // Statements are parsed concurrently
+  std::vector<std::thread> threads;
+  std::atomic<int> mismatchCount { 0 };
+  for (int i { 0 }; i < 8; ++i) {
+    threads.emplace_back([&mismatchCount, i] {
+      for (int j { 0 }; j < 1000; ++j) {
+        std::string name { "lihua" + std::to_string(i * 1000 + j) };
+        SQL sql { "update name=" + name + " where age=" + std::to_string(i) + " or gender=male" };
+        if (Token::UPDATE not_eq sql.m_operationType or sql.m_attributes.size() not_eq 1 or
+            sql.m_attributes[0].second not_eq ValueType { name } or sql.m_conditions.size() not_eq 3) {
+          ++mismatchCount;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) thread.join();
+  ASSERT_EQ(mismatchCount, 0);
+}
+
+/**
+ * TableFileTest names the table of every test after the test and removes the files of the table before and after
+ * the test, so that no test starts from or leaves behind the files of another run.
+ */
+class TableFileTest : public testing::Test {
+public:
+  void SetUp() override { removeFiles(); }
+
+  void TearDown() override { removeFiles(); }
+
+protected:
+  std::string tableName { testing::UnitTest::GetInstance()->current_test_info()->name() };
+
+private:
+  /** Remove the table, its index, its catalog and whatever the catalog keeps next to it */
+  void removeFiles() {
+    std::vector<std::filesystem::path> fileNames;
+    for (const auto &entry : std::filesystem::directory_iterator { "." }) {
+      if (entry.path().filename().string().starts_with(tableName + ".")) fileNames.push_back(entry.path());
+    }
+    for (const auto &fileName : fileNames) std::filesystem::remove(fileName);
+  }
+};
+
+class BufferPoolManagerTest : public TableFileTest {};
+
+class FileStoreTest : public TableFileTest {};
+
+TEST_F(BufferPoolManagerTest, PrefetchTest) {
+  FileStore fileStore { tableName, true };
+  BufferPoolManager bufferPoolManager { 8, &fileStore };
+
+  // The dirty pages evicted to make room are written behind, several of them at once
+  for (PageIDType pageID { 0 }; pageID < 32; ++pageID) {
+    Page *page { bufferPoolManager.appendNewPage(FileType::TABLE, pageID) };
+    page->getData()[0] = static_cast<ByteType>(pageID);
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, true);
+  }
+  ASSERT_EQ(bufferPoolManager.getStatistics().m_dirtyWritebacks, 24);
+
+  // Most of the pages have been evicted, prefetch them back before fetching, each after its write has landed
+  for (PageIDType pageID { 0 }; pageID < 32; ++pageID) {
+    ASSERT_TRUE(bufferPoolManager.prefetchPage(FileType::TABLE, pageID));
+    Page *page { bufferPoolManager.fetchPage(FileType::TABLE, pageID) };
+    ASSERT_EQ(page->getData()[0], static_cast<ByteType>(pageID));
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, false);
+  }
+
+  // Pages read ahead and hinted pages are fetched while their reads may still be in flight
+  for (PageIDType pageID { 0 }; pageID < 32; ++pageID) {
+    Page *page { bufferPoolManager.fetchPage(FileType::TABLE, pageID) };
+    ASSERT_EQ(page->getData()[0], static_cast<ByteType>(pageID));
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, false);
+  }
+  bufferPoolManager.prefetchPages(FileType::TABLE, { 4, 5 });
+  for (PageIDType pageID { 4 }; pageID < 6; ++pageID) {
+    Page *page { bufferPoolManager.fetchPage(FileType::TABLE, pageID) };
+    ASSERT_EQ(page->getData()[0], static_cast<ByteType>(pageID));
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, false);
+  }
+}
+
+TEST_F(BufferPoolManagerTest, FetchPagesTest) {
+  FileStore fileStore { tableName };
+  BufferPoolManager bufferPoolManager { 16, &fileStore };
+
+  for (PageIDType pageID { 0 }; pageID < 32; ++pageID) {
+    Page *page { bufferPoolManager.appendNewPage(FileType::TABLE, pageID) };
+    page->getData()[0] = static_cast<ByteType>(pageID);
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, true);
+  }
+
+  // Pages 0 to 15 have been evicted and are read back together
+  std::vector<Page *> pages { bufferPoolManager.fetchPages(FileType::TABLE, 4, 8) };
+  ASSERT_EQ(pages.size(), 8);
+  for (PageIDType i { 0 }; i < 8; ++i) {
+    ASSERT_EQ(pages[i]->getPageID(), 4 + i);
+    ASSERT_EQ(pages[i]->getData()[0], static_cast<ByteType>(4 + i));
+    bufferPoolManager.unpinPage(FileType::TABLE, 4 + i, false);
+  }
+
+  // Sequential fetches trigger readahead, the contents must be the same
+  for (PageIDType pageID { 0 }; pageID < 32; ++pageID) {
+    Page *page { bufferPoolManager.fetchPage(FileType::TABLE, pageID) };
+    ASSERT_EQ(page->getData()[0], static_cast<ByteType>(pageID));
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, false);
+  }
+}
+
+TEST_F(BufferPoolManagerTest, BackgroundWriterTest) {
+  FileStore fileStore { tableName };
+  BufferPoolManager bufferPoolManager { 8, &fileStore };
+  bufferPoolManager.startBackgroundWriter(std::chrono::milliseconds { 1 });
+
+  Page *page { bufferPoolManager.appendNewPage(FileType::TABLE, 0) };
+  page->getData()[0] = 'x';
+  bufferPoolManager.unpinPage(FileType::TABLE, 0, true);
+
+  // The dirty unpinned page is written back without any eviction or flush
+  for (size_t round { 0 }; round < 1000 and page->isDirty(); ++round) {
+    std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+  }
+  bufferPoolManager.stopBackgroundWriter();
+  ASSERT_FALSE(page->isDirty());
+
+  ByteType raw[PAGE_SIZE];
+  fileStore.readRawPage(FileType::TABLE, 0, raw);
+  ASSERT_EQ(raw[0], 'x');
+}
+
+TEST_F(FileStoreTest, PageCountTest) {
+  std::string fileName { tableName + ".db" };
+  {
+    FileStore fileStore { tableName };
+    BufferPoolManager bufferPoolManager { 8, &fileStore };
+    for (PageIDType pageID { 0 }; pageID < 3; ++pageID) {
+      bufferPoolManager.appendNewPage(FileType::TABLE, pageID);
+      bufferPoolManager.unpinPage(FileType::TABLE, pageID, true);
+    }
+    bufferPoolManager.flushAllPages();
+    ASSERT_GT(std::filesystem::file_size(fileName), 3 * PAGE_SIZE);
+  }
+
+  // The preallocated extent is cut off on close, the file ends after its last page
+  ASSERT_EQ(std::filesystem::file_size(fileName), 3 * PAGE_SIZE);
+  {
+    FileStore fileStore { tableName };
+    ASSERT_EQ(fileStore.getPageCount(FileType::TABLE), 3);
+  }
+
+  // After a crash the owner of the pages knows where they end
+  std::filesystem::resize_file(fileName, 64 * PAGE_SIZE);
+  FileStore crashedFileStore { tableName };
+  ASSERT_EQ(crashedFileStore.getPageCount(FileType::TABLE), 64);
+  crashedFileStore.setPageCount(FileType::TABLE, 3);
+  ASSERT_EQ(crashedFileStore.getPageCount(FileType::TABLE), 3);
+}
+
+TEST_F(FileStoreTest, AsyncIOTest) {
+  FileStore fileStore { tableName, true };
+  FrameArena arena;
+  ByteType *frames { arena.allocateBlock(FileStore::MAX_IN_FLIGHT_REQUESTS) };
+
+  // Writes and reads are in flight together and each completes into its own buffer, in any order
+  std::vector<IORequestIDType> requestIDs;
+  for (PageIDType pageID { 0 }; pageID < FileStore::MAX_IN_FLIGHT_REQUESTS; ++pageID) {
+    frames[pageID * PAGE_SIZE] = static_cast<ByteType>(pageID);
+    fileStore.reservePage(FileType::TABLE, pageID);
+    requestIDs.emplace_back(fileStore.submitWriteRawPage(FileType::TABLE, pageID, frames + pageID * PAGE_SIZE));
+  }
+  for (IORequestIDType requestID : requestIDs) fileStore.waitForRequest(requestID);
+
+  memset(frames, 0, FileStore::MAX_IN_FLIGHT_REQUESTS * PAGE_SIZE);
+  requestIDs.clear();
+  for (PageIDType pageID { 0 }; pageID < FileStore::MAX_IN_FLIGHT_REQUESTS; ++pageID) {
+    requestIDs.emplace_back(fileStore.submitReadRawPage(FileType::TABLE, pageID, frames + pageID * PAGE_SIZE));
+  }
+  for (PageIDType pageID { FileStore::MAX_IN_FLIGHT_REQUESTS }; pageID-- > 0;) {
+    fileStore.waitForRequest(requestIDs[pageID]);
+    ASSERT_EQ(frames[pageID * PAGE_SIZE], static_cast<ByteType>(pageID));
+  }
+
+  // A failed request reports its error once, then it is released
+  IORequestIDType requestID { fileStore.submitReadRawPage(FileType::TABLE, 1000, frames) };
+  ASSERT_THROW(fileStore.waitForRequest(requestID), std::runtime_error);
+  ASSERT_TRUE(fileStore.isRequestComplete(requestID));
+  fileStore.waitForRequest(requestID);
+}
+
+TEST_F(BufferPoolManagerTest, FrameArenaTest) {
+  FileStore fileStore { tableName, false, true };
+  BufferPoolManager bufferPoolManager { 16, &fileStore, false, HugePageMode::TRANSPARENT };
+
+  for (size_t i { 0 }; i < bufferPoolManager.getPoolSize(); ++i) {
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(bufferPoolManager.getPages()[i].getData()) % PAGE_SIZE, 0);
+  }
+
+  // Pages go between the frames and the file past the page cache unchanged
+  for (PageIDType pageID { 0 }; pageID < 32; ++pageID) {
+    Page *page { bufferPoolManager.appendNewPage(FileType::TABLE, pageID) };
+    page->getData()[PAGE_SIZE - 1] = static_cast<ByteType>(pageID);
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, true);
+  }
+  for (PageIDType pageID { 0 }; pageID < 32; ++pageID) {
+    Page *page { bufferPoolManager.fetchPage(FileType::TABLE, pageID) };
+    ASSERT_EQ(page->getData()[PAGE_SIZE - 1], static_cast<ByteType>(pageID));
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, false);
+  }
+
+  // A buffer that is not aligned goes through the staging buffer
+  std::vector<ByteType> raw(PAGE_SIZE + 1);
+  fileStore.readRawPage(FileType::TABLE, 5, raw.data() + 1);
+  ASSERT_EQ(raw[PAGE_SIZE], static_cast<ByteType>(5));
+}
+
+TEST_F(BufferPoolManagerTest, StatisticsTest) {
+  FileStore fileStore { tableName };
+  BufferPoolManager bufferPoolManager { 4, &fileStore };
+
+  for (PageIDType pageID { 0 }; pageID < 8; ++pageID) {
+    bufferPoolManager.appendNewPage(FileType::TABLE, pageID);
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, true);
+  }
+  bufferPoolManager.resetStatistics();
+
+  // Pages 4 to 7 are resident, pages 0 to 3 have been evicted
+  for (PageIDType pageID : { 7, 6, 0, 1 }) {
+    bufferPoolManager.fetchPage(FileType::TABLE, pageID);
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, false);
+  }
+
+  BufferPoolStatistics statistics { bufferPoolManager.getStatistics() };
+  ASSERT_EQ(statistics.m_hits, 2);
+  ASSERT_EQ(statistics.m_misses, 2);
+  ASSERT_EQ(statistics.m_evictions, 2);
+  ASSERT_DOUBLE_EQ(statistics.getHitRatio(), 0.5);
+  ASSERT_GT(fileStore.getReadLatencyHistogram().getCount(), 0);
+}
+
+TEST_F(BufferPoolManagerTest, ConcurrentFetchTest) {
+  FileStore fileStore { tableName };
+  BufferPoolManager bufferPoolManager { 8, &fileStore, true };
+
+  for (PageIDType pageID { 0 }; pageID < 16; ++pageID) {
+    Page *page { bufferPoolManager.appendNewPage(FileType::TABLE, pageID) };
+    page->getData()[0] = static_cast<ByteType>(pageID);
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, true);
+  }
+
+  // Hits and misses race with each other, every thread must see the data of the page it asked for
+  std::atomic<size_t> mismatchCount { 0 };
+  std::vector<std::thread> threads;
+  for (size_t t { 0 }; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      for (size_t i { 0 }; i < 2000; ++i) {
+        PageIDType pageID = (i * (t + 1)) % 16;
+        PageHandle page { bufferPoolManager.fetchPageHandle(FileType::TABLE, pageID) };
+        if (not page or page.getData()[0] not_eq static_cast<ByteType>(pageID)) ++mismatchCount;
+      }
+    });
+  }
+  for (auto &thread : threads) thread.join();
+  ASSERT_EQ(mismatchCount, 0);
+
+  // Handles unpin the page when they go out of scope
+  {
+    PageHandle page { bufferPoolManager.fetchPageHandle(FileType::TABLE, 3) };
+    ASSERT_EQ(page.getPage()->getPinCount(), 1);
+    PageHandle moved { std::move(page) };
+    ASSERT_FALSE(page);
+    ASSERT_EQ(moved.getPage()->getPinCount(), 1);
+  }
+  Page *page { bufferPoolManager.fetchPage(FileType::TABLE, 3) };
+  ASSERT_EQ(page->getPinCount(), 1);
+  bufferPoolManager.unpinPage(FileType::TABLE, 3, false);
+}
+
+TEST_F(BufferPoolManagerTest, ResizeTest) {
+  FileStore fileStore { tableName };
+  BufferPoolManager bufferPoolManager { 4, &fileStore, false, HugePageMode::NONE, 256 };
+
+  // Growing makes room for more resident pages
+  ASSERT_EQ(bufferPoolManager.resize(256), 256);
+  for (PageIDType pageID { 0 }; pageID < 256; ++pageID) {
+    Page *page { bufferPoolManager.appendNewPage(FileType::TABLE, pageID) };
+    ASSERT_NE(page, nullptr);
+    page->getData()[0] = static_cast<ByteType>(pageID);
+    if (pageID not_eq 100) bufferPoolManager.unpinPage(FileType::TABLE, pageID, true);
+  }
+  ASSERT_EQ(bufferPoolManager.getMemoryUsage(), 256 * PAGE_SIZE);
+
+  // Shrinking stops at the pinned page in frame 100, the dirty pages behind it are written back
+  ASSERT_EQ(bufferPoolManager.resize(8), 101);
+  bufferPoolManager.unpinPage(FileType::TABLE, 100, false);
+  ASSERT_EQ(bufferPoolManager.resize(8), 8);
+  ASSERT_LT(bufferPoolManager.getMemoryUsage(), 256 * PAGE_SIZE);
+
+  for (PageIDType pageID { 0 }; pageID < 256; ++pageID) {
+    Page *page { bufferPoolManager.fetchPage(FileType::TABLE, pageID) };
+    ASSERT_EQ(page->getData()[0], static_cast<ByteType>(pageID));
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, false);
+  }
+  ASSERT_EQ(bufferPoolManager.resize(1000), 256);
+}
+
+TEST_F(BufferPoolManagerTest, BufferRingTest) {
+  FileStore fileStore { tableName };
+  BufferPoolManager bufferPoolManager { 64, &fileStore };
+
+  for (PageIDType pageID { 0 }; pageID < 256; ++pageID) {
+    bufferPoolManager.appendNewPage(FileType::TABLE, pageID);
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, true);
+  }
+  bufferPoolManager.flushAllPages();
+
+  // Pages 0 to 7 are hot
+  for (PageIDType pageID { 0 }; pageID < 8; ++pageID) {
+    bufferPoolManager.fetchPage(FileType::TABLE, pageID);
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, false);
+  }
+
+  // A full scan through a ring only recycles the frames of the ring
+  BufferRing ring { 8 };
+  for (PageIDType pageID { 8 }; pageID < 256; ++pageID) {
+    PageHandle page { bufferPoolManager.fetchPageHandle(FileType::TABLE, pageID, &ring) };
+    ASSERT_TRUE(page);
+  }
+  bufferPoolManager.resetStatistics();
+  for (PageIDType pageID { 0 }; pageID < 8; ++pageID) {
+    bufferPoolManager.fetchPage(FileType::TABLE, pageID);
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, false);
+  }
+  ASSERT_EQ(bufferPoolManager.getStatistics().m_misses, 0);
+
+  // Without a ring the same scan pushes the hot pages out
+  for (PageIDType pageID { 8 }; pageID < 256; ++pageID) {
+    PageHandle page { bufferPoolManager.fetchPageHandle(FileType::TABLE, pageID) };
+  }
+  bufferPoolManager.resetStatistics();
+  for (PageIDType pageID { 0 }; pageID < 8; ++pageID) {
+    bufferPoolManager.fetchPage(FileType::TABLE, pageID);
+    bufferPoolManager.unpinPage(FileType::TABLE, pageID, false);
+  }
+  ASSERT_GT(bufferPoolManager.getStatistics().m_misses, 0);
+}
+
+/**
+ * StudentTableTest gives every test a student table of its own, so that a test sees only the rows it inserts.
+ */
+class StudentTableTest : public TableFileTest {
+public:
+  void SetUp() override {
+    Bitmap::initBitmap();
+    TableFileTest::SetUp();
+    open();
+  }
+
+  void TearDown() override {
+    close();
+    TableFileTest::TearDown();
+  }
+
+protected:
+  /** Insert the students lihua0, lihua1, ..., the age of a student is its number modulo 100, odd ones are male */
+  void insertStudents(size_t count) {
+    for (size_t i { 0 }; i < count; ++i) {
+      SQL sql { "insert name=lihua" + std::to_string(i) + " age=" + std::to_string(i % 100) +
+                " gender=" + (i % 2 ? "male" : "female") };
+      bitmapIndexManager->insert(sql.m_attributes);
+    }
+  }
+
+  /** Close the table and open it again from its files */
+  void reopen() {
+    close();
+    open();
+  }
+
+  /** Open the table again while the open one is abandoned, as after a crash nothing it holds reaches the files */
+  void crash() {
+    // The crashed table is leaked, destroying it would flush it
+    static_cast<void>(bitmapIndexManager.release());
+    static_cast<void>(bufferPoolManager.release());
+    static_cast<void>(fileStore.release());
+    open();
+  }
+
+  std::unique_ptr<FileStore> fileStore;
+  std::unique_ptr<BufferPoolManager> bufferPoolManager;
+  std::unique_ptr<BitmapIndexManager> bitmapIndexManager;
+
+private:
+  void open() {
+    fileStore = std::make_unique<FileStore>(tableName);
+    bufferPoolManager = std::make_unique<BufferPoolManager>(64, fileStore.get());
+    bitmapIndexManager = std::make_unique<BitmapIndexManager>(tableName + ".txt", *bufferPoolManager);
+  }
+
+  void close() {
+    bitmapIndexManager.reset();
+    bufferPoolManager.reset();
+    fileStore.reset();
+  }
+};
+
+TEST_F(StudentTableTest, IndexFileTest) {
+  insertStudents(1000);
+  bitmapIndexManager->checkpoint();
+
+  // Nothing has changed, so nothing is written
+  uint64_t writeCount { fileStore->getWriteLatencyHistogram().getCount() };
+  bitmapIndexManager->checkpoint();
+  ASSERT_EQ(fileStore->getWriteLatencyHistogram().getCount(), writeCount);
+
+  // The bitmaps come back from the index pages
+  reopen();
+  ASSERT_EQ(bitmapIndexManager->count({}), 1000);
+  SQL sql { "select age=42" };
+  ASSERT_EQ(bitmapIndexManager->count(sql.m_conditions), 10);
+  SQL sql2 { "select name=lihua420" };
+  ASSERT_EQ(bitmapIndexManager->select(sql2.m_conditions).next().getValue("age"), ValueType { 20 });
+}
+
+TEST(BitmapIndexManagerTest, SparseIndexFileTest) {
+  Bitmap::initBitmap();
+  for (const auto &fileName : { "sparseIndexTable.db", "sparseIndexTable.idx" }) {
+    std::filesystem::remove(fileName);
+  }
+
+  // A high cardinality attribute, every value has a few bits in one chunk out of three
+  constexpr uint64_t chunkBits { PAGE_SIZE * 8 }, chunkCount { 3 }, valueCount { 3000 };
+  uint64_t bitmapLength { chunkBits * chunkCount };
+  AttributeSchema schema { AttributeKind::INTEGER };
+  std::string section;
+  {
+    FileStore fileStore { "sparseIndexTable" };
+    BufferPoolManager bufferPoolManager { 64, &fileStore };
+    IndexStore indexStore { bufferPoolManager };
+    BitmapIndex bitmapIndex { bitmapLength, schema };
+    for (uint64_t pos { 0 }; pos < bitmapLength; ++pos) {
+      bitmapIndex.setBitmapBit(static_cast<int64_t>(pos * valueCount / bitmapLength), pos);
+    }
+    ASSERT_TRUE(bitmapIndex.save(indexStore));
+    section = bitmapIndex.getSection();
+    bufferPoolManager.flushAllPages();
+  }
+
+  // Only the dense chunks of the not null bitmap take a page, the values are recorded in the section
+  ASSERT_EQ(std::filesystem::file_size("sparseIndexTable.idx"), chunkCount * PAGE_SIZE);
+  ASSERT_LT(section.size(), valueCount * 256);
+
+  FileStore fileStore { "sparseIndexTable" };
+  BufferPoolManager bufferPoolManager { 64, &fileStore };
+  IndexStore indexStore { bufferPoolManager };
+  BitmapIndex bitmapIndex { bitmapLength, schema };
+  std::istringstream in { section };
+  bitmapIndex.load(in, indexStore);
+  ASSERT_EQ(bitmapIndex.getValueCount(), valueCount);
+  ASSERT_EQ(bitmapIndex.getBitmap(Token::EQUAL, 1500).popCount(), 33);
+  ASSERT_EQ(bitmapIndex.getBitmap(Token::LESS_THAN, 1000).popCount(), chunkBits);
+  ASSERT_EQ(bitmapIndex.getBitmap(Token::GREATER_THAN_OR_EQUAL_TO, 0).popCount(), bitmapLength);
+}
+
+TEST_F(StudentTableTest, MappedIndexFileTest) {
+  insertStudents(1000);
+
+  // The chunks are views of the mapped index file, so reloading allocates no chunk
+  reopen();
+  ASSERT_LT(bitmapIndexManager->getMemoryUsage(), 100 * PAGE_SIZE);
+  SQL sql { "select age=42" };
+  ASSERT_EQ(bitmapIndexManager->count(sql.m_conditions), 10);
+
+  // Changing a viewed chunk copies it first
+  SQL sql2 { "delete age=42" };
+  bitmapIndexManager->remove(sql2.m_conditions);
+  ASSERT_EQ(bitmapIndexManager->count(sql.m_conditions), 0);
+  ASSERT_EQ(bitmapIndexManager->count({}), 990);
+
+  reopen();
+  ASSERT_EQ(bitmapIndexManager->count({}), 990);
+  SQL sql3 { "select age=43" };
+  ASSERT_EQ(bitmapIndexManager->count(sql3.m_conditions), 10);
+}
+
+TEST(WriteAheadLogTest, GroupCommitTest) {
+  std::filesystem::remove("groupCommit.wal");
+  {
+    WriteAheadLog log { "groupCommit.wal", std::chrono::milliseconds { 5 } };
+    log.replay(INVALID_LSN, [](const LogRecord &) {});
+
+    // Commits running together share a sync
+    std::vector<std::thread> threads;
+    for (RecordIDType recordID { 0 }; recordID < 16; ++recordID) {
+      threads.emplace_back([&log, recordID] {
+        log.commit(log.append(LogOperation::INSERT, { recordID }, { { "name", "lihua" } }));
+      });
+    }
+    for (auto &thread : threads) thread.join();
+    ASSERT_EQ(log.getLastLSN(), 16);
+    ASSERT_LT(log.getSyncCount(), 16);
+  }
+
+  // A torn record at the end is dropped
+  {
+    std::ofstream fout { "groupCommit.wal", std::ios::binary | std::ios::app };
+    fout << "torn";
+  }
+  WriteAheadLog log { "groupCommit.wal" };
+  std::set<RecordIDType> recordIDs;
+  ASSERT_EQ(log.replay(4, [&](const LogRecord &record) { recordIDs.insert(record.m_recordIDs.front()); }), 12);
+  ASSERT_EQ(recordIDs.size(), 12);
+  ASSERT_EQ(log.append(LogOperation::REMOVE, { 0, 1, 2 }, {}), 17);
+
+  // A log written before the records were versioned is not replayed
+  {
+    std::ofstream fout { "unversioned.wal", std::ios::binary | std::ios::trunc };
+    fout << "records";
+  }
+  WriteAheadLog unversionedLog { "unversioned.wal" };
+  ASSERT_THROW(unversionedLog.replay(INVALID_LSN, [](const LogRecord &) {}), std::runtime_error);
+}
+
+TEST_F(StudentTableTest, RecoveryTest) {
+  insertStudents(1000);
+  reopen();
+
+  // Crash: nothing is flushed, only the committed log survives
+  SQL deleteSql { "delete age=1" };
+  ASSERT_EQ(bitmapIndexManager->remove(deleteSql.m_conditions), 10);
+  SQL updateSql { "update age=99 where name=lihua2" };
+  ASSERT_EQ(bitmapIndexManager->update(updateSql.m_conditions, updateSql.m_attributes), 1);
+  SQL insertSql { "insert name=hanmeimei age=20" };
+  bitmapIndexManager->insert(insertSql.m_attributes);
+
+  crash();
+  ASSERT_EQ(bitmapIndexManager->count({}), 991);
+  SQL ageSql { "select name=lihua2" };
+  ASSERT_EQ(bitmapIndexManager->select(ageSql.m_conditions).next().getValue("age"), ValueType { 99 });
+  SQL nameSql { "select name=hanmeimei" };
+  ASSERT_EQ(bitmapIndexManager->select(nameSql.m_conditions).next().getValue("age"), ValueType { 20 });
+}
+
+TEST_F(StudentTableTest, LazyLoadTest) {
+  insertStudents(1000);
+  reopen();
+
+  // Only the attribute in use is loaded
+  size_t stubMemoryUsage { bitmapIndexManager->getMemoryUsage() };
+  SQL sql { "select age=42" };
+  ASSERT_EQ(bitmapIndexManager->count(sql.m_conditions), 10);
+  size_t ageMemoryUsage { bitmapIndexManager->getMemoryUsage() };
+  ASSERT_GT(ageMemoryUsage, stubMemoryUsage);
+  SQL sql2 { "select name=lihua420" };
+  ASSERT_EQ(bitmapIndexManager->count(sql2.m_conditions), 1);
+  ASSERT_GT(bitmapIndexManager->getMemoryUsage(), ageMemoryUsage);
+
+  // Unchanged attributes are unloaded and loaded again on their next use
+  ASSERT_EQ(bitmapIndexManager->unloadColdIndices(0), stubMemoryUsage);
+  ASSERT_EQ(bitmapIndexManager->count(sql.m_conditions), 10);
+
+  // A changed attribute stays until the next checkpoint
+  SQL sql3 { "update age=43 where name=lihua442" };
+  ASSERT_EQ(bitmapIndexManager->update(sql3.m_conditions, sql3.m_attributes), 1);
+  ASSERT_GT(bitmapIndexManager->unloadColdIndices(0), stubMemoryUsage);
+  ASSERT_EQ(bitmapIndexManager->count(sql.m_conditions), 9);
+  bitmapIndexManager->checkpoint();
+  bitmapIndexManager->unloadColdIndices(0);
+  ASSERT_EQ(bitmapIndexManager->count(sql.m_conditions), 9);
+}
+
+TEST_F(StudentTableTest, IncrementalCheckpointTest) {
+  insertStudents(1000);
+  bitmapIndexManager->checkpoint();
+  std::string firstSegmentName { tableName + ".txt.seg0" };
+  uint64_t segmentSize { std::filesystem::file_size(firstSegmentName) };
+
+  // Only the changed chunks and the section of the changed attribute are written
+  SQL sql { "update age=43 where name=lihua442" };
+  bitmapIndexManager->update(sql.m_conditions, sql.m_attributes);
+  uint64_t writeCount { fileStore->getWriteLatencyHistogram().getCount() };
+  bitmapIndexManager->checkpoint();
+  ASSERT_LE(fileStore->getWriteLatencyHistogram().getCount() - writeCount, 3);
+  ASSERT_LT(std::filesystem::file_size(firstSegmentName) - segmentSize, segmentSize / 4);
+
+  // Once most of the segment is dead, it is compacted into the next one
+  for (size_t i { 0 }; i < 4 and std::filesystem::exists(firstSegmentName); ++i) {
+    SQL sql { "update name=hanmeimei" + std::to_string(i) + " where name=lihua" + std::to_string(i) };
+    bitmapIndexManager->update(sql.m_conditions, sql.m_attributes);
+    bitmapIndexManager->checkpoint();
+  }
+  ASSERT_FALSE(std::filesystem::exists(firstSegmentName));
+  ASSERT_TRUE(std::filesystem::exists(tableName + ".txt.seg1"));
+
+  reopen();
+  ASSERT_EQ(bitmapIndexManager->count({}), 1000);
+  SQL sql2 { "select age=43" };
+  ASSERT_EQ(bitmapIndexManager->count(sql2.m_conditions), 11);
+  SQL sql3 { "select name=hanmeimei0" };
+  ASSERT_EQ(bitmapIndexManager->select(sql3.m_conditions).next().getValue("age"), ValueType { 0 });
+}
+
+TEST_F(StudentTableTest, PreparedStatementTest) {
+  insertStudents(1000);
+
+  auto statement { bitmapIndexManager->prepare("select age=? and gender=?") };
+  ASSERT_EQ(statement.getParameterCount(), 2);
+  ASSERT_EQ(bitmapIndexManager->count(statement, { "41", "male" }), 10);
+  ASSERT_EQ(bitmapIndexManager->count(statement, { "41", "female" }), 0);
+  ASSERT_EQ(bitmapIndexManager->execute(statement, { "8", "female" }).popCount(), 10);
+  ASSERT_EQ(bitmapIndexManager->select(statement, { "42", "female" }).next().getValue("age"), ValueType { 42 });
+
+  // Literal values and parameters mix, and the result matches the parsed statement
+  auto rangeStatement { bitmapIndexManager->prepare("count age>=? and (name=lihua3 or age<10)") };
+  SQL sql { "count age>=5 and (name=lihua3 or age<10)" };
+  ASSERT_EQ(bitmapIndexManager->count(rangeStatement, { "5" }), bitmapIndexManager->count(sql.m_conditions));
+  ASSERT_EQ(bitmapIndexManager->count(rangeStatement, { "5" }), 50);
+
+  // Nested conditions need more registers, executing again reuses them
+  auto nestedStatement { bitmapIndexManager->prepare("count (age<? or age>?) and (gender=male or name=?)") };
+  for (int i { 0 }; i < 3; ++i) {
+    ASSERT_EQ(bitmapIndexManager->count(nestedStatement, { "10", "89", "lihua4" }), 101);
+    ASSERT_EQ(bitmapIndexManager->count(nestedStatement, { "0", "97", "lihua98" }), 11);
+  }
+
+  ASSERT_THROW(bitmapIndexManager->count(statement, { "41" }), std::runtime_error);
+  ASSERT_THROW(bitmapIndexManager->prepare("delete age=?"), std::runtime_error);
+  ASSERT_THROW(bitmapIndexManager->prepare("select department=?"), std::runtime_error);
+}
+
+TEST_F(StudentTableTest, PlanCacheTest) {
+  insertStudents(1000);
+
+  // Statements differing only in their values and spelling share a plan
+  PlanCache planCache { *bitmapIndexManager, 2 };
+  std::vector<std::string> parameters;
+  auto plan { planCache.lookup("select age=41 and gender=male", parameters) };
+  ASSERT_EQ(parameters, (std::vector<std::string> { "41", "male" }));
+  ASSERT_EQ(bitmapIndexManager->count(*plan, parameters), 10);
+  ASSERT_EQ(planCache.lookup("SELECT age = 7 AND gender = female", parameters), plan);
+  ASSERT_EQ(bitmapIndexManager->count(*plan, parameters), 0);
+  ASSERT_EQ(planCache.lookup("insert name=hanmeimei", parameters), nullptr);
+  ASSERT_EQ(planCache.getStatistics().m_hits, 1);
+  ASSERT_EQ(planCache.getStatistics().m_misses, 1);
+
+  // The least recently used shape is dropped
+  auto countPlan { planCache.lookup("count age<10", parameters) };
+  ASSERT_EQ(countPlan->getOperationType(), Token::COUNT);
+  ASSERT_EQ(bitmapIndexManager->count(*countPlan, parameters), 100);
+  planCache.lookup("select age=41 and gender=male", parameters);
+  planCache.lookup("count name=lihua3 or age is null", parameters);
+  ASSERT_EQ(planCache.size(), 2);
+  ASSERT_EQ(planCache.getStatistics().m_evictions, 1);
+  ASSERT_EQ(planCache.lookup("select age=41 and gender=male", parameters), plan);
+  ASSERT_NE(planCache.lookup("count age<10", parameters), countPlan);
+  ASSERT_DOUBLE_EQ(planCache.getStatistics().getHitRatio(), 3.0 / 7.0);
+}
+
+TEST_F(StudentTableTest, InBetweenTest) {
+  insertStudents(1000);
+
+  // IN and BETWEEN match their OR and AND spellings
+  SQL inSql { "count age in (3, 5, 7, 200) and gender=male" };
+  SQL orSql { "count (age=3 or age=5 or age=7 or age=200) and gender=male" };
+  ASSERT_EQ(bitmapIndexManager->count(inSql.m_conditions), 30);
+  ASSERT_EQ(bitmapIndexManager->count(orSql.m_conditions), 30);
+  SQL betweenSql { "count age between 10 and 19 and gender is not null" };
+  ASSERT_EQ(bitmapIndexManager->count(betweenSql.m_conditions), 100);
+  SQL emptySql { "count age between 19 and 10 or name in (lihua1, lihua2)" };
+  ASSERT_EQ(bitmapIndexManager->count(emptySql.m_conditions), 2);
+  ASSERT_THROW(SQL { "select age in ()" }, std::runtime_error);
+
+  // The values of both are bound as parameters
+  auto statement { bitmapIndexManager->prepare("select name in (?, ?) or age between ? and ?") };
+  ASSERT_EQ(statement.getParameterCount(), 4);
+  ASSERT_EQ(bitmapIndexManager->count(statement, { "lihua5", "lihua500", "0", "1" }), 21);
+  ASSERT_EQ(bitmapIndexManager->count(statement, { "lihua1", "lihua2", "98", "99" }), 22);
+}
+
+TEST_F(StudentTableTest, NotTest) {
+  for (size_t i { 0 }; i < 1000; ++i) {
+    // Every tenth record has no gender
+    SQL sql { "insert name=lihua" + std::to_string(i) + " age=" + std::to_string(i % 100) +
+              (i % 10 ? (i % 2 ? " gender=male" : " gender=female") : "") };
+    bitmapIndexManager->insert(sql.m_attributes);
+  }
+
+  // A negated condition does not match records without a value
+  SQL notSql { "count not gender=male" };
+  ASSERT_EQ(bitmapIndexManager->count(notSql.m_conditions), 400);
+  SQL deMorganSql { "count not (age<50 or gender=female)" };
+  SQL expandedSql { "count age>=50 and gender!=female" };
+  ASSERT_EQ(bitmapIndexManager->count(deMorganSql.m_conditions), 250);
+  ASSERT_EQ(bitmapIndexManager->count(expandedSql.m_conditions), 250);
+  SQL doubleNotSql { "count not not (age in (1, 2) and gender is null)" };
+  ASSERT_EQ(bitmapIndexManager->count(doubleNotSql.m_conditions), 0);
+  SQL notInSql { "count not age in (1, 2, 3) and not age between 10 and 99" };
+  ASSERT_EQ(bitmapIndexManager->count(notInSql.m_conditions), 70);
+  SQL notNullSql { "count not (gender is null or age>5)" };
+  ASSERT_EQ(bitmapIndexManager->count(notNullSql.m_conditions), 50);
+}
+
+TEST_F(StudentTableTest, LikeTest) {
+  insertStudents(1000);
+
+  SQL prefixSql { "count name like lihua1%" };
+  ASSERT_EQ(bitmapIndexManager->count(prefixSql.m_conditions), 111);
+  SQL suffixSql { "count name LIKE %99" };
+  ASSERT_EQ(bitmapIndexManager->count(suffixSql.m_conditions), 10);
+  SQL patternSql { "count name like lihua%5 and gender=male" };
+  ASSERT_EQ(bitmapIndexManager->count(patternSql.m_conditions), 100);
+  SQL exactSql { "count name like lihua12" };
+  ASSERT_EQ(bitmapIndexManager->count(exactSql.m_conditions), 1);
+  SQL notLikeSql { "count not name like lihua1%" };
+  ASSERT_EQ(bitmapIndexManager->count(notLikeSql.m_conditions), 889);
+
+  // The reversed values follow the values inserted after they have been built
+  SQL insertSql { "insert name=zhang99 age=1" };
+  bitmapIndexManager->insert(insertSql.m_attributes);
+  ASSERT_EQ(bitmapIndexManager->count(suffixSql.m_conditions), 11);
+
+  auto statement { bitmapIndexManager->prepare("count name like ? or name like ?") };
+  ASSERT_EQ(bitmapIndexManager->count(statement, { "lihua9%", "zhang%" }), 112);
+  ASSERT_EQ(bitmapIndexManager->count(statement, { "%hua%0", "%g%" }), 101);
+}
+
+TEST(BitmapIndexDictionaryTest, CodeTest) {
+  Bitmap::initBitmap();
+  uint64_t bitmapLength { 8 };
+  AttributeSchema schema;
+  BitmapIndex bitmapIndex { bitmapLength, schema };
+  for (const auto &[value, pos] : std::vector<std::pair<ValueType, uint64_t>> {
+           { "b", 0 }, { "d", 1 }, { "a", 2 }, { "c", 3 }, { "b", 4 } }) {
+    bitmapIndex.setBitmapBit(value, pos);
+  }
+
+  // The codes follow the order of the values, whatever the order they were inserted in
+  ASSERT_EQ(bitmapIndex.getValueCount(), 4);
+  for (ValueCodeType code { 0 }; code < 4; ++code) ASSERT_EQ(bitmapIndex.getCode(bitmapIndex.getValue(code)), code);
+  ASSERT_EQ(bitmapIndex.getValue(0), ValueType { "a" });
+  ASSERT_EQ(bitmapIndex.getValue(3), ValueType { "d" });
+  ASSERT_EQ(bitmapIndex.getBitmap(Token::GREATER_THAN_OR_EQUAL_TO, "b").popCount(), 4);
+  ASSERT_EQ(bitmapIndex.getBitmap(Token::LESS_THAN, "bb").popCount(), 3);
+
+  // Removing a value moves the codes after it down
+  bitmapIndex.clearAllBitmapBits(2);
+  ASSERT_EQ(bitmapIndex.getCode("a"), std::nullopt);
+  ASSERT_EQ(bitmapIndex.getCode("b"), 0);
+  ASSERT_EQ(bitmapIndex.getCode("d"), 2);
+  ASSERT_EQ(bitmapIndex.getBitmap(Token::EQUAL, "b").popCount(), 2);
+  ASSERT_EQ(bitmapIndex.getBitmap(Token::NOT_EQUAL, "b").popCount(), 2);
+  ASSERT_EQ(bitmapIndex.getBitmap(Token::LESS_THAN_OR_EQUAL_TO, "c").popCount(), 3);
+
+  // A record set after a removal is cleared from the bitmap of its value only
+  bitmapIndex.setBitmapBit("a", 2);
+  bitmapIndex.clearAllBitmapBits(0);
+  ASSERT_EQ(bitmapIndex.getBitmap(Token::EQUAL, "a").popCount(), 1);
+  ASSERT_EQ(bitmapIndex.getBitmap(Token::EQUAL, "b").popCount(), 1);
+  ASSERT_EQ(bitmapIndex.getCode("d"), 3);
+}
+
+TEST_F(StudentTableTest, TypedValueTest) {
+  for (size_t i { 0 }; i < 200; ++i) {
+    SQL sql { "insert name=lihua" + std::to_string(i) + " age=" + std::to_string(i * 7) +
+              (i % 2 ? " gender=male" : " gender=female") + " department=Physics" };
+    bitmapIndexManager->insert(sql.m_attributes);
+  }
+
+  // Ages are ordered as numbers without being padded
+  SQL rangeSql { "count age>=100 and age<1000" };
+  ASSERT_EQ(bitmapIndexManager->count(rangeSql.m_conditions), 128);
+  SQL betweenSql { "count age between 7 and 70" };
+  ASSERT_EQ(bitmapIndexManager->count(betweenSql.m_conditions), 10);
+  auto statement { bitmapIndexManager->prepare("count age<? and gender=?") };
+  ASSERT_EQ(bitmapIndexManager->count(statement, { "22", "male" }), 2);
+
+  // The record holds the typed values as they were parsed
+  SQL selectSql { "select name=lihua3" };
+  Row row { bitmapIndexManager->select(selectSql.m_conditions).next() };
+  ASSERT_EQ(row.getValue("age"), ValueType { 21 });
+  ASSERT_EQ(row.getText("gender"), "male");
+  ASSERT_EQ(row.getText("department"), "Physics");
+
+  // A value the schema does not accept is rejected before it reaches the index
+  ASSERT_THROW(SQL { "insert name=hanmeimei age=old" }, std::runtime_error);
+  ASSERT_THROW(SQL { "insert name=hanmeimei gender=unknown" }, std::runtime_error);
+  ASSERT_THROW(SQL { "insert name=hanmeimeihanmeimeihanmeimei" }, std::runtime_error);
+  SQL badConditionSql { "count age=old" };
+  ASSERT_THROW(bitmapIndexManager->count(badConditionSql.m_conditions), std::runtime_error);
+  ASSERT_THROW(bitmapIndexManager->count(statement, { "young", "male" }), std::runtime_error);
+}
+
+TEST(BitmapIndexManagerTest, TableSchemaTest) {
+  Bitmap::initBitmap();
+  for (const auto &fileName : { "cityTable.txt", "cityTable.txt.wal", "cityTable.db", "cityTable.idx" }) {
+    std::filesystem::remove(fileName);
+  }
+
+  // The layout is computed once: the null bits, then every column at its offset
+  TableSchema schema { {
+    { "city", { AttributeKind::STRING, {}, 8 } },
+    { "population", { AttributeKind::INTEGER } },
+    { "size", { AttributeKind::ENUM, { "small", "large" } } },
+  } };
+  ASSERT_EQ(schema.getRowSize(), 18);
+  ASSERT_EQ(schema.getColumn(schema.getColumnID("population")).m_offset, 9);
+  ASSERT_EQ(schema.getColumn(schema.getColumnID("size")).m_offset, 17);
+  ASSERT_THROW(schema.getColumnID("name"), std::runtime_error);
+
+  {
+    FileStore fileStore { "cityTable" };
+    BufferPoolManager bufferPoolManager { 64, &fileStore };
+    BitmapIndexManager bitmapIndexManager { "cityTable.txt", bufferPoolManager, {}, 1 << 20, schema };
+    for (int64_t i { 0 }; i < 1000; ++i) {
+      AttributeType attributes { { "city", "city" + std::to_string(i) }, { "population", i * 10 } };
+      if (i % 2) attributes.emplace_back("size", i < 500 ? 0 : 1);
+      bitmapIndexManager.insert(attributes);
+    }
+    ASSERT_THROW(bitmapIndexManager.insert({ { "population", "many" } }), std::runtime_error);
+    ASSERT_THROW(bitmapIndexManager.insert({ { "name", "lihua" } }), std::runtime_error);
+
+    ConditionType conditions { SubConditionType { "population", Token::GREATER_THAN_OR_EQUAL_TO, "5000" },
+                               SubConditionType { "size", Token::EQUAL, "large" }, Token::AND };
+    ASSERT_EQ(bitmapIndexManager.count(conditions), 250);
+    ASSERT_EQ(bitmapIndexManager.update(conditions, { { "size", 0 } }), 250);
+  }
+
+  // The rows are read back through the schema saved with the catalog
+  {
+    FileStore fileStore { "cityTable" };
+    BufferPoolManager bufferPoolManager { 64, &fileStore };
+    BitmapIndexManager bitmapIndexManager { "cityTable.txt", bufferPoolManager, {}, 1 << 20, schema };
+    ConditionType conditions { SubConditionType { "city", Token::EQUAL, "city501" } };
+    Row row { bitmapIndexManager.select(conditions).next() };
+    ASSERT_EQ(row.getValue("population"), ValueType { 5010 });
+    ASSERT_EQ(row.getText("size"), "small");
+    conditions = { SubConditionType { "city", Token::EQUAL, "city2" } };
+    ASSERT_EQ(bitmapIndexManager.select(conditions).next().getText("size"), "NULL");
+  }
+
+  FileStore fileStore { "cityTable" };
+  BufferPoolManager bufferPoolManager { 64, &fileStore };
+  ASSERT_THROW(BitmapIndexManager("cityTable.txt", bufferPoolManager), std::runtime_error);
+}